@@ -23,16 +23,59 @@ import { render, template } from './helpers/render.js';
 
 window.debugflags = 0;
 
+// The page is kept alive across item/node switches, so the compiled
+// template is cached and new content is rendered into the existing body
+let compiledTemplate = null;
+
 function prepare(baseURL, title) {
 	if (title) {
 		/* Set title for it to appear in e.g. desktop MPRIS playback controls */
 		document.title = title;
 	}
 	if (baseURL && baseURL !== '(null)') {
-		let base = document.createElement("base");
+		let base = document.querySelector("base");
+		if (!base) {
+			base = document.createElement("base");
+			document.head.appendChild(base);
+		}
 		base.setAttribute("href", baseURL);
-		document.head.appendChild(base);
 	}
+	window.scrollTo(0, 0);
+}
+
+// Tell the embedding LifereaBrowser the content was rendered, so it can
+// push further content into this page and measure time to first paint.
+// 'extract' tells whether a rich content extraction was run ("miss") or
+// served from the extraction cache ("hit").
+function rendered(start, extract) {
+	requestAnimationFrame(() => {
+		const ms = performance.now() - start;
+		debug(`rendered in ${ms.toFixed(1)}ms`);
+		window.webkit?.messageHandlers?.liferea?.postMessage({ type: "rendered", ms, extract });
+	});
+}
+
+// Readability extraction of rich content, results are sanitized and
+// handed to LifereaBrowser for caching (see item_extract.c)
+function extract(item, richContent) {
+	let shadowDoc = document.implementation.createHTMLDocument();
+	shadowDoc.body.innerHTML = richContent;
+
+	let article = new window.Readability(shadowDoc, {charThreshold: 100}).parse();
+	if (article)
+		article = { title: article.title ?? "", content: window.DOMPurify.sanitize(article.content ?? "") };
+
+	if (item.extractHash) {
+		window.webkit?.messageHandlers?.liferea?.postMessage({
+			type	: "extract",
+			id	: item.id,
+			hash	: item.extractHash,
+			title	: article?.title ?? "",
+			content	: article?.content ?? ""
+		});
+	}
+
+	return article;
 }
 
 // returns first occurence of a given metadata type
@@ -62,6 +105,12 @@ function templateFix(str, data) {
 		data);
 }
 
+function getTemplate() {
+	if (!compiledTemplate)
+		compiledTemplate = templateFix(document.getElementById('template').innerHTML);
+	return compiledTemplate;
+}
+
 function escapeHTML(str){
 	return new Option(str).innerHTML;
 }
@@ -113,6 +162,8 @@ function parse_opml(blogrollData) {
 }
 
 async function load_node(data, baseURL, direction) {
+	const start = performance.now();
+
 	try {
 		if(window.hookPreNodeRendering) {
 			data = window.hookPreNodeRendering(data);
@@ -130,7 +181,7 @@ async function load_node(data, baseURL, direction) {
 		const blogrollParsed = blogrollData ? parse_opml(blogrollData) : null;
 
 		prepare(baseURL, node.title);
-		render("body", templateFix(document.getElementById('template').innerHTML), {
+		render("body", getTemplate(), {
 			node,
 			direction,
 			publisher  		: metadata_get(node, "publisher"),
@@ -151,8 +202,11 @@ async function load_node(data, baseURL, direction) {
 
 		if(window.hookPostNodeRendering)
 			window.hookPostNodeRendering();
+
+		rendered(start);
 	} catch (e) {
 		document.body.innerHTML = `<div id="errors">Error: Failed to load node! Exception: ${escapeHTML(e)}</div>` + document.body.innerHTML;
+		rendered(start);
 		return false;
 	}
 }
@@ -175,6 +229,8 @@ function findLargestImage(imgEnclosures) {
 }
 
 async function load_item(data, baseURL, direction) {
+	const start = performance.now();
+
 	try {
 		if(window.hookPreItemRendering) {
 			data = window.hookPreItemRendering(data);
@@ -190,15 +246,22 @@ async function load_item(data, baseURL, direction) {
 		const comments = commentFeedJson ? JSON.parse(commentFeedJson) : null;
 		const enclosures = item.metadata.filter((m) => m.enclosure).map((m) => m.enclosure);
 		let title = item.title;
-		let article;
+		let article, extractResult;
 		let debugfooter = `<hr/>DEBUG: item_id=${item?.id} `;
 
 		if (richContent) {
-			let shadowDoc = document.implementation.createHTMLDocument();
-			shadowDoc.body.innerHTML = richContent;
 			debugfooter += " Scrape";
 
-			article = new window.Readability(shadowDoc, {charThreshold: 100}).parse();
+			if (item.extract) {
+				// An empty result means extraction was done but failed
+				article = item.extract.content ? item.extract : null;
+				extractResult = "hit";
+				debugfooter += " extractCache";
+			} else {
+				article = extract(item, richContent);
+				extractResult = "miss";
+			}
+
 			if (article) {
 				// Use rich content from Readability if available and better!
 				if (article.content.length > item.description.length) {
@@ -221,7 +284,7 @@ async function load_item(data, baseURL, direction) {
 		debug("article", article);
 
 		prepare(baseURL, title);
-		render("body", templateFix (document.getElementById('template').innerHTML), {
+		render("body", getTemplate(), {
 			item,
 			direction,
 			title,
@@ -345,29 +408,36 @@ async function load_item(data, baseURL, direction) {
 		if(window.hookPostItemRendering)
 			window.hookPostItemRendering();
 
+		rendered(start, extractResult);
 		return true;
 	} catch (e) {
 		document.body.innerHTML = `<div id="errors">Error: Failed to load item! Exception: ${escapeHTML(e)}</div>` + document.body.innerHTML;
 		console.error(e.stack);
 		window.data = data;
+		rendered(start);
 		return false;
 	}
 }
 
 async function load_update_monitor(data) {
+	const start = performance.now();
+
 	try {
 		const feedlist = JSON.parse(decodeURIComponent(data));
 		console.log(feedlist);
-		render("body", templateFix(document.getElementById('template').innerHTML), {
+		render("body", getTemplate(), {
 			feedlist
 		});
 
 		if(window.debugflags > 0)
 			document.body.innerHTML += '<pre>' + escapeHTML(JSON.stringify(feedlist.jobs, null, 2)) + '</pre>';
+
+		rendered(start);
 	} catch (e) {
 		document.body.innerHTML = `<div id="errors">Error: Failed to load update monitor! Exception: ${escapeHTML(e)}</div>` + document.body.innerHTML;
 		console.error(e.stack);
 		window.data = data;
+		rendered(start);
 		return false;
 	}
 }
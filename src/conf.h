@@ -49,6 +49,8 @@
 
 /* feed handling settings */
 #define DEFAULT_MAX_ITEMS		"maxitemcount"
+#define DEFAULT_RETAIN_UNREAD		"retain-unread-days"
+#define DEFAULT_RETAIN_READ		"retain-read-days"
 #define DEFAULT_UPDATE_INTERVAL		"default-update-interval"
 #define STARTUP_FEED_ACTION		"startup-feed-action"
 
@@ -214,10 +214,15 @@ date_format (gint64 date, const gchar *date_format)
 	return result;
 }
 
-/* date parsing methods */
+/* date parsing methods
 
-gint64
-date_parse_ISO8601 (const gchar *date)
+   The common date shapes are handled by non-allocating scanners
+   (date_scan_ISO8601() and date_scan_RFC822()). Everything they don't
+   fully understand is passed on to the GDateTime based fallback parsers
+   below, so the scanners only need to be exact, not complete. */
+
+static gint64
+date_parse_ISO8601_fallback (const gchar *date)
 {
 	GDateTime 	*datetime = NULL;
 	guint64 	year, month, day;
@@ -390,8 +395,8 @@ date_parse_month (const gchar *str)
 	return 0;
 }
 
-gint64
-date_parse_RFC822 (const gchar *date)
+static gint64
+date_parse_RFC822_fallback (const gchar *date)
 {
 	guint64 	day, month, year, hour, minute, second = 0;
 	GTimeZone	*tz = NULL;
@@ -484,6 +489,268 @@ parsing_failed:
 	return t;
 }
 
+/* Timezone offsets of tz_offsets[] in seconds, parsed once */
+static gint tz_offset_seconds[G_N_ELEMENTS (tz_offsets)];
+
+static void
+date_init_tz_offsets (void)
+{
+	static gsize initialized = 0;
+
+	if (!g_once_init_enter (&initialized))
+		return;
+
+	for (guint i = 0; i < G_N_ELEMENTS (tz_offsets); i++) {
+		const gchar	*offset = tz_offsets[i].offset;
+		gint		hours, minutes = 0;
+
+		hours = (offset[1] - '0') * 10 + (offset[2] - '0');
+		if (offset[3])
+			minutes = (offset[3] - '0') * 10 + (offset[4] - '0');
+
+		tz_offset_seconds[i] = (offset[0] == '-' ? -1 : 1) * (hours * 3600 + minutes * 60);
+	}
+
+	g_once_init_leave (&initialized, 1);
+}
+
+/* Days since 1970-01-01 of a proleptic Gregorian date */
+static gint64
+date_days_from_civil (gint year, gint month, gint day)
+{
+	gint64	era, yoe, doy, doe;
+
+	year -= month <= 2;
+	era = (year >= 0 ? year : year - 399) / 400;
+	yoe = year - era * 400;
+	doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 719468;
+}
+
+/* Returns a unix timestamp or 0 for invalid values */
+static gint64
+date_to_unix (gint year, gint month, gint day, gint hour, gint minute, gint second, gint offset)
+{
+	static const gint mdays[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	gint maxDay;
+
+	if (year < 1 || year > 9999 || month < 1 || month > 12 || day < 1 ||
+	    hour > 23 || minute > 59 || second > 59)
+		return 0;
+
+	maxDay = mdays[month - 1];
+	if (month == 2 && (year % 4 == 0) && ((year % 100 != 0) || (year % 400 == 0)))
+		maxDay = 29;
+	if (day > maxDay)
+		return 0;
+
+	return date_days_from_civil (year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offset;
+}
+
+/* Scans exactly n digits */
+static gboolean
+date_scan_digits (const gchar **pos, gint n, gint *value)
+{
+	const gchar *p = *pos;
+
+	*value = 0;
+	for (gint i = 0; i < n; i++, p++) {
+		if (!g_ascii_isdigit (*p))
+			return FALSE;
+		*value = *value * 10 + (*p - '0');
+	}
+	*pos = p;
+
+	return TRUE;
+}
+
+/* Scans a numeric offset like "+0100", "-01:30" or "+01" */
+static gboolean
+date_scan_numeric_offset (const gchar **pos, gint *offset)
+{
+	const gchar	*p = *pos;
+	gint		sign, hours, minutes = 0;
+
+	if (*p != '+' && *p != '-')
+		return FALSE;
+	sign = (*p == '-') ? -1 : 1;
+	p++;
+
+	if (!date_scan_digits (&p, 2, &hours))
+		return FALSE;
+	if (*p == ':')
+		p++;
+	if (g_ascii_isdigit (*p) && !date_scan_digits (&p, 2, &minutes))
+		return FALSE;
+
+	*offset = sign * (hours * 3600 + minutes * 60);
+	*pos = p;
+
+	return TRUE;
+}
+
+/* Fast path for "YYYY-MM-DD", "YYYY-MM-DDThh:mm[:ss[.s]]" with optional
+   "Z" or numeric offset. Returns 0 for anything else. */
+static gint64
+date_scan_ISO8601 (const gchar *p)
+{
+	gint year, month, day, hour = 0, minute = 0, second = 0, offset = 0;
+
+	if (!date_scan_digits (&p, 4, &year) || *p++ != '-' ||
+	    !date_scan_digits (&p, 2, &month) || *p++ != '-' ||
+	    !date_scan_digits (&p, 2, &day))
+		return 0;
+
+	if (*p == '\0')
+		return date_to_unix (year, month, day, 0, 0, 0, 0);
+
+	if (*p++ != 'T' ||
+	    !date_scan_digits (&p, 2, &hour) || *p++ != ':' ||
+	    !date_scan_digits (&p, 2, &minute))
+		return 0;
+
+	if (*p == ':') {
+		p++;
+		if (!date_scan_digits (&p, 2, &second))
+			return 0;
+		if (*p == '.' || *p == ',') {
+			p++;
+			if (!g_ascii_isdigit (*p))
+				return 0;
+			while (g_ascii_isdigit (*p))
+				p++;
+		}
+	}
+
+	if (*p == 'Z')
+		p++;
+	else if (*p != '\0' && !date_scan_numeric_offset (&p, &offset))
+		return 0;
+
+	if (*p != '\0')
+		return 0;
+
+	return date_to_unix (year, month, day, hour, minute, second, offset);
+}
+
+/* Fast path for "[Www, ]D[D] Mon YY[YY] hh:mm[:ss] [zone]" with ASCII
+   weekday and a numeric or known zone. Returns 0 for anything else. */
+static gint64
+date_scan_RFC822 (const gchar *p)
+{
+	gint		day, month, year, hour, minute, second = 0, offset = 0;
+	const gchar	*start;
+
+	while (g_ascii_isspace (*p))
+		p++;
+
+	/* optional day of week */
+	if (g_ascii_isalpha (*p)) {
+		while (g_ascii_isalpha (*p))
+			p++;
+		if (*p++ != ',')
+			return 0;
+		while (g_ascii_isspace (*p))
+			p++;
+	}
+
+	if (!date_scan_digits (&p, 2, &day) && !date_scan_digits (&p, 1, &day))
+		return 0;
+	if (!g_ascii_isspace (*p))
+		return 0;
+	while (g_ascii_isspace (*p))
+		p++;
+
+	month = date_parse_month (p);
+	if (!month || !g_ascii_isspace (p[3]))
+		return 0;
+	p += 3;
+	while (g_ascii_isspace (*p))
+		p++;
+
+	if (date_scan_digits (&p, 4, &year)) {
+		/* 4 digit year */
+	} else if (date_scan_digits (&p, 2, &year)) {
+		/* If year is 2 digits, years after 68 are in 20th century (strptime convention) */
+		year += (year > 68) ? 1900 : 2000;
+	} else {
+		return 0;
+	}
+	if (!g_ascii_isspace (*p))
+		return 0;
+	while (g_ascii_isspace (*p))
+		p++;
+
+	if (!date_scan_digits (&p, 2, &hour) || *p++ != ':' ||
+	    !date_scan_digits (&p, 2, &minute))
+		return 0;
+	if (*p == ':') {
+		p++;
+		if (!date_scan_digits (&p, 2, &second))
+			return 0;
+	}
+
+	while (g_ascii_isspace (*p))
+		p++;
+
+	/* optional zone */
+	start = p;
+	if (*p == '+' || *p == '-') {
+		if (!date_scan_numeric_offset (&p, &offset))
+			return 0;
+	} else if (g_ascii_isalpha (*p)) {
+		guint i;
+
+		while (g_ascii_isalpha (*p))
+			p++;
+
+		/* same prefix matching as date_parse_rfc822_tz() e.g. "UTC" is "UT" */
+		date_init_tz_offsets ();
+		for (i = 0; i < G_N_ELEMENTS (tz_offsets); i++) {
+			gsize len = strlen (tz_offsets[i].name);
+			if (len <= (gsize)(p - start) && 0 == strncmp (start, tz_offsets[i].name, len))
+				break;
+		}
+		if (i == G_N_ELEMENTS (tz_offsets))
+			return 0;
+		offset = tz_offset_seconds[i];
+	}
+
+	while (g_ascii_isspace (*p))
+		p++;
+	if (*p != '\0')
+		return 0;
+
+	return date_to_unix (year, month, day, hour, minute, second, offset);
+}
+
+gint64
+date_parse_ISO8601 (const gchar *date)
+{
+	gint64 t;
+
+	g_assert (date != NULL);
+
+	t = date_scan_ISO8601 (date);
+	if (t)
+		return t;
+
+	return date_parse_ISO8601_fallback (date);
+}
+
+gint64
+date_parse_RFC822 (const gchar *date)
+{
+	gint64 t;
+
+	t = date_scan_RFC822 (date);
+	if (t)
+		return t;
+
+	return date_parse_RFC822_fallback (date);
+}
 
 static const gchar * rfc822_weekdays[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
 
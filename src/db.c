@@ -151,12 +151,18 @@ db_get_schema_version (void)
 	return schemaVersion;
 }
 
-static void
+/* Transactions can be nested, only the outermost one is effective */
+static guint transactionDepth = 0;
+
+void
 db_begin_transaction (void)
 {
 	gchar	*sql, *err;
 	gint	res;
 
+	if (transactionDepth++ > 0)
+		return;
+
 	sql = sqlite3_mprintf ("BEGIN");
 	res = sqlite3_exec (db, sql, NULL, NULL, &err);
 	if (SQLITE_OK != res)
@@ -165,12 +171,17 @@ db_begin_transaction (void)
 	sqlite3_free (err);
 }
 
-static void
+void
 db_end_transaction (void)
 {
 	gchar	*sql, *err;
 	gint	res;
 
+	g_return_if_fail (transactionDepth > 0);
+
+	if (--transactionDepth > 0)
+		return;
+
 	sql = sqlite3_mprintf ("END");
 	res = sqlite3_exec (db, sql, NULL, NULL, &err);
 	if (SQLITE_OK != res)
@@ -181,11 +192,67 @@ db_end_transaction (void)
 
 #define VACUUM_ON_FRAGMENTATION_RATIO	10
 
+/* Approximate storage size of an item row */
+#define ITEM_SIZE_SQL	"IFNULL(LENGTH(CAST(title AS BLOB)),0) + " \
+			"IFNULL(LENGTH(CAST(description AS BLOB)),0) + " \
+			"IFNULL(LENGTH(packed_metadata),0)"
+
+static gint
+db_pragma_get_int (const gchar *sql)
+{
+	sqlite3_stmt	*stmt;
+	gint		res, value;
+
+	db_prepare_stmt (&stmt, sql);
+	res = sqlite3_step (stmt);
+	if (SQLITE_ROW != res)
+		g_error ("Could not run \"%s\" (error code %d)!", sql, res);
+	value = sqlite3_column_int (stmt, 0);
+	sqlite3_finalize (stmt);
+
+	return value;
+}
+
+void
+db_get_space_stats (dbSpaceStats *stats)
+{
+	stats->pageSize		= db_pragma_get_int ("PRAGMA page_size");
+	stats->pageCount	= db_pragma_get_int ("PRAGMA page_count");
+	stats->freelistCount	= db_pragma_get_int ("PRAGMA freelist_count");
+	stats->incremental	= (2 == db_pragma_get_int ("PRAGMA auto_vacuum"));
+}
+
+guint
+db_incremental_vacuum (guint pages)
+{
+	gint	before = db_pragma_get_int ("PRAGMA freelist_count");
+	gchar	*sql;
+
+	sql = sqlite3_mprintf ("PRAGMA incremental_vacuum(%u)", pages);
+	db_exec (sql);
+	sqlite3_free (sql);
+
+	return before - db_pragma_get_int ("PRAGMA freelist_count");
+}
+
+gint
+db_checkpoint (void)
+{
+	gint	res, logFrames = 0, checkpointed = 0;
+
+	res = sqlite3_wal_checkpoint_v2 (db, NULL, SQLITE_CHECKPOINT_PASSIVE, &logFrames, &checkpointed);
+	if (SQLITE_OK != res && SQLITE_BUSY != res)
+		g_warning ("WAL checkpoint failed (error code %d, %s)", res, sqlite3_errmsg (db));
+
+	debug (DEBUG_DB, "WAL checkpoint: %d of %d frames", checkpointed, logFrames);
+
+	return logFrames - checkpointed;
+}
+
 static void
 db_vacuum (void)
 {
-	sqlite3_stmt	*stmt;
-	gint		res, page_count, freelist_count;
+	dbSpaceStats	space;
 
 	/* Determine fragmentation ratio using
 
@@ -197,23 +264,19 @@ db_vacuum (void)
 	   and perform VACUUM only when needed.
 	 */
 
-	db_prepare_stmt (&stmt, "PRAGMA page_count");
-	sqlite3_reset (stmt);
-	res = sqlite3_step (stmt);
-	if (SQLITE_ROW != res)
-		g_error ("Could not determine page count (error code %d)!", res);
-	page_count = sqlite3_column_int (stmt, 0);
-	sqlite3_finalize (stmt);
+	db_get_space_stats (&space);
+	float fragmentation = (100 * (float)space.freelistCount/space.pageCount);
 
-	db_prepare_stmt (&stmt, "PRAGMA freelist_count");
-	sqlite3_reset (stmt);
-	res = sqlite3_step (stmt);
-	if (SQLITE_ROW != res)
-		g_error ("Could not determine free list count (error code %d)!", res);
-	freelist_count = sqlite3_column_int (stmt, 0);
-	sqlite3_finalize (stmt);
+	/* With incremental auto-vacuum free pages are reclaimed
+	   in idle time, see db_maintenance.c */
+	if (space.incremental) {
+		debug (DEBUG_DB, "No VACUUM as incremental auto-vacuum is enabled (freelist count/page count ratio %2.2f)",
+		                  fragmentation);
+		return;
+	}
 
-	float fragmentation = (100 * (float)freelist_count/page_count);
+	/* A full VACUUM also converts the DB to incremental auto-vacuum
+	   as requested in db_open(), so this happens once only */
 	if (fragmentation > VACUUM_ON_FRAGMENTATION_RATIO) {
 		debug (DEBUG_DB, "Performing VACUUM as freelist count/page count ratio %2.2f > %d",
 		                  fragmentation, VACUUM_ON_FRAGMENTATION_RATIO);
@@ -224,6 +287,18 @@ db_vacuum (void)
 	}
 }
 
+/* SQL function source_hash() used to key the duplicate groups */
+static void
+db_source_hash_func (sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+	const gchar *sourceId = (const gchar *) sqlite3_value_text (argv[0]);
+
+	if (sourceId)
+		sqlite3_result_int64 (context, g_str_hash (sourceId));
+	else
+		sqlite3_result_null (context);
+}
+
 static void
 db_open (void)
 {
@@ -239,12 +314,19 @@ db_open (void)
 
 	sqlite3_extended_result_codes (db, TRUE);
 
+	res = sqlite3_create_function (db, "source_hash", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL, db_source_hash_func, NULL, NULL);
+	if (SQLITE_OK != res)
+		g_error ("Could not register SQL function source_hash() (error code %d: %s)", res, sqlite3_errmsg (db));
+
+	/* Must precede switching to WAL to be effective for new DBs,
+	   existing ones are converted by the next VACUUM */
+	db_exec("PRAGMA auto_vacuum=INCREMENTAL");
 	db_exec("PRAGMA journal_mode=WAL");
 	db_exec("PRAGMA page_size=32768");
 	db_exec("PRAGMA synchronous=NORMAL");
 }
 
-#define SCHEMA_TARGET_VERSION 11
+#define SCHEMA_TARGET_VERSION 13
 
 /* opening or creation of database */
 void
@@ -456,6 +538,28 @@ db_init (void)
 			         "REPLACE INTO info (name, value) VALUES ('schemaVersion',11); "
 			         "END;" );
 		}
+
+		if (db_get_schema_version () == 11) {
+			/* 2.0 -> 2.1 packed item metadata, the metadata table rows
+			   are migrated lazily on the next update of each item */
+			db_exec ("BEGIN; "
+			         "ALTER TABLE items ADD COLUMN packed_metadata BLOB; "
+			         "REPLACE INTO info (name, value) VALUES ('schemaVersion',12); "
+			         "END;" );
+		}
+
+		if (db_get_schema_version () == 12) {
+			/* 2.1 duplicate group index */
+			db_exec ("BEGIN; "
+			         "CREATE TABLE item_duplicates ("
+			         "   source_hash	INTEGER,"
+			         "   item_id		INTEGER,"
+			         "   PRIMARY KEY (source_hash, item_id)"
+			         "); "
+			         "INSERT INTO item_duplicates SELECT source_hash(source_id), item_id FROM items WHERE valid_guid = 1 AND source_id IS NOT NULL; "
+			         "REPLACE INTO info (name, value) VALUES ('schemaVersion',13); "
+			         "END;" );
+		}
 	}
 
 	if (SCHEMA_TARGET_VERSION != db_get_schema_version ())
@@ -486,7 +590,8 @@ db_init (void)
         	 "   description	TEXT,"
         	 "   date		INTEGER,"
         	 "   comment_feed_id	TEXT,"
-		 "   comment            INTEGER"
+		 "   comment            INTEGER,"
+		 "   packed_metadata	BLOB"	/* GVariant of type METADATA_VARIANT_TYPE */
         	 ");");
 
 	db_exec ("CREATE INDEX items_idx ON items (source_id);");
@@ -496,6 +601,10 @@ db_init (void)
 	db_exec ("CREATE INDEX items_idx5 ON items (parent_item_id);");
 	db_exec ("CREATE INDEX items_idx6 ON items (parent_node_id);");
 
+	/* Covering index for matching remote ids of online accounts
+	   and their item state, see db_itemset_get_source_states() */
+	db_exec ("CREATE INDEX items_idx7 ON items (node_id, source_id, read, marked, comment);");
+
 	db_exec ("CREATE TABLE metadata ("
         	 "   item_id		INTEGER,"
         	 "   nr              	INTEGER,"
@@ -506,6 +615,46 @@ db_init (void)
 
 	db_exec ("CREATE INDEX metadata_idx ON metadata (item_id);");
 
+	/* Groups items with the same valid GUID, see db_item_get_duplicates() */
+	db_exec ("CREATE TABLE item_duplicates ("
+	         "   source_hash	INTEGER,"
+	         "   item_id		INTEGER,"
+	         "   PRIMARY KEY (source_hash, item_id)"
+	         ");");
+
+	db_exec ("CREATE INDEX item_duplicates_idx ON item_duplicates (item_id);");
+
+	/* Readability extraction results for rich content, see db_item_extract_load() */
+	db_exec ("CREATE TABLE item_extracts ("
+	         "   item_id		INTEGER,"
+	         "   content_hash	TEXT,"
+	         "   title		TEXT,"
+	         "   content		TEXT,"
+	         "   PRIMARY KEY (item_id)"
+	         ");");
+
+	/* Pending content extraction fetches, see enrichment.c */
+	db_exec ("CREATE TABLE enrichment_queue ("
+	         "   item_id		INTEGER,"
+	         "   node_id		STRING,"
+	         "   url		STRING,"
+	         "   queued		INTEGER,"
+	         "   PRIMARY KEY (item_id)"
+	         ");");
+
+	/* Favicon discovery results shared per host, see subscription_icon.c */
+	db_exec ("CREATE TABLE favicon_hosts ("
+	         "   key		STRING,"
+	         "   icon_url		STRING,"
+	         "   node_id		STRING,"
+	         "   blogroll		STRING,"
+	         "   etag		STRING,"
+	         "   last_modified	STRING,"
+	         "   checked		INTEGER,"
+	         "   failed		INTEGER,"
+	         "   PRIMARY KEY (key)"
+	         ");");
+
 	db_exec ("CREATE TABLE subscription ("
         	 "   node_id            STRING,"
 		 "   source             STRING,"
@@ -568,58 +717,33 @@ db_init (void)
 	db_exec ("DROP TRIGGER item_insert;");
 	db_exec ("DROP TRIGGER item_update;");
 	db_exec ("DROP TRIGGER item_removal;");
+	db_exec ("DROP TRIGGER item_duplicates_insert;");
 	db_exec ("DROP TRIGGER subscription_removal;");
 
-	/* 3. Cleanup of DB */
-
-	/* Note: do not check on subscriptions here, as non-subscription node
-	   types (e.g. news bin) do contain items too. */
-	debug (DEBUG_DB, "Checking for items without a feed list node...");
-	db_exec ("DELETE FROM items WHERE comment = 0 AND node_id NOT IN "
-        	 "(SELECT node_id FROM node);");
-
-        debug (DEBUG_DB, "Checking for comments without parent item...");
-	db_exec ("BEGIN; "
-	         "   CREATE TEMP TABLE tmp_id ( id );"
-	         "   INSERT INTO tmp_id SELECT item_id FROM items WHERE comment = 1 AND parent_item_id NOT IN (SELECT item_id FROM items WHERE comment = 0);"
-	         /* limit to 1000 items as it is very slow */
-	         "   DELETE FROM items WHERE item_id IN (SELECT id FROM tmp_id LIMIT 1000);"
-	         "   DROP TABLE tmp_id;"
-		 "END;");
-
-	debug (DEBUG_DB, "Checking for search folder items without a feed list node...");
-	db_exec ("DELETE FROM search_folder_items WHERE parent_node_id NOT IN "
-        	 "(SELECT node_id FROM node);");
-
-	debug (DEBUG_DB, "Checking for search folder items without a search folder...");
-	db_exec ("DELETE FROM search_folder_items WHERE node_id NOT IN "
-        	 "(SELECT node_id FROM node);");
-
-	debug (DEBUG_DB, "Checking for search folder with comments...");
-	db_exec ("DELETE FROM search_folder_items WHERE comment = 1;");
+	/* 3. Cleanup of DB is done incrementally in idle time after
+	      startup, see db_cleanup_step() and db_maintenance.c */
 
-	debug (DEBUG_DB, "Checking for subscription metadata without node...");
-	db_exec ("DELETE FROM subscription_metadata WHERE node_id NOT IN "
-          	 "(SELECT node_id FROM node);");
-
-	debug (DEBUG_DB, "Removing metadata without item...");
-	db_exec ("DELETE FROM metadata WHERE item_id NOT IN "
-		 "(SELECT item_id FROM items);");
-
-	debug (DEBUG_DB, "Removing legacy comment items...");
-	db_exec ("DELETE FROM items WHERE comment = 1;");
-
-	debug (DEBUG_DB, "DB cleanup finished. Continuing startup.");
-
-	/* 4. Creating triggers (after cleanup so it is not slowed down by triggers) */
+	/* 4. Creating triggers */
 
 	/* This trigger does explicitely not remove comments! */
 	db_exec ("CREATE TRIGGER item_removal DELETE ON items "
         	 "BEGIN "
 		 "   DELETE FROM metadata WHERE item_id = old.item_id; "
 		 "   DELETE FROM search_folder_items WHERE item_id = old.item_id; "
+		 "   DELETE FROM item_duplicates WHERE item_id = old.item_id; "
+		 "   DELETE FROM item_extracts WHERE item_id = old.item_id; "
+		 "   DELETE FROM enrichment_queue WHERE item_id = old.item_id; "
         	 "END;");
 
+	/* Note: REPLACE INTO items does not fire the removal trigger, so
+	   stale group entries can exist. Lookups must always compare the
+	   source_id too, which also rules out hash collisions. */
+	db_exec ("CREATE TRIGGER item_duplicates_insert AFTER INSERT ON items "
+	         "WHEN new.valid_guid = 1 AND new.source_id IS NOT NULL "
+	         "BEGIN "
+	         "   REPLACE INTO item_duplicates (source_hash, item_id) VALUES (source_hash(new.source_id), new.item_id); "
+	         "END;");
+
 	db_exec ("CREATE TRIGGER subscription_removal DELETE ON subscription "
         	 "BEGIN "
 		 "   DELETE FROM node WHERE node_id = old.node_id; "
@@ -645,12 +769,68 @@ db_init (void)
 	                  "SELECT COUNT(item_id) FROM items "
 		          "WHERE node_id = ?");
 
+	db_new_statement ("itemsetSourceIdStmt",
+	                  "SELECT item_id FROM items "
+	                  "WHERE node_id = ? AND source_id = ? AND comment = 0");
+
+	db_new_statement ("itemsetSourceStatesStmt",
+	                  "SELECT source_id, item_id, read, marked FROM items "
+	                  "WHERE node_id = ? AND source_id IS NOT NULL AND comment = 0");
+
+	db_new_statement ("itemsetRevisionStmt",
+	                  "SELECT COUNT(item_id), MAX(item_id), SUM(read), SUM(marked), SUM(date), "
+	                  "TOTAL(IFNULL(LENGTH(title), 0) + IFNULL(LENGTH(description), 0)) FROM items "
+	                  "WHERE node_id = ? AND comment = 0");
+
+	db_new_statement ("itemsetRemoveForeignStmt",
+	                  "DELETE FROM items "
+	                  "WHERE node_id = ?1 AND source_id IS NOT NULL "
+	                  "AND substr (source_id, 1, length (?2)) != ?2");
+
+	db_new_statement ("itemsetCountAllStmt",
+	                  "SELECT node_id,COUNT(item_id),SUM(read = 0) FROM items "
+	                  "GROUP BY node_id");
+
 	db_new_statement ("itemsetRemoveStmt",
 	                  "DELETE FROM items WHERE item_id = ? OR (comment = 1 AND parent_item_id = ?)");
 
 	db_new_statement ("itemsetRemoveAllStmt",
 	                  "DELETE FROM items WHERE node_id = ? OR (comment = 1 AND parent_node_id = ?)");
 
+	/* Cache limit pruning: the oldest unflagged items of a node except
+	   the selected one. As items might have no date the ever increasing
+	   item id is the secondary criterion. The removal trigger cleans up
+	   metadata and search folder entries. */
+	db_new_statement ("itemsetPruneSelectStmt",
+	                  "SELECT item_id," ITEM_SIZE_SQL " FROM items "
+	                  "WHERE node_id = ?1 AND marked = 0 AND item_id != ?3 "
+	                  "ORDER BY date, item_id LIMIT ?2");
+
+	db_new_statement ("itemsetPruneStmt",
+	                  "WITH surplus AS ("
+	                  "   SELECT item_id FROM items "
+	                  "   WHERE node_id = ?1 AND marked = 0 AND item_id != ?3 "
+	                  "   ORDER BY date, item_id LIMIT ?2) "
+	                  "DELETE FROM items WHERE item_id IN surplus "
+	                  "OR (comment = 1 AND parent_item_id IN surplus)");
+
+	/* Retention: unflagged items older than the given read/unread
+	   limits, a limit of 0 matches nothing, see retention.c */
+	db_new_statement ("itemsetExpireSelectStmt",
+	                  "SELECT item_id," ITEM_SIZE_SQL " FROM items "
+	                  "WHERE node_id = ?1 AND marked = 0 AND comment = 0 AND item_id != ?5 "
+	                  "AND ((read = 0 AND date < ?2) OR (read = 1 AND date < ?3)) "
+	                  "ORDER BY item_id LIMIT ?4");
+
+	db_new_statement ("itemsetExpireStmt",
+	                  "WITH expired AS ("
+	                  "   SELECT item_id FROM items "
+	                  "   WHERE node_id = ?1 AND marked = 0 AND comment = 0 AND item_id != ?5 "
+	                  "   AND ((read = 0 AND date < ?2) OR (read = 1 AND date < ?3)) "
+	                  "   ORDER BY item_id LIMIT ?4) "
+	                  "DELETE FROM items WHERE item_id IN expired "
+	                  "OR (comment = 1 AND parent_item_id IN expired)");
+
 	db_new_statement ("itemLoadStmt",
 	                  "SELECT "
 	                  "title,"
@@ -668,7 +848,8 @@ db_init (void)
 		          "item_id,"
 			  "parent_item_id, "
 		          "node_id, "
-			  "parent_node_id "
+			  "parent_node_id, "
+			  "packed_metadata "
 	                  " FROM items WHERE item_id = ?");
 
 	db_new_statement ("itemUpdateStmt",
@@ -688,28 +869,60 @@ db_init (void)
 	                  "item_id,"
 	                  "parent_item_id,"
 	                  "node_id,"
-	                  "parent_node_id"
-	                  ") values (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)");
+	                  "parent_node_id,"
+	                  "packed_metadata"
+	                  ") values (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)");
 
 	db_new_statement ("itemStateUpdateStmt",
 			  "UPDATE items SET read=?, marked=?, updated=? "
 			  "WHERE item_id=?");
 
 	db_new_statement ("duplicatesFindStmt",
-	                  "SELECT item_id FROM items WHERE source_id = ?");
+	                  "SELECT items.item_id FROM item_duplicates "
+	                  "JOIN items ON items.item_id = item_duplicates.item_id "
+	                  "WHERE item_duplicates.source_hash = ? AND items.source_id = ?");
 
 	db_new_statement ("duplicateNodesFindStmt",
-	                  "SELECT node_id FROM items WHERE item_id IN "
-			  "(SELECT item_id FROM items WHERE source_id = ?)");
+	                  "SELECT items.node_id FROM item_duplicates "
+	                  "JOIN items ON items.item_id = item_duplicates.item_id "
+	                  "WHERE item_duplicates.source_hash = ? AND items.source_id = ?");
+
+	db_new_statement ("duplicatesUnreadFindStmt",
+	                  "SELECT items.item_id, items.node_id FROM item_duplicates "
+	                  "JOIN items ON items.item_id = item_duplicates.item_id "
+	                  "WHERE item_duplicates.source_hash = ? AND items.source_id = ? AND items.read = 0");
 
 	db_new_statement ("duplicatesMarkReadStmt",
- 	                  "UPDATE items SET read = 1, updated = 0 WHERE source_id = ?");
+ 	                  "UPDATE items SET read = 1, updated = 0 "
+	                  "WHERE item_id IN (SELECT item_id FROM item_duplicates WHERE source_hash = ?) "
+	                  "AND source_id = ? AND node_id = ? AND read = 0");
 
 	db_new_statement ("metadataLoadStmt",
 	                  "SELECT key,value,nr FROM metadata WHERE item_id = ? ORDER BY nr");
 
-	db_new_statement ("metadataUpdateStmt",
-	                  "REPLACE INTO metadata (item_id,nr,key,value) VALUES (?,?,?,?)");
+	db_new_statement ("metadataRemoveStmt",
+	                  "DELETE FROM metadata WHERE item_id = ?");
+
+	db_new_statement ("itemExtractLoadStmt",
+	                  "SELECT title,content FROM item_extracts WHERE item_id = ? AND content_hash = ?");
+
+	db_new_statement ("itemExtractSaveStmt",
+	                  "REPLACE INTO item_extracts (item_id,content_hash,title,content) VALUES (?,?,?,?)");
+
+	db_new_statement ("enrichmentQueueLoadStmt",
+	                  "SELECT item_id,node_id,url,queued FROM enrichment_queue ORDER BY queued");
+
+	db_new_statement ("enrichmentQueueAddStmt",
+	                  "REPLACE INTO enrichment_queue (item_id,node_id,url,queued) VALUES (?,?,?,?)");
+
+	db_new_statement ("enrichmentQueueRemoveStmt",
+	                  "DELETE FROM enrichment_queue WHERE item_id = ?");
+
+	db_new_statement ("faviconHostsLoadStmt",
+	                  "SELECT key,icon_url,node_id,blogroll,etag,last_modified,checked,failed FROM favicon_hosts");
+
+	db_new_statement ("faviconHostSaveStmt",
+	                  "REPLACE INTO favicon_hosts (key,icon_url,node_id,blogroll,etag,last_modified,checked,failed) VALUES (?,?,?,?,?,?,?,?)");
 
 	db_new_statement ("subscriptionUpdateStmt",
 	                  "REPLACE INTO subscription ("
@@ -739,9 +952,15 @@ db_init (void)
 			  "FROM subscription "
 			  "WHERE node_id = ?");
 
+	db_new_statement ("subscriptionLoadAllStmt",
+	                  "SELECT node_id,discontinued FROM subscription");
+
 	db_new_statement ("subscriptionMetadataLoadStmt",
 	                  "SELECT key,value,nr FROM subscription_metadata WHERE node_id = ? ORDER BY nr");
 
+	db_new_statement ("subscriptionMetadataLoadAllStmt",
+	                  "SELECT key,value,node_id FROM subscription_metadata ORDER BY node_id,nr");
+
 	db_new_statement ("subscriptionMetadataUpdateStmt",
 	                  "REPLACE INTO subscription_metadata (node_id,nr,key,value) VALUES (?,?,?,?)");
 
@@ -763,6 +982,11 @@ db_init (void)
 	db_new_statement ("searchFolderUnreadCountStmt",
 	                  "SELECT count(items.item_id) FROM search_folder_items JOIN items ON search_folder_items.item_id = items.item_id WHERE search_folder_items.node_id = ? and items.read = 0;");
 
+	db_new_statement ("searchFolderCountAllStmt",
+	                  "SELECT search_folder_items.node_id,COUNT(search_folder_items.item_id),SUM(items.read = 0) "
+	                  "FROM search_folder_items LEFT JOIN items ON search_folder_items.item_id = items.item_id "
+	                  "GROUP BY search_folder_items.node_id;");
+
 	db_new_statement ("nodeIdListStmt",
 	                  "SELECT node_id FROM node;");
 
@@ -776,13 +1000,26 @@ db_init (void)
 	                  "last_favicon_poll,"
 			  "cookies,"
 	                  "etag,"
-	                  "last_update,"
 			  "max_age_minutes,"
 			  "syn_frequency,"
 			  "syn_period,"
 			  "ttl "
 	                  "FROM update_state "
 			  "WHERE node_id = ?");
+
+	db_new_statement ("updateStateLoadAllStmt",
+	                  "SELECT "
+	                  "last_modified,"
+			  "last_poll,"
+	                  "last_favicon_poll,"
+			  "cookies,"
+	                  "etag,"
+			  "max_age_minutes,"
+			  "syn_frequency,"
+			  "syn_period,"
+			  "ttl,"
+			  "node_id "
+	                  "FROM update_state");
 			 
 	db_new_statement ("updateStateSaveStmt",
 	                  "REPLACE INTO update_state "
@@ -848,33 +1085,21 @@ db_item_metadata_load(itemPtr item)
 	return metadata;
 }
 
+/* Items are stored with packed metadata, so all that is left
+   to do on update is to drop legacy rows of not yet migrated items */
 static void
-db_item_metadata_update_cb (const gchar *key,
-                            const gchar *value,
-                            guint index,
-                            gpointer user_data)
+db_item_metadata_update (itemPtr item)
 {
 	sqlite3_stmt	*stmt;
-	itemPtr		item = (itemPtr)user_data;
 	gint		res;
 
-	stmt = db_get_statement ("metadataUpdateStmt");
-	sqlite3_bind_int  (stmt, 1, item->id);
-	sqlite3_bind_int  (stmt, 2, index);
-	sqlite3_bind_text (stmt, 3, key, -1, SQLITE_TRANSIENT);
-	sqlite3_bind_text (stmt, 4, value, -1, SQLITE_TRANSIENT);
+	stmt = db_get_statement ("metadataRemoveStmt");
+	sqlite3_bind_int (stmt, 1, item->id);
 	res = sqlite3_step (stmt);
 	if (SQLITE_DONE != res)
-		g_warning ("Update in \"metadata\" table failed (error code=%d, %s)", res, sqlite3_errmsg (db));
+		g_warning ("Removing from \"metadata\" table failed (error code=%d, %s)", res, sqlite3_errmsg (db));
 
 	sqlite3_finalize (stmt);
-
-}
-
-static void
-db_item_metadata_update(itemPtr item)
-{
-	metadata_list_foreach(item->metadata, db_item_metadata_update_cb, item);
 }
 
 /* Item structure loading methods */
@@ -907,7 +1132,20 @@ db_load_item_from_columns (sqlite3_stmt *stmt)
 	else
 		item->description = g_strdup ("");
 
-	item->metadata = db_item_metadata_load (item);
+	if (SQLITE_BLOB == sqlite3_column_type (stmt, 16)) {
+		GBytes		*bytes;
+		GVariant	*packed;
+
+		bytes = g_bytes_new (sqlite3_column_blob (stmt, 16), sqlite3_column_bytes (stmt, 16));
+		packed = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (METADATA_VARIANT_TYPE), bytes, FALSE));
+		item->metadata = metadata_list_from_variant (packed);
+		item->hasEnclosure = (NULL != metadata_list_get_values (item->metadata, "enclosure"));
+		g_variant_unref (packed);
+		g_bytes_unref (bytes);
+	} else {
+		/* Item not yet migrated to packed metadata */
+		item->metadata = db_item_metadata_load (item);
+	}
 
 	return item;
 }
@@ -936,6 +1174,88 @@ db_itemset_load (const gchar *id)
 	return itemSet;
 }
 
+static void
+db_append_quoted_id_list (GString *sql, GSList *ids)
+{
+	GSList	*iter;
+
+	for (iter = ids; iter; iter = g_slist_next (iter)) {
+		gchar *quoted = sqlite3_mprintf ("%Q", (const gchar *)iter->data);
+		if (iter != ids)
+			g_string_append_c (sql, ',');
+		g_string_append (sql, quoted);
+		sqlite3_free (quoted);
+	}
+}
+
+itemSetPtr
+db_itemset_load_multiple (const gchar *id,
+                          GSList *nodeIds,
+                          GSList *searchFolderIds,
+                          nodeViewSortType sortColumn,
+                          gboolean sortReversed)
+{
+	sqlite3_stmt	*stmt;
+	itemSetPtr 	itemSet;
+	GString		*sql;
+	const gchar	*order;
+
+	debug (DEBUG_DB, "loading itemset for node \"%s\" (%u nodes, %u search folders)", id, g_slist_length (nodeIds), g_slist_length (searchFolderIds));
+	itemSet = g_new0 (struct itemSet, 1);
+	itemSet->nodeId = (gchar *)id;
+
+	if (!nodeIds && !searchFolderIds)
+		return itemSet;
+
+	/* The node id lists are inlined as quoted literals instead of being
+	   bound, as large folders easily exceed the host parameter limit. */
+	sql = g_string_new ("SELECT item_id FROM items WHERE ");
+	if (nodeIds) {
+		g_string_append (sql, "node_id IN (");
+		db_append_quoted_id_list (sql, nodeIds);
+		g_string_append (sql, ")");
+	}
+	if (searchFolderIds) {
+		if (nodeIds)
+			g_string_append (sql, " OR ");
+		g_string_append (sql, "item_id IN (SELECT item_id FROM search_folder_items WHERE node_id IN (");
+		db_append_quoted_id_list (sql, searchFolderIds);
+		g_string_append (sql, "))");
+	}
+
+	switch (sortColumn) {
+		case NODE_VIEW_SORT_BY_TITLE:
+			order = sortReversed?"title DESC":"title ASC";
+			break;
+		case NODE_VIEW_SORT_BY_PARENT:
+			order = sortReversed?"node_id DESC":"node_id ASC";
+			break;
+		case NODE_VIEW_SORT_BY_STATE:
+			order = sortReversed?"read DESC":"read ASC";
+			break;
+		case NODE_VIEW_SORT_BY_TIME:
+		default:
+			order = sortReversed?"date ASC":"date DESC";
+			break;
+	}
+	g_string_append_printf (sql, " ORDER BY %s", order);
+
+	db_prepare_stmt (&stmt, sql->str);
+	sqlite3_reset (stmt);
+
+	while (sqlite3_step (stmt) == SQLITE_ROW) {
+		itemSet->ids = g_list_prepend (itemSet->ids, GUINT_TO_POINTER (sqlite3_column_int (stmt, 0)));
+	}
+	itemSet->ids = g_list_reverse (itemSet->ids);
+
+	sqlite3_finalize (stmt);
+	g_string_free (sql, TRUE);
+
+	debug (DEBUG_DB, "loading of itemset finished (%u items)", g_list_length (itemSet->ids));
+
+	return itemSet;
+}
+
 itemPtr
 db_item_load (gulong id)
 {
@@ -1016,6 +1336,7 @@ void
 db_item_update (itemPtr item)
 {
 	sqlite3_stmt	*stmt;
+	GVariant	*packed;
 	gint		res;
 
 	debug (DEBUG_DB, "update of item \"%s\" (id=%lu)", item->title, item->id);
@@ -1044,6 +1365,13 @@ db_item_update (itemPtr item)
 	sqlite3_bind_text (stmt, 15, item->nodeId, -1, SQLITE_TRANSIENT);
 	sqlite3_bind_text (stmt, 16, item->parentNodeId, -1, SQLITE_TRANSIENT);
 
+	packed = metadata_list_to_variant (item->metadata);
+	if (g_variant_get_size (packed) > 0)
+		sqlite3_bind_blob (stmt, 17, g_variant_get_data (packed), g_variant_get_size (packed), SQLITE_TRANSIENT);
+	else
+		sqlite3_bind_zeroblob (stmt, 17, 0);	/* empty list, but still not a legacy item */
+	g_variant_unref (packed);
+
 	res = sqlite3_step (stmt);
 
 	if (SQLITE_DONE != res)
@@ -1117,7 +1445,8 @@ db_item_get_duplicates (const gchar *guid)
 
 
 	stmt = db_get_statement ("duplicatesFindStmt");
-	res = sqlite3_bind_text (stmt, 1, guid, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64 (stmt, 1, g_str_hash (guid));
+	res = sqlite3_bind_text (stmt, 2, guid, -1, SQLITE_TRANSIENT);
 	if (SQLITE_OK != res)
 		g_error ("db_item_get_duplicates: sqlite bind failed (error code %d)!", res);
 
@@ -1142,7 +1471,8 @@ db_item_get_duplicate_nodes (const gchar *guid)
 
 
 	stmt = db_get_statement ("duplicateNodesFindStmt");
-	res = sqlite3_bind_text (stmt, 1, guid, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64 (stmt, 1, g_str_hash (guid));
+	res = sqlite3_bind_text (stmt, 2, guid, -1, SQLITE_TRANSIENT);
 	if (SQLITE_OK != res)
 		g_error ("db_item_get_duplicates: sqlite bind failed (error code %d)!", res);
 
@@ -1158,6 +1488,216 @@ db_item_get_duplicate_nodes (const gchar *guid)
 	return duplicates;
 }
 
+GHashTable *
+db_item_get_unread_duplicates (const gchar *guid)
+{
+	GHashTable	*duplicates;
+	sqlite3_stmt	*stmt;
+	gint		res;
+
+	duplicates = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_slist_free);
+
+	stmt = db_get_statement ("duplicatesUnreadFindStmt");
+	sqlite3_bind_int64 (stmt, 1, g_str_hash (guid));
+	res = sqlite3_bind_text (stmt, 2, guid, -1, SQLITE_TRANSIENT);
+	if (SQLITE_OK != res)
+		g_error ("db_item_get_unread_duplicates: sqlite bind failed (error code %d)!", res);
+
+	while (sqlite3_step (stmt) == SQLITE_ROW) {
+		const gchar	*nodeId = (const gchar *) sqlite3_column_text (stmt, 1);
+		gulong		id = sqlite3_column_int (stmt, 0);
+		gpointer	key = NULL, ids = NULL;
+
+		if (!nodeId)
+			continue;
+
+		if (!g_hash_table_steal_extended (duplicates, nodeId, &key, &ids))
+			key = g_strdup (nodeId);
+		g_hash_table_insert (duplicates, key, g_slist_prepend ((GSList *)ids, GUINT_TO_POINTER (id)));
+	}
+
+	sqlite3_finalize (stmt);
+
+	return duplicates;
+}
+
+guint
+db_item_duplicates_mark_read (const gchar *guid, const gchar *nodeId, GSList *ids)
+{
+	sqlite3_stmt	*stmt;
+	gint		res;
+	guint		changes = 0;
+	GSList		*iter;
+
+	db_begin_transaction ();
+
+	stmt = db_get_statement ("duplicatesMarkReadStmt");
+	sqlite3_bind_int64 (stmt, 1, g_str_hash (guid));
+	sqlite3_bind_text (stmt, 2, guid, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 3, nodeId, -1, SQLITE_TRANSIENT);
+	res = sqlite3_step (stmt);
+
+	if (SQLITE_DONE == res)
+		changes = sqlite3_changes (db);
+	else
+		g_warning ("marking duplicates read failed (error code=%d, %s)", res, sqlite3_errmsg (db));
+
+	sqlite3_finalize (stmt);
+
+	/* The set based update bypasses db_item_state_update(),
+	   so search folder rules on the read state are applied here */
+	for (iter = changes?ids:NULL; iter; iter = g_slist_next (iter)) {
+		itemPtr item = db_item_load (GPOINTER_TO_UINT (iter->data));
+		if (item) {
+			db_item_search_folders_update (item);
+			g_object_unref (item);
+		}
+	}
+
+	db_end_transaction ();
+
+	debug (DEBUG_DB, "marked %u duplicates of \"%s\" in node %s read", changes, guid, nodeId);
+
+	return changes;
+}
+
+gboolean
+db_item_extract_load (gulong id, const gchar *hash, gchar **title, gchar **content)
+{
+	sqlite3_stmt	*stmt;
+	gboolean	found = FALSE;
+
+	stmt = db_get_statement ("itemExtractLoadStmt");
+	sqlite3_bind_int (stmt, 1, id);
+	sqlite3_bind_text (stmt, 2, hash, -1, SQLITE_TRANSIENT);
+
+	if (sqlite3_step (stmt) == SQLITE_ROW) {
+		*title = g_strdup ((const gchar *) sqlite3_column_text (stmt, 0));
+		*content = g_strdup ((const gchar *) sqlite3_column_text (stmt, 1));
+		found = TRUE;
+	}
+
+	sqlite3_finalize (stmt);
+
+	return found;
+}
+
+void
+db_item_extract_save (gulong id, const gchar *hash, const gchar *title, const gchar *content)
+{
+	sqlite3_stmt	*stmt;
+	gint		res;
+
+	stmt = db_get_statement ("itemExtractSaveStmt");
+	sqlite3_bind_int (stmt, 1, id);
+	sqlite3_bind_text (stmt, 2, hash, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 3, title, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 4, content, -1, SQLITE_TRANSIENT);
+	res = sqlite3_step (stmt);
+
+	if (SQLITE_DONE != res)
+		g_warning ("saving extraction result of item #%lu failed (error code=%d, %s)", id, res, sqlite3_errmsg (db));
+
+	sqlite3_finalize (stmt);
+}
+
+void
+db_enrichment_queue_load (dbEnrichmentLoadFunc func, gpointer user_data)
+{
+	sqlite3_stmt	*stmt;
+
+	stmt = db_get_statement ("enrichmentQueueLoadStmt");
+	while (sqlite3_step (stmt) == SQLITE_ROW) {
+		(*func) (sqlite3_column_int (stmt, 0),
+		         (const gchar *) sqlite3_column_text (stmt, 1),
+		         (const gchar *) sqlite3_column_text (stmt, 2),
+		         sqlite3_column_int64 (stmt, 3),
+		         user_data);
+	}
+
+	sqlite3_finalize (stmt);
+}
+
+void
+db_enrichment_queue_add (gulong id, const gchar *nodeId, const gchar *url, gint64 queued)
+{
+	sqlite3_stmt	*stmt;
+	gint		res;
+
+	stmt = db_get_statement ("enrichmentQueueAddStmt");
+	sqlite3_bind_int (stmt, 1, id);
+	sqlite3_bind_text (stmt, 2, nodeId, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 3, url, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64 (stmt, 4, queued);
+	res = sqlite3_step (stmt);
+
+	if (SQLITE_DONE != res)
+		g_warning ("queuing content extraction of item #%lu failed (error code=%d, %s)", id, res, sqlite3_errmsg (db));
+
+	sqlite3_finalize (stmt);
+}
+
+void
+db_enrichment_queue_remove (gulong id)
+{
+	sqlite3_stmt	*stmt;
+	gint		res;
+
+	stmt = db_get_statement ("enrichmentQueueRemoveStmt");
+	sqlite3_bind_int (stmt, 1, id);
+	res = sqlite3_step (stmt);
+
+	if (SQLITE_DONE != res)
+		g_warning ("dequeuing content extraction of item #%lu failed (error code=%d, %s)", id, res, sqlite3_errmsg (db));
+
+	sqlite3_finalize (stmt);
+}
+
+void
+db_favicon_hosts_load (dbFaviconHostLoadFunc func, gpointer user_data)
+{
+	sqlite3_stmt	*stmt;
+
+	stmt = db_get_statement ("faviconHostsLoadStmt");
+	while (sqlite3_step (stmt) == SQLITE_ROW) {
+		(*func) ((const gchar *) sqlite3_column_text (stmt, 0),
+		         (const gchar *) sqlite3_column_text (stmt, 1),
+		         (const gchar *) sqlite3_column_text (stmt, 2),
+		         (const gchar *) sqlite3_column_text (stmt, 3),
+		         (const gchar *) sqlite3_column_text (stmt, 4),
+		         (const gchar *) sqlite3_column_text (stmt, 5),
+		         sqlite3_column_int64 (stmt, 6),
+		         sqlite3_column_int (stmt, 7),
+		         user_data);
+	}
+
+	sqlite3_finalize (stmt);
+}
+
+void
+db_favicon_host_save (const gchar *key, const gchar *iconUrl, const gchar *nodeId, const gchar *blogroll,
+                      const gchar *etag, const gchar *lastModified, gint64 checked, gboolean failed)
+{
+	sqlite3_stmt	*stmt;
+	gint		res;
+
+	stmt = db_get_statement ("faviconHostSaveStmt");
+	sqlite3_bind_text (stmt, 1, key, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 2, iconUrl, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 3, nodeId, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 4, blogroll, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 5, etag, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 6, lastModified, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64 (stmt, 7, checked);
+	sqlite3_bind_int (stmt, 8, failed?1:0);
+	res = sqlite3_step (stmt);
+
+	if (SQLITE_DONE != res)
+		g_warning ("saving favicon discovery result for %s failed (error code=%d, %s)", key, res, sqlite3_errmsg (db));
+
+	sqlite3_finalize (stmt);
+}
+
 void
 db_itemset_remove_all (const gchar *id)
 {
@@ -1178,6 +1718,84 @@ db_itemset_remove_all (const gchar *id)
 
 }
 
+/* Collects the ids and sizes of the items selected by stmt and
+   runs the delete statement with the same parameters */
+static GArray *
+db_itemset_delete_selected (sqlite3_stmt *select, sqlite3_stmt *delete, guint64 *bytes)
+{
+	GArray	*ids;
+	gint	res;
+
+	ids = g_array_new (FALSE, FALSE, sizeof (gulong));
+	while (sqlite3_step (select) == SQLITE_ROW) {
+		gulong itemId = sqlite3_column_int (select, 0);
+		g_array_append_val (ids, itemId);
+		if (bytes)
+			*bytes += sqlite3_column_int64 (select, 1);
+	}
+	sqlite3_finalize (select);
+
+	if (ids->len) {
+		res = sqlite3_step (delete);
+		if (SQLITE_DONE != res)
+			g_warning ("removing items failed (error code=%d, %s)", res, sqlite3_errmsg (db));
+	}
+	sqlite3_finalize (delete);
+
+	return ids;
+}
+
+GArray *
+db_itemset_prune (const gchar *id, guint count, gulong keepId, guint64 *bytes)
+{
+	sqlite3_stmt	*select, *delete;
+	GArray		*ids;
+
+	if (!count)
+		return g_array_new (FALSE, FALSE, sizeof (gulong));
+
+	/* The ids are needed for the GUI notification, the delete itself
+	   works on the same set so the selection and the delete agree */
+	select = db_get_statement ("itemsetPruneSelectStmt");
+	delete = db_get_statement ("itemsetPruneStmt");
+	sqlite3_bind_text (select, 1, id, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int (select, 2, count);
+	sqlite3_bind_int (select, 3, keepId);
+	sqlite3_bind_text (delete, 1, id, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int (delete, 2, count);
+	sqlite3_bind_int (delete, 3, keepId);
+
+	ids = db_itemset_delete_selected (select, delete, bytes);
+
+	debug (DEBUG_DB, "pruned %u of %u items for item set %s", ids->len, count, id);
+
+	return ids;
+}
+
+GArray *
+db_itemset_expire (const gchar *id, gint64 unreadBefore, gint64 readBefore, guint limit, gulong keepId, guint64 *bytes)
+{
+	sqlite3_stmt	*stmts[2];
+	GArray		*ids;
+	guint		i;
+
+	stmts[0] = db_get_statement ("itemsetExpireSelectStmt");
+	stmts[1] = db_get_statement ("itemsetExpireStmt");
+	for (i = 0; i < 2; i++) {
+		sqlite3_bind_text (stmts[i], 1, id, -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int64 (stmts[i], 2, unreadBefore);
+		sqlite3_bind_int64 (stmts[i], 3, readBefore);
+		sqlite3_bind_int (stmts[i], 4, limit);
+		sqlite3_bind_int (stmts[i], 5, keepId);
+	}
+
+	ids = db_itemset_delete_selected (stmts[0], stmts[1], bytes);
+
+	debug (DEBUG_DB, "expired %u items for item set %s", ids->len, id);
+
+	return ids;
+}
+
 gboolean
 db_itemset_get (itemSetPtr itemSet, gulong offset, guint limit)
 {
@@ -1200,8 +1818,190 @@ db_itemset_get (itemSetPtr itemSet, gulong offset, guint limit)
 	return success;
 }
 
+/* Consistency passes, run in small batches by db_maintenance.c.
+   Each pass walks a table by rowid and deletes the rows matching
+   the condition. */
+
+typedef struct dbCleanupPass {
+	const gchar	*name;
+	const gchar	*table;
+	const gchar	*condition;
+} dbCleanupPass;
+
+static const dbCleanupPass cleanupPasses[] = {
+	/* Note: do not check on subscriptions here, as non-subscription node
+	   types (e.g. news bin) do contain items too. Legacy comment items
+	   are dropped too, which also covers comments without parent item. */
+	{ "items",			"items",		"comment = 1 OR node_id NOT IN (SELECT node_id FROM node)" },
+	{ "search_folder_items",	"search_folder_items",	"parent_node_id NOT IN (SELECT node_id FROM node) OR "
+								"node_id NOT IN (SELECT node_id FROM node)" },
+	{ "subscription_metadata",	"subscription_metadata","node_id NOT IN (SELECT node_id FROM node)" },
+	{ "metadata",			"metadata",		"item_id NOT IN (SELECT item_id FROM items)" },
+	{ "item_duplicates",		"item_duplicates",	"item_id NOT IN (SELECT item_id FROM items)" },
+	{ "item_extracts",		"item_extracts",	"item_id NOT IN (SELECT item_id FROM items)" },
+	{ "enrichment_queue",		"enrichment_queue",	"item_id NOT IN (SELECT item_id FROM items)" }
+};
+
+guint
+db_cleanup_get_pass_count (void)
+{
+	return G_N_ELEMENTS (cleanupPasses);
+}
+
+const gchar *
+db_cleanup_get_pass_name (guint pass)
+{
+	g_return_val_if_fail (pass < G_N_ELEMENTS (cleanupPasses), NULL);
+
+	return cleanupPasses[pass].name;
+}
+
+gint64
+db_cleanup_get_end (guint pass)
+{
+	sqlite3_stmt	*stmt;
+	gchar		*sql;
+	gint64		end = 0;
+
+	g_return_val_if_fail (pass < G_N_ELEMENTS (cleanupPasses), 0);
+
+	sql = sqlite3_mprintf ("SELECT MAX(rowid) FROM %s", cleanupPasses[pass].table);
+	db_prepare_stmt (&stmt, sql);
+	if (SQLITE_ROW == sqlite3_step (stmt))
+		end = sqlite3_column_int64 (stmt, 0);
+	sqlite3_finalize (stmt);
+	sqlite3_free (sql);
+
+	return end;
+}
+
+guint
+db_cleanup_step (guint pass, gint64 *position, gint64 end, guint batch)
+{
+	const dbCleanupPass	*p;
+	sqlite3_stmt		*stmt;
+	gchar			*sql;
+	gint64			batchEnd = end;
+	gint			res;
+	guint			changes = 0;
+
+	g_return_val_if_fail (pass < G_N_ELEMENTS (cleanupPasses), 0);
+	p = &cleanupPasses[pass];
+
+	/* Find the last rowid of the next batch */
+	sql = sqlite3_mprintf ("SELECT MAX(rowid) FROM (SELECT rowid FROM %s WHERE rowid > ? AND rowid <= ? ORDER BY rowid LIMIT ?)", p->table);
+	db_prepare_stmt (&stmt, sql);
+	sqlite3_bind_int64 (stmt, 1, *position);
+	sqlite3_bind_int64 (stmt, 2, end);
+	sqlite3_bind_int (stmt, 3, batch);
+	if (SQLITE_ROW == sqlite3_step (stmt) && SQLITE_NULL != sqlite3_column_type (stmt, 0))
+		batchEnd = sqlite3_column_int64 (stmt, 0);
+	sqlite3_finalize (stmt);
+	sqlite3_free (sql);
+
+	sql = sqlite3_mprintf ("DELETE FROM %s WHERE rowid > ? AND rowid <= ? AND (%s)", p->table, p->condition);
+	db_prepare_stmt (&stmt, sql);
+	sqlite3_bind_int64 (stmt, 1, *position);
+	sqlite3_bind_int64 (stmt, 2, batchEnd);
+	res = sqlite3_step (stmt);
+	if (SQLITE_DONE == res)
+		changes = sqlite3_changes (db);
+	else
+		g_warning ("Cleanup of %s failed (error code=%d, %s)", p->name, res, sqlite3_errmsg (db));
+	sqlite3_finalize (stmt);
+	sqlite3_free (sql);
+
+	*position = batchEnd;
+
+	return changes;
+}
+
+gint64
+db_info_get_int64 (const gchar *name, gint64 defaultValue)
+{
+	sqlite3_stmt	*stmt;
+	gint64		value = defaultValue;
+
+	db_prepare_stmt (&stmt, "SELECT value FROM info WHERE name = ?");
+	sqlite3_bind_text (stmt, 1, name, -1, SQLITE_TRANSIENT);
+	if (SQLITE_ROW == sqlite3_step (stmt))
+		value = sqlite3_column_int64 (stmt, 0);
+	sqlite3_finalize (stmt);
+
+	return value;
+}
+
+void
+db_info_set_int64 (const gchar *name, gint64 value)
+{
+	sqlite3_stmt	*stmt;
+	gint		res;
+
+	db_prepare_stmt (&stmt, "REPLACE INTO info (name, value) VALUES (?,?)");
+	sqlite3_bind_text (stmt, 1, name, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64 (stmt, 2, value);
+	res = sqlite3_step (stmt);
+	if (SQLITE_DONE != res)
+		g_warning ("Could not save info %s (error code %d)!", name, res);
+	sqlite3_finalize (stmt);
+}
+
 /* Statistics interface */
 
+/* Counters of all item sets and search folders queried at once while
+   the feed list is set up, see db_counters_preload() */
+
+typedef struct dbCounters {
+	guint	itemCount;
+	guint	unreadCount;
+} dbCounters;
+
+static GHashTable *itemsetCounters = NULL;
+static GHashTable *searchFolderCounters = NULL;
+
+static GHashTable *
+db_counters_query (const gchar *statement)
+{
+	GHashTable	*counters = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	sqlite3_stmt	*stmt;
+
+	stmt = db_get_statement (statement);
+	while (sqlite3_step (stmt) == SQLITE_ROW) {
+		dbCounters *c = g_new0 (dbCounters, 1);
+
+		c->itemCount = sqlite3_column_int (stmt, 1);
+		c->unreadCount = sqlite3_column_int (stmt, 2);
+		g_hash_table_insert (counters, g_strdup ((const gchar *) sqlite3_column_text (stmt, 0)), c);
+	}
+	sqlite3_finalize (stmt);
+
+	return counters;
+}
+
+void
+db_counters_preload (void)
+{
+	db_counters_drop ();
+	itemsetCounters = db_counters_query ("itemsetCountAllStmt");
+	searchFolderCounters = db_counters_query ("searchFolderCountAllStmt");
+}
+
+void
+db_counters_drop (void)
+{
+	g_clear_pointer (&itemsetCounters, g_hash_table_destroy);
+	g_clear_pointer (&searchFolderCounters, g_hash_table_destroy);
+}
+
+static const dbCounters *
+db_counters_lookup (GHashTable *counters, const gchar *id)
+{
+	static const dbCounters empty = { 0, 0 };
+	const dbCounters *c = g_hash_table_lookup (counters, id);
+
+	return c?c:&empty;
+}
+
 guint
 db_itemset_get_unread_count (const gchar *id)
 {
@@ -1209,6 +2009,8 @@ db_itemset_get_unread_count (const gchar *id)
 	gint		res;
 	guint		count = 0;
 
+	if (itemsetCounters)
+		return db_counters_lookup (itemsetCounters, id)->unreadCount;
 
 	stmt = db_get_statement ("itemsetReadCountStmt");
 	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
@@ -1232,6 +2034,8 @@ db_itemset_get_item_count (const gchar *id)
 	gint		res;
 	guint		count = 0;
 
+	if (itemsetCounters)
+		return db_counters_lookup (itemsetCounters, id)->itemCount;
 
 	stmt = db_get_statement ("itemsetItemCountStmt");
 	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
@@ -1248,6 +2052,91 @@ db_itemset_get_item_count (const gchar *id)
 	return count;
 }
 
+gulong
+db_itemset_find_source_id (const gchar *id, const gchar *sourceId)
+{
+	sqlite3_stmt 	*stmt;
+	gulong		itemId = 0;
+
+	stmt = db_get_statement ("itemsetSourceIdStmt");
+	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 2, sourceId, -1, SQLITE_TRANSIENT);
+	if (SQLITE_ROW == sqlite3_step (stmt))
+		itemId = sqlite3_column_int (stmt, 0);
+
+	sqlite3_finalize (stmt);
+
+	return itemId;
+}
+
+GHashTable *
+db_itemset_get_source_states (const gchar *id)
+{
+	sqlite3_stmt 	*stmt;
+	GHashTable	*states;
+
+	states = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	stmt = db_get_statement ("itemsetSourceStatesStmt");
+	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
+	while (SQLITE_ROW == sqlite3_step (stmt)) {
+		dbSourceState *state = g_new0 (dbSourceState, 1);
+
+		state->itemId = sqlite3_column_int (stmt, 1);
+		state->read = (sqlite3_column_int (stmt, 2) > 0);
+		state->flagged = (sqlite3_column_int (stmt, 3) > 0);
+		g_hash_table_insert (states, g_strdup ((const gchar *)sqlite3_column_text (stmt, 0)), state);
+	}
+
+	sqlite3_finalize (stmt);
+
+	return states;
+}
+
+gchar *
+db_itemset_get_revision (const gchar *id)
+{
+	sqlite3_stmt 	*stmt;
+	gchar		*revision = NULL;
+
+	stmt = db_get_statement ("itemsetRevisionStmt");
+	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
+	if (SQLITE_ROW == sqlite3_step (stmt))
+		revision = g_strdup_printf ("%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT ":%.0f",
+		                            (gint64)sqlite3_column_int64 (stmt, 0),
+		                            (gint64)sqlite3_column_int64 (stmt, 1),
+		                            (gint64)sqlite3_column_int64 (stmt, 2),
+		                            (gint64)sqlite3_column_int64 (stmt, 3),
+		                            (gint64)sqlite3_column_int64 (stmt, 4),
+		                            sqlite3_column_double (stmt, 5));
+
+	sqlite3_finalize (stmt);
+
+	return revision;
+}
+
+guint
+db_itemset_remove_foreign (const gchar *id, const gchar *prefix)
+{
+	sqlite3_stmt 	*stmt;
+	gint		res;
+	guint		count = 0;
+
+	stmt = db_get_statement ("itemsetRemoveForeignStmt");
+	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 2, prefix, -1, SQLITE_TRANSIENT);
+	res = sqlite3_step (stmt);
+
+	if (SQLITE_DONE == res)
+		count = sqlite3_changes (db);
+	else
+		g_warning ("removing foreign items of %s failed (error code=%d, %s)", id, res, sqlite3_errmsg (db));
+
+	sqlite3_finalize (stmt);
+
+	return count;
+}
+
 /* This method is only used for migration from old schema versions */
 static void
 db_view_remove_triggers (const gchar *id)
@@ -1406,6 +2295,8 @@ db_search_folder_get_item_count (const gchar *id)
 	gint		res;
 	guint		count = 0;
 
+	if (searchFolderCounters)
+		return db_counters_lookup (searchFolderCounters, id)->itemCount;
 
 	stmt = db_get_statement ("searchFolderCountStmt");
 	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
@@ -1429,6 +2320,8 @@ db_search_folder_get_unread_count (const gchar *id)
 	gint		res;
 	guint		count = 0;
 
+	if (searchFolderCounters)
+		return db_counters_lookup (searchFolderCounters, id)->unreadCount;
 
 	stmt = db_get_statement ("searchFolderUnreadCountStmt");
 	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
@@ -1445,6 +2338,21 @@ db_search_folder_get_unread_count (const gchar *id)
 	return count;
 }
 
+/* Reads the update state columns as selected by "updateStateLoadStmt" */
+static void
+db_update_state_from_row (sqlite3_stmt *stmt, updateStatePtr updateState)
+{
+	updateState->lastModified	= g_strdup ((const gchar *) sqlite3_column_text (stmt, 0));
+	updateState->lastPoll		= sqlite3_column_int64 (stmt, 1);
+	updateState->lastFaviconPoll	= sqlite3_column_int64 (stmt, 2);
+	updateState->cookies		= g_strdup ((const gchar *) sqlite3_column_text (stmt, 3));
+	updateState->etag		= g_strdup ((const gchar *) sqlite3_column_text (stmt, 4));
+	updateState->maxAgeMinutes	= sqlite3_column_int (stmt, 5);
+	updateState->synFrequency	= sqlite3_column_int (stmt, 6);
+	updateState->synPeriod		= sqlite3_column_int (stmt, 7);
+	updateState->timeToLive		= sqlite3_column_int (stmt, 8);
+}
+
 gboolean
 db_update_state_load (const gchar *id,
                       updateStatePtr updateState)
@@ -1459,15 +2367,7 @@ db_update_state_load (const gchar *id,
 
 	res = sqlite3_step (stmt);
 	if (SQLITE_ROW == res) {
-		updateState->lastModified	= g_strdup ((const gchar *) sqlite3_column_text (stmt, 0));
-		updateState->lastPoll		= sqlite3_column_int64 (stmt, 1);
-		updateState->lastFaviconPoll	= sqlite3_column_int64 (stmt, 2);
-		updateState->cookies		= g_strdup ((const gchar *) sqlite3_column_text (stmt, 3));
-		updateState->etag		= g_strdup ((const gchar *) sqlite3_column_text (stmt, 4));
-		updateState->maxAgeMinutes	= sqlite3_column_int (stmt, 5);
-		updateState->synFrequency	= sqlite3_column_int (stmt, 6);
-		updateState->synPeriod		= sqlite3_column_int (stmt, 7);
-		updateState->timeToLive		= sqlite3_column_int (stmt, 8);
+		db_update_state_from_row (stmt, updateState);
 	} else {
 		debug (DEBUG_DB, "Could not load update state for subscription %s (error code %d)!", id, res);
 	}
@@ -1583,6 +2483,51 @@ db_subscription_load (subscriptionPtr subscription)
 	subscription->metadata = db_subscription_metadata_load (subscription->node->id);
 }
 
+void
+db_subscriptions_load (GHashTable *subscriptions)
+{
+	GHashTableIter	iter;
+	gpointer	value;
+	sqlite3_stmt	*stmt;
+	subscriptionPtr	subscription;
+
+	/* Same as db_subscription_load() for all subscriptions at once */
+	g_hash_table_iter_init (&iter, subscriptions);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		subscription = (subscriptionPtr)value;
+		if (subscription->metadata) {
+			metadata_list_free (subscription->metadata);
+			subscription->metadata = NULL;
+		}
+	}
+
+	stmt = db_get_statement ("subscriptionLoadAllStmt");
+	while (sqlite3_step (stmt) == SQLITE_ROW) {
+		subscription = g_hash_table_lookup (subscriptions, sqlite3_column_text (stmt, 0));
+		if (subscription)
+			subscription->discontinued = sqlite3_column_int (stmt, 1);
+	}
+	sqlite3_finalize (stmt);
+
+	stmt = db_get_statement ("updateStateLoadAllStmt");
+	while (sqlite3_step (stmt) == SQLITE_ROW) {
+		subscription = g_hash_table_lookup (subscriptions, sqlite3_column_text (stmt, 9));
+		if (subscription)
+			db_update_state_from_row (stmt, subscription->updateState);
+	}
+	sqlite3_finalize (stmt);
+
+	stmt = db_get_statement ("subscriptionMetadataLoadAllStmt");
+	while (sqlite3_step (stmt) == SQLITE_ROW) {
+		subscription = g_hash_table_lookup (subscriptions, sqlite3_column_text (stmt, 2));
+		if (subscription)
+			subscription->metadata = db_metadata_list_append (subscription->metadata,
+			                                                  (const char *) sqlite3_column_text (stmt, 0),
+			                                                  (const char *) sqlite3_column_text (stmt, 1));
+	}
+	sqlite3_finalize (stmt);
+}
+
 void
 db_subscription_update (subscriptionPtr subscription)
 {
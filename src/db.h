@@ -25,6 +25,7 @@
 
 #include "item.h"
 #include "itemset.h"
+#include "node_view.h"
 #include "subscription.h"
 #include "update.h"
 
@@ -38,6 +39,18 @@ void    db_init (void);
  */
 void    db_deinit (void);
 
+/**
+ * Starts a transaction to group many DB writes (e.g. when
+ * importing a feed list). Transactions can be nested, only
+ * the outermost one is committed.
+ */
+void	db_begin_transaction (void);
+
+/**
+ * Ends a transaction started with db_begin_transaction().
+ */
+void	db_end_transaction (void);
+
 /* item set access (note: item sets are identified by the node id string) */
 
 /**
@@ -49,6 +62,24 @@ void    db_deinit (void);
  */
 itemSetPtr	db_itemset_load (const gchar *id);
 
+/**
+ * Loads the items of several nodes with a single query. Used for
+ * folders which aggregate the items of all their descendants.
+ *
+ * @param id			the node id the item set is for
+ * @param nodeIds		list of node ids whose items to include
+ * @param searchFolderIds	list of search folder ids whose items to include
+ * @param sortColumn		the sort attribute
+ * @param sortReversed		TRUE if sort order is to be reversed
+ *
+ * @returns a newly allocated item set, must be freed using itemset_free()
+ */
+itemSetPtr	db_itemset_load_multiple (const gchar *id,
+		                          GSList *nodeIds,
+		                          GSList *searchFolderIds,
+		                          nodeViewSortType sortColumn,
+		                          gboolean sortReversed);
+
 /**
  * Removes all items of the given item set from the DB.
  *
@@ -56,6 +87,122 @@ itemSetPtr	db_itemset_load (const gchar *id);
  */
 void	db_itemset_remove_all (const gchar *id);
 
+/**
+ * Removes the oldest unflagged items of the given item set from
+ * the DB using a single statement. Comments, metadata and search
+ * folder entries of the items are removed too.
+ *
+ * @param id		the node id
+ * @param count		number of items to remove
+ * @param keepId	id of an item never to remove (e.g. the selected one) or 0
+ * @param bytes		if not NULL the approximate size of the removed
+ *			items is added here
+ *
+ * @returns array of the removed item ids (gulong), to be freed with g_array_unref()
+ */
+GArray * db_itemset_prune (const gchar *id, guint count, gulong keepId, guint64 *bytes);
+
+/**
+ * Removes up to limit unflagged items of the given item set that
+ * are older than the given dates from the DB using a single statement.
+ * Comments, metadata and search folder entries of the items are
+ * removed too.
+ *
+ * @param id		the node id
+ * @param unreadBefore	remove unread items older than this [s since epoch], 0 to keep all
+ * @param readBefore	remove read items older than this [s since epoch], 0 to keep all
+ * @param limit		maximum number of items to remove
+ * @param keepId	id of an item never to remove (e.g. the selected one) or 0
+ * @param bytes		if not NULL the approximate size of the removed
+ *			items is added here
+ *
+ * @returns array of the removed item ids (gulong), to be freed with g_array_unref()
+ */
+GArray * db_itemset_expire (const gchar *id, gint64 unreadBefore, gint64 readBefore, guint limit, gulong keepId, guint64 *bytes);
+
+typedef struct dbSpaceStats {
+	gint		pageSize;	/*<< page size in bytes */
+	gint		pageCount;	/*<< total number of pages */
+	gint		freelistCount;	/*<< number of unused pages */
+	gboolean	incremental;	/*<< TRUE if incremental auto-vacuum is enabled */
+} dbSpaceStats;
+
+/**
+ * Returns page and free list counts of the DB.
+ *
+ * @param stats		structure to fill
+ */
+void	db_get_space_stats (dbSpaceStats *stats);
+
+/**
+ * Returns up to the given number of free pages to the file system.
+ * Only effective with incremental auto-vacuum.
+ *
+ * @param pages		maximum number of pages to reclaim
+ *
+ * @returns the number of pages reclaimed
+ */
+guint	db_incremental_vacuum (guint pages);
+
+/**
+ * Runs a passive WAL checkpoint which does not wait for readers
+ * or writers.
+ *
+ * @returns the number of WAL frames not yet checkpointed
+ */
+gint	db_checkpoint (void);
+
+/**
+ * Returns the number of DB consistency passes.
+ */
+guint	db_cleanup_get_pass_count (void);
+
+/**
+ * Returns the name of a DB consistency pass.
+ *
+ * @param pass	the pass index
+ */
+const gchar * db_cleanup_get_pass_name (guint pass);
+
+/**
+ * Returns the highest rowid a consistency pass has to check.
+ * Rows added later are not checked.
+ *
+ * @param pass	the pass index
+ */
+gint64	db_cleanup_get_end (guint pass);
+
+/**
+ * Checks the next batch of rows of a consistency pass and deletes
+ * orphaned rows.
+ *
+ * @param pass		the pass index
+ * @param position	rowid the previous batch ended with (0 to start),
+ *			is set to the rowid this batch ended with
+ * @param end		rowid as returned by db_cleanup_get_end()
+ * @param batch		number of rows to check
+ *
+ * @returns the number of rows deleted. The pass is finished
+ * when position reaches end.
+ */
+guint	db_cleanup_step (guint pass, gint64 *position, gint64 end, guint batch);
+
+/**
+ * Reads an integer value from the info table.
+ *
+ * @param name		the value name
+ * @param defaultValue	value to return if there is none
+ */
+gint64	db_info_get_int64 (const gchar *name, gint64 defaultValue);
+
+/**
+ * Saves an integer value to the info table.
+ *
+ * @param name		the value name
+ * @param value		the value
+ */
+void	db_info_set_int64 (const gchar *name, gint64 value);
+
 /**
  * Returns the number of unread items for the given item set.
  *
@@ -74,6 +221,58 @@ guint	db_itemset_get_unread_count (const gchar *id);
  */
 guint   db_itemset_get_item_count (const gchar *id);
 
+/**
+ * Looks up an item of the given item set by its source id
+ * (e.g. the remote id of an online account item).
+ *
+ * @param id		the node id
+ * @param sourceId	the source id to look for
+ *
+ * @returns the item id or 0 if there is no such item
+ */
+gulong	db_itemset_find_source_id (const gchar *id, const gchar *sourceId);
+
+typedef struct dbSourceState {
+	gulong		itemId;		/*<< the item id */
+	gboolean	read;		/*<< read state */
+	gboolean	flagged;	/*<< flag state */
+} dbSourceState;
+
+/**
+ * Returns the state of all items of the given item set that have
+ * a source id, without loading the items. Allows to match the state
+ * reported by online accounts against the local state as set
+ * operation.
+ *
+ * @param id		the node id
+ *
+ * @returns a hash table source id -> dbSourceState, to be free'd
+ *	    with g_hash_table_destroy()
+ */
+GHashTable * db_itemset_get_source_states (const gchar *id);
+
+/**
+ * Returns a revision marker of the given item set that changes when
+ * items are added or removed or their state, date or text changes.
+ * Allows to detect changes without loading the items.
+ *
+ * @param id		the node id
+ *
+ * @returns a new string, to be free'd with g_free()
+ */
+gchar * db_itemset_get_revision (const gchar *id);
+
+/**
+ * Removes all items of the given item set with a source id that
+ * does not start with the given prefix using a single statement.
+ *
+ * @param id		the node id
+ * @param prefix	the source id prefix of items to keep
+ *
+ * @returns the number of removed items
+ */
+guint	db_itemset_remove_foreign (const gchar *id, const gchar *prefix);
+
 /**
  * Returns a batch of items starting with the given
  * offset and no more than the given limit.
@@ -138,6 +337,108 @@ GSList * db_item_get_duplicates(const gchar *guid);
  */
 GSList * db_item_get_duplicate_nodes(const gchar *guid);
 
+/**
+ * Returns the unread items with the given GUID grouped by node.
+ *
+ * @param guid	the item GUID
+ *
+ * @returns a hash table of node ids to lists of item ids
+ * (to be free'd using g_hash_table_destroy)
+ */
+GHashTable * db_item_get_unread_duplicates (const gchar *guid);
+
+/**
+ * Marks all items with the given GUID in the given node as read
+ * using a single update on the duplicate group. To be used for
+ * nodes without remote read state only.
+ *
+ * @param guid		the item GUID
+ * @param nodeId	the node whose duplicates are to be changed
+ * @param ids		ids of the unread duplicates in the node, their
+ *			search folder membership is updated too
+ *
+ * @returns the number of items changed
+ */
+guint db_item_duplicates_mark_read (const gchar *guid, const gchar *nodeId, GSList *ids);
+
+/**
+ * Loads the cached extraction result of an item. Results are only
+ * returned when they were extracted from content with the given hash.
+ *
+ * @param id		the item id
+ * @param hash		hash of the content the extraction was run on
+ * @param title		return location for the extracted title (to be free'd using g_free)
+ * @param content	return location for the extracted content (to be free'd using g_free)
+ *
+ * @returns TRUE if a matching result was found
+ */
+gboolean db_item_extract_load (gulong id, const gchar *hash, gchar **title, gchar **content);
+
+/**
+ * Saves the extraction result of an item replacing any older one.
+ *
+ * @param id		the item id
+ * @param hash		hash of the content the extraction was run on
+ * @param title		the extracted title
+ * @param content	the extracted and sanitized content
+ */
+void db_item_extract_save (gulong id, const gchar *hash, const gchar *title, const gchar *content);
+
+typedef void (*dbEnrichmentLoadFunc) (gulong id, const gchar *nodeId, const gchar *url, gint64 queued, gpointer user_data);
+
+/**
+ * Calls the given function for all persisted content extraction
+ * requests in the order they were queued.
+ *
+ * @param func		the function to call
+ * @param user_data	user data passed to func
+ */
+void db_enrichment_queue_load (dbEnrichmentLoadFunc func, gpointer user_data);
+
+/**
+ * Persists a content extraction request for an item.
+ *
+ * @param id		the item id
+ * @param nodeId	the id of the node the item belongs to
+ * @param url		the URL to fetch
+ * @param queued	time the request was queued at
+ */
+void db_enrichment_queue_add (gulong id, const gchar *nodeId, const gchar *url, gint64 queued);
+
+/**
+ * Drops the persisted content extraction request of an item.
+ *
+ * @param id		the item id
+ */
+void db_enrichment_queue_remove (gulong id);
+
+typedef void (*dbFaviconHostLoadFunc) (const gchar *key, const gchar *iconUrl, const gchar *nodeId, const gchar *blogroll,
+                                       const gchar *etag, const gchar *lastModified, gint64 checked, gboolean failed,
+                                       gpointer user_data);
+
+/**
+ * Calls the given function for all persisted favicon discovery results.
+ *
+ * @param func		the function to call
+ * @param user_data	user data passed to func
+ */
+void db_favicon_hosts_load (dbFaviconHostLoadFunc func, gpointer user_data);
+
+/**
+ * Persists the favicon discovery result for a host or icon URL.
+ *
+ * @param key		the host name or icon URL
+ * @param iconUrl	the URL the icon was downloaded from (or NULL)
+ * @param nodeId	the node whose favicon cache file holds the icon (or NULL)
+ * @param blogroll	the discovered blogroll URL (or NULL)
+ * @param etag		ETag of the icon download (or NULL)
+ * @param lastModified	Last-Modified of the icon download (or NULL)
+ * @param checked	time of the last discovery or revalidation (in seconds)
+ * @param failed	TRUE if no icon could be found
+ */
+void db_favicon_host_save (const gchar *key, const gchar *iconUrl, const gchar *nodeId, const gchar *blogroll,
+                           const gchar *etag, const gchar *lastModified, gint64 checked, gboolean failed);
+
 /**
  * Returns an item set of all items for the given search folder id.
  *
@@ -187,6 +488,28 @@ guint   db_search_folder_get_unread_count (const gchar *id);
  */
 void db_subscription_load (subscriptionPtr subscription);
 
+/**
+ * Loads the subscription rows, update states and metadata of many
+ * subscriptions with one query per table. Use this instead of
+ * db_subscription_load() when loading the whole feed list.
+ *
+ * @param subscriptions	hash table of node id -> subscription
+ */
+void db_subscriptions_load (GHashTable *subscriptions);
+
+/**
+ * Queries the item and unread counts of all item sets and search
+ * folders at once. Until db_counters_drop() is called the counter
+ * getters answer from this snapshot instead of querying the DB.
+ * Only to be used while no items are changed (e.g. on startup).
+ */
+void db_counters_preload (void);
+
+/**
+ * Drops the counter snapshot created by db_counters_preload().
+ */
+void db_counters_drop (void);
+
 /**
  * Updates (or inserts) the properties of the given subscription in the DB.
  *
@@ -0,0 +1,306 @@
+/**
+ * @file db_maintenance.c  background DB maintenance
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "db_maintenance.h"
+
+#include <json-glib/json-glib.h>
+
+#include "debug.h"
+
+/* The DB consistency passes (orphaned items, metadata, search folder
+   entries...) used to run on every startup before the window appeared,
+   which takes seconds on large DBs. Now they run in low priority
+   timeouts after startup. Each slice checks batches of rows until its
+   time budget is used up, the batch size adapts to the speed of the
+   DB. Progress is persisted in the info table so an interrupted round
+   is resumed in the next session. A finished round is repeated after
+   MAINTENANCE_INTERVAL.
+
+   With incremental auto-vacuum enabled free pages are returned to the
+   file system in the same slices instead of a blocking VACUUM at
+   startup. Pages freed by the cleanup and reclaimed by vacuuming are
+   written to the WAL, which is checkpointed passively from the slices
+   so the automatic checkpoints during feed updates have less to do. */
+
+#define MAINTENANCE_START_DELAY	30		/* seconds after startup */
+#define MAINTENANCE_PAUSE	250		/* ms between slices */
+#define MAINTENANCE_BUDGET	(20 * 1000)	/* µs per slice */
+#define MAINTENANCE_BATCH_MIN	100
+#define MAINTENANCE_BATCH_MAX	20000
+#define MAINTENANCE_INTERVAL	(24 * 60 * 60)	/* seconds between rounds */
+#define MAINTENANCE_SAVE_SLICES	20		/* slices between saving progress */
+#define MAINTENANCE_CHECK	(10 * 60)	/* seconds between checks when idle */
+#define MAINTENANCE_VACUUM_PAGES 16		/* pages reclaimed per step */
+#define MAINTENANCE_VACUUM_START 64		/* free pages to start reclaiming */
+#define MAINTENANCE_CHECKPOINT_SLICES 10	/* slices between WAL checkpoints */
+
+static struct {
+	gboolean		cleanup;	/* consistency round running */
+	gboolean		reclaim;	/* free pages to reclaim */
+	gboolean		dirty;		/* changes not yet checkpointed */
+	guint			pass;		/* current consistency pass */
+	gint64			position;	/* last rowid checked */
+	gint64			end;		/* last rowid to check, 0 if unknown */
+	guint			batch;		/* rows per batch */
+	guint			passCleaned;	/* rows deleted by the current pass */
+	gint64			passTime;	/* time spent on the current pass [µs] */
+	guint			timer;
+	dbSpaceStats		space;		/* page counts of the last check */
+	dbMaintenanceStats	stats;
+} maintenance;
+
+static void
+db_maintenance_save (void)
+{
+	db_info_set_int64 ("maintenancePass", maintenance.pass);
+	db_info_set_int64 ("maintenancePosition", maintenance.position);
+	db_info_set_int64 ("maintenanceEnd", maintenance.end);
+}
+
+static void
+db_maintenance_finished (void)
+{
+	debug (DEBUG_DB, "DB maintenance finished: %u rows cleaned in %u slices, %.1fms",
+	       maintenance.stats.cleaned, maintenance.stats.slices, maintenance.stats.time / 1000.0);
+
+	maintenance.cleanup = FALSE;
+	maintenance.pass = 0;
+	maintenance.position = 0;
+	maintenance.end = 0;
+	db_maintenance_save ();
+	db_info_set_int64 ("maintenanceLastRun", g_get_real_time () / G_USEC_PER_SEC);
+}
+
+static void
+db_maintenance_next_pass (void)
+{
+	debug (DEBUG_DB, "DB maintenance: pass %s cleaned %u rows in %.1fms",
+	       db_cleanup_get_pass_name (maintenance.pass), maintenance.passCleaned, maintenance.passTime / 1000.0);
+
+	maintenance.stats.passes++;
+	maintenance.pass++;
+	maintenance.position = 0;
+	maintenance.end = 0;
+	maintenance.passCleaned = 0;
+	maintenance.passTime = 0;
+	db_maintenance_save ();
+}
+
+/* Checks the next batch of the consistency round */
+static void
+db_maintenance_cleanup_step (void)
+{
+	gint64	start = g_get_monotonic_time ();
+	gint64	duration;
+	guint	cleaned;
+
+	if (maintenance.pass >= db_cleanup_get_pass_count ()) {
+		db_maintenance_finished ();
+		return;
+	}
+
+	if (!maintenance.end)
+		maintenance.end = db_cleanup_get_end (maintenance.pass);
+
+	if (maintenance.position >= maintenance.end) {
+		db_maintenance_next_pass ();
+		return;
+	}
+
+	cleaned = db_cleanup_step (maintenance.pass, &maintenance.position, maintenance.end, maintenance.batch);
+	maintenance.passCleaned += cleaned;
+	maintenance.stats.cleaned += cleaned;
+	maintenance.stats.batches++;
+	if (cleaned)
+		maintenance.dirty = TRUE;
+
+	duration = g_get_monotonic_time () - start;
+	maintenance.passTime += duration;
+
+	/* Aim for a few batches per slice */
+	if (duration < MAINTENANCE_BUDGET / 4)
+		maintenance.batch = MIN (maintenance.batch * 2, MAINTENANCE_BATCH_MAX);
+	else if (duration > MAINTENANCE_BUDGET)
+		maintenance.batch = MAX (maintenance.batch / 2, MAINTENANCE_BATCH_MIN);
+}
+
+/* Returns some free pages to the file system */
+static void
+db_maintenance_reclaim_step (void)
+{
+	gint64	start = g_get_monotonic_time ();
+	guint	reclaimed;
+
+	reclaimed = db_incremental_vacuum (MAINTENANCE_VACUUM_PAGES);
+	maintenance.stats.reclaimed += reclaimed;
+	maintenance.stats.reclaimTime += g_get_monotonic_time () - start;
+
+	if (reclaimed)
+		maintenance.dirty = TRUE;
+
+	if (reclaimed < MAINTENANCE_VACUUM_PAGES) {
+		debug (DEBUG_DB, "DB maintenance: reclaimed %u pages in %.1fms",
+		       maintenance.stats.reclaimed, maintenance.stats.reclaimTime / 1000.0);
+		maintenance.reclaim = FALSE;
+	}
+}
+
+static void
+db_maintenance_checkpoint (void)
+{
+	maintenance.stats.walFrames = db_checkpoint ();
+	maintenance.stats.checkpoints++;
+	maintenance.dirty = FALSE;
+}
+
+static gboolean db_maintenance_check (gpointer user_data);
+
+static gboolean
+db_maintenance_slice (gpointer user_data)
+{
+	gint64	start = g_get_monotonic_time ();
+
+	maintenance.stats.slices++;
+
+	/* Consistency first, as it frees pages to be reclaimed */
+	while (g_get_monotonic_time () - start < MAINTENANCE_BUDGET) {
+		if (maintenance.cleanup)
+			db_maintenance_cleanup_step ();
+		else if (maintenance.reclaim)
+			db_maintenance_reclaim_step ();
+		else
+			break;
+	}
+
+	if (maintenance.dirty && (0 == maintenance.stats.slices % MAINTENANCE_CHECKPOINT_SLICES ||
+	                          (!maintenance.cleanup && !maintenance.reclaim)))
+		db_maintenance_checkpoint ();
+
+	maintenance.stats.time += g_get_monotonic_time () - start;
+
+	if (!maintenance.cleanup && !maintenance.reclaim) {
+		maintenance.timer = g_timeout_add_seconds_full (G_PRIORITY_LOW, MAINTENANCE_CHECK, db_maintenance_check, NULL, NULL);
+		return G_SOURCE_REMOVE;
+	}
+
+	if (maintenance.cleanup && 0 == maintenance.stats.slices % MAINTENANCE_SAVE_SLICES)
+		db_maintenance_save ();
+
+	return G_SOURCE_CONTINUE;
+}
+
+/* Determines whether there is work and starts the slices if so */
+static gboolean
+db_maintenance_check (gpointer user_data)
+{
+	gint64	lastRun = db_info_get_int64 ("maintenanceLastRun", 0);
+
+	db_get_space_stats (&maintenance.space);
+
+	/* Resume an interrupted round or start a new one if the last one is old enough */
+	maintenance.cleanup = (0 != maintenance.pass || 0 != maintenance.position ||
+	                       g_get_real_time () / G_USEC_PER_SEC - lastRun >= MAINTENANCE_INTERVAL);
+	maintenance.reclaim = (maintenance.space.incremental &&
+	                       maintenance.space.freelistCount >= MAINTENANCE_VACUUM_START);
+
+	if (!maintenance.cleanup && !maintenance.reclaim) {
+		debug (DEBUG_DB, "DB maintenance not needed yet (%d of %d pages free)",
+		       maintenance.space.freelistCount, maintenance.space.pageCount);
+		maintenance.timer = g_timeout_add_seconds_full (G_PRIORITY_LOW, MAINTENANCE_CHECK, db_maintenance_check, NULL, NULL);
+		return G_SOURCE_REMOVE;
+	}
+
+	debug (DEBUG_DB, "DB maintenance starting (cleanup at pass %u, rowid %" G_GINT64_FORMAT ", %d of %d pages free)",
+	       maintenance.pass, maintenance.position, maintenance.space.freelistCount, maintenance.space.pageCount);
+
+	maintenance.timer = g_timeout_add_full (G_PRIORITY_LOW, MAINTENANCE_PAUSE, db_maintenance_slice, NULL, NULL);
+
+	return G_SOURCE_REMOVE;
+}
+
+void
+db_maintenance_init (void)
+{
+	maintenance.pass = db_info_get_int64 ("maintenancePass", 0);
+	maintenance.position = db_info_get_int64 ("maintenancePosition", 0);
+	maintenance.end = db_info_get_int64 ("maintenanceEnd", 0);
+	maintenance.batch = MAINTENANCE_BATCH_MIN;
+
+	if (maintenance.pass >= db_cleanup_get_pass_count ()) {
+		maintenance.pass = 0;
+		maintenance.position = 0;
+		maintenance.end = 0;
+	}
+
+	maintenance.timer = g_timeout_add_seconds_full (G_PRIORITY_LOW, MAINTENANCE_START_DELAY, db_maintenance_check, NULL, NULL);
+}
+
+void
+db_maintenance_deinit (void)
+{
+	if (!maintenance.timer)
+		return;
+
+	g_source_remove (maintenance.timer);
+	maintenance.timer = 0;
+	if (maintenance.cleanup)
+		db_maintenance_save ();
+}
+
+void
+db_maintenance_to_json (gpointer builder)
+{
+	JsonBuilder	*b = JSON_BUILDER (builder);
+	dbSpaceStats	space;
+
+	db_get_space_stats (&space);
+
+	json_builder_set_member_name (b, "maintenance");
+	json_builder_begin_object (b);
+	json_builder_set_member_name (b, "pass");
+	json_builder_add_string_value (b, (maintenance.cleanup && maintenance.pass < db_cleanup_get_pass_count ())?db_cleanup_get_pass_name (maintenance.pass):"-");
+	json_builder_set_member_name (b, "progress");
+	json_builder_add_int_value (b, (maintenance.cleanup && maintenance.end)?(100 * maintenance.position / maintenance.end):0);
+	json_builder_set_member_name (b, "passes");
+	json_builder_add_int_value (b, maintenance.stats.passes);
+	json_builder_set_member_name (b, "cleaned");
+	json_builder_add_int_value (b, maintenance.stats.cleaned);
+	json_builder_set_member_name (b, "time");
+	json_builder_add_int_value (b, maintenance.stats.time / 1000);
+	json_builder_set_member_name (b, "incremental");
+	json_builder_add_boolean_value (b, space.incremental);
+	json_builder_set_member_name (b, "pages");
+	json_builder_add_int_value (b, space.pageCount);
+	json_builder_set_member_name (b, "freePages");
+	json_builder_add_int_value (b, space.freelistCount);
+	json_builder_set_member_name (b, "fragmentation");
+	json_builder_add_int_value (b, space.pageCount?(100 * space.freelistCount / space.pageCount):0);
+	json_builder_set_member_name (b, "freeBytes");
+	json_builder_add_int_value (b, (gint64)space.freelistCount * space.pageSize);
+	json_builder_set_member_name (b, "reclaimed");
+	json_builder_add_int_value (b, maintenance.stats.reclaimed);
+	json_builder_set_member_name (b, "reclaimRate");
+	json_builder_add_int_value (b, maintenance.stats.reclaimTime?((gint64)maintenance.stats.reclaimed * space.pageSize * G_USEC_PER_SEC / maintenance.stats.reclaimTime / 1024):0);
+	json_builder_set_member_name (b, "checkpoints");
+	json_builder_add_int_value (b, maintenance.stats.checkpoints);
+	json_builder_set_member_name (b, "walFrames");
+	json_builder_add_int_value (b, maintenance.stats.walFrames);
+	json_builder_end_object (b);
+}
@@ -0,0 +1,64 @@
+/**
+ * @file db_maintenance.h  background DB maintenance
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _DB_MAINTENANCE_H
+#define _DB_MAINTENANCE_H
+
+#include <glib.h>
+
+#include "db.h"
+
+typedef struct dbMaintenanceStats {
+	guint	slices;		/*<< idle slices run */
+	guint	batches;	/*<< batches checked */
+	guint	passes;		/*<< consistency passes finished */
+	guint	cleaned;	/*<< rows deleted */
+	gint64	time;		/*<< total time spent [µs] */
+	guint	reclaimed;	/*<< free pages returned to the file system */
+	gint64	reclaimTime;	/*<< time spent reclaiming [µs] */
+	guint	checkpoints;	/*<< WAL checkpoints run */
+	gint	walFrames;	/*<< WAL frames left after the last checkpoint */
+} dbMaintenanceStats;
+
+/**
+ * db_maintenance_init: (skip)
+ *
+ * Starts the idle time maintenance. Resumes the consistency
+ * passes where the last session stopped and reclaims free
+ * pages. To be called once the feed list is loaded.
+ */
+void db_maintenance_init (void);
+
+/**
+ * db_maintenance_deinit: (skip)
+ *
+ * Stops the maintenance and persists its progress.
+ */
+void db_maintenance_deinit (void);
+
+/**
+ * db_maintenance_to_json: (skip)
+ * @b:		a JsonBuilder to append to
+ *
+ * Adds a "maintenance" member with progress and statistics.
+ */
+void db_maintenance_to_json (gpointer b);
+
+#endif
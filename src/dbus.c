@@ -26,6 +26,12 @@
 #include "subscription.h"
 #include "ui/liferea_shell.h"
 
+/* Change events are coalesced and rate limited so that clients can
+   subscribe to them instead of polling the counters */
+#define LF_DBUS_COALESCE_MS	250	/* minimum delay to collect bursts of changes */
+#define LF_DBUS_MIN_INTERVAL_MS	1000	/* minimum interval between two emissions */
+#define LF_DBUS_MAX_NEW_ITEMS	200	/* maximum number of items per NewItems signal */
+
 static GDBusNodeInfo *introspection_data = NULL;
 
 static const gchar introspection_xml[] =
@@ -51,6 +57,28 @@ static const gchar introspection_xml[] =
 "    <method name='Refresh'>"
 "      <arg name='result' type='b' direction='out' />"
 "    </method>"
+"    <method name='GetSnapshot'>"
+"      <arg name='serial' type='t' direction='out' />"
+"      <arg name='unread' type='u' direction='out' />"
+"      <arg name='new' type='u' direction='out' />"
+"      <arg name='feeds' type='a(ssuu)' direction='out' />"
+"    </method>"
+"    <signal name='CountersChanged'>"
+"      <arg name='serial' type='t' />"
+"      <arg name='unreadDelta' type='i' />"
+"      <arg name='newDelta' type='i' />"
+"      <arg name='unread' type='u' />"
+"      <arg name='new' type='u' />"
+"    </signal>"
+"    <signal name='UpdateCompleted'>"
+"      <arg name='serial' type='t' />"
+"      <arg name='feeds' type='a(ssiuuu)' />"
+"    </signal>"
+"    <signal name='NewItems'>"
+"      <arg name='serial' type='t' />"
+"      <arg name='items' type='a(uss)' />"
+"      <arg name='dropped' type='u' />"
+"    </signal>"
 "  </interface>"
 "</node>";
 
@@ -96,6 +124,237 @@ liferea_dbus_refresh (LifereaDBus *self, GError **err)
 	return TRUE;
 }
 
+/* Change event emission
+
+   Feed list changes are collected and emitted at most once per
+   LF_DBUS_MIN_INTERVAL_MS. All signals of one emission share a serial
+   so that clients can match them against GetSnapshot results. */
+
+static void
+liferea_dbus_emit_signal (LifereaDBus *self, const gchar *name, GVariant *parameters)
+{
+	GError *error = NULL;
+
+	if (!g_dbus_connection_emit_signal (self->connection, NULL, LF_DBUS_PATH, LF_DBUS_SERVICE, name, parameters, &error)) {
+		debug (DEBUG_GUI, "Failed to emit D-Bus signal %s: %s", name, error->message);
+		g_error_free (error);
+	}
+}
+
+static void
+liferea_dbus_emit (LifereaDBus *self)
+{
+	GVariantBuilder	builder;
+	GHashTableIter	iter;
+	gpointer	key, value;
+	guint		i;
+
+	if (!self->connection || !self->feedlist)
+		return;
+
+	if (!self->newItems->len && !self->droppedItems && !g_hash_table_size (self->finished) && !self->countersChanged)
+		return;
+
+	self->serial++;
+	self->lastEmit = g_get_monotonic_time ();
+
+	if (self->newItems->len || self->droppedItems) {
+		g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(uss)"));
+		for (i = 0; i < self->newItems->len; i++)
+			g_variant_builder_add_value (&builder, g_ptr_array_index (self->newItems, i));
+
+		liferea_dbus_emit_signal (self, "NewItems", g_variant_new ("(ta(uss)u)", self->serial, &builder, self->droppedItems));
+		g_ptr_array_set_size (self->newItems, 0);
+		self->droppedItems = 0;
+	}
+
+	if (g_hash_table_size (self->finished)) {
+		g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ssiuuu)"));
+		g_hash_table_iter_init (&iter, self->finished);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			Node *node = node_from_id ((const gchar *)key);
+
+			if (!node || !node->subscription)
+				continue;
+
+			g_variant_builder_add (&builder, "(ssiuuu)",
+			                       node->id,
+			                       node_get_title (node) ? node_get_title (node) : "",
+			                       node->subscription->httpErrorCode,
+			                       (guint)node->subscription->error,
+			                       GPOINTER_TO_UINT (value),
+			                       node->unreadCount);
+		}
+
+		liferea_dbus_emit_signal (self, "UpdateCompleted", g_variant_new ("(ta(ssiuuu))", self->serial, &builder));
+		g_hash_table_remove_all (self->finished);
+	}
+
+	if (self->countersChanged) {
+		guint unread = feedlist_get_unread_item_count ();
+		guint new = feedlist_get_new_item_count ();
+
+		if (unread != self->unreadCount || new != self->newCount)
+			liferea_dbus_emit_signal (self, "CountersChanged", g_variant_new ("(tiiuu)",
+			                          self->serial,
+			                          (gint)unread - (gint)self->unreadCount,
+			                          (gint)new - (gint)self->newCount,
+			                          unread, new));
+
+		self->unreadCount = unread;
+		self->newCount = new;
+		self->countersChanged = FALSE;
+	}
+}
+
+static gboolean
+liferea_dbus_emit_cb (gpointer user_data)
+{
+	LifereaDBus *self = LIFEREA_DBUS (user_data);
+
+	self->emitTimer = 0;
+	liferea_dbus_emit (self);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+liferea_dbus_schedule_emit (LifereaDBus *self)
+{
+	gint64 delay;
+
+	if (self->emitTimer)
+		return;
+
+	delay = (self->lastEmit - g_get_monotonic_time ()) / 1000 + LF_DBUS_MIN_INTERVAL_MS;
+	delay = MAX (delay, LF_DBUS_COALESCE_MS);
+
+	self->emitTimer = g_timeout_add ((guint)delay, liferea_dbus_emit_cb, self);
+}
+
+static void
+liferea_dbus_counters_changed (GObject *feedlist, gpointer unused, gpointer user_data)
+{
+	LifereaDBus *self = LIFEREA_DBUS (user_data);
+
+	if (!self->connection)
+		return;
+
+	self->countersChanged = TRUE;
+	liferea_dbus_schedule_emit (self);
+}
+
+static void
+liferea_dbus_item_merged (GObject *feedlist, gpointer data, gpointer user_data)
+{
+	LifereaDBus	*self = LIFEREA_DBUS (user_data);
+	itemPtr		item = (itemPtr)data;
+	guint		count;
+
+	if (!self->connection || !item->nodeId)
+		return;
+
+	/* Only items merged by the update job itself are reported with
+	   UpdateCompleted, not those merged later on (e.g. fetched in
+	   chunks by node sources) */
+	if (feedlist_node_is_updating (item->nodeId)) {
+		count = GPOINTER_TO_UINT (g_hash_table_lookup (self->newPerNode, item->nodeId));
+		g_hash_table_replace (self->newPerNode, g_strdup (item->nodeId), GUINT_TO_POINTER (count + 1));
+	}
+
+	if (self->newItems->len < LF_DBUS_MAX_NEW_ITEMS)
+		g_ptr_array_add (self->newItems, g_variant_ref_sink (g_variant_new ("(uss)",
+		                 (guint32)item->id,
+		                 item->nodeId,
+		                 item_get_title (item) ? item_get_title (item) : "")));
+	else
+		self->droppedItems++;
+
+	liferea_dbus_schedule_emit (self);
+}
+
+static void
+liferea_dbus_node_update_finished (GObject *feedlist, const gchar *nodeId, gpointer user_data)
+{
+	LifereaDBus	*self = LIFEREA_DBUS (user_data);
+	guint		count, pending;
+
+	if (!self->connection)
+		return;
+
+	count = GPOINTER_TO_UINT (g_hash_table_lookup (self->newPerNode, nodeId));
+	g_hash_table_remove (self->newPerNode, nodeId);
+
+	pending = GPOINTER_TO_UINT (g_hash_table_lookup (self->finished, nodeId));
+	g_hash_table_replace (self->finished, g_strdup (nodeId), GUINT_TO_POINTER (pending + count));
+
+	self->countersChanged = TRUE;
+	liferea_dbus_schedule_emit (self);
+}
+
+static void
+liferea_dbus_snapshot_node (Node *node, gpointer user_data)
+{
+	GVariantBuilder *builder = (GVariantBuilder *)user_data;
+
+	if (node->subscription)
+		g_variant_builder_add (builder, "(ssuu)",
+		                       node->id,
+		                       node_get_title (node) ? node_get_title (node) : "",
+		                       node->unreadCount,
+		                       node->itemCount);
+
+	if (node->children)
+		node_foreach_child_data (node, liferea_dbus_snapshot_node, user_data);
+}
+
+static GVariant *
+liferea_dbus_get_snapshot (LifereaDBus *self, GError **err)
+{
+	GVariantBuilder	feeds;
+
+	g_variant_builder_init (&feeds, G_VARIANT_TYPE ("a(ssuu)"));
+
+	if (!self->feedlist)
+		return g_variant_new ("(tuua(ssuu))", self->serial, 0, 0, &feeds);
+
+	/* Emit pending changes first, so the returned serial covers
+	   everything the snapshot reflects and later events apply on top */
+	if (self->emitTimer) {
+		g_source_remove (self->emitTimer);
+		self->emitTimer = 0;
+		liferea_dbus_emit (self);
+	}
+
+	self->unreadCount = feedlist_get_unread_item_count ();
+	self->newCount = feedlist_get_new_item_count ();
+
+	feedlist_foreach_data (liferea_dbus_snapshot_node, &feeds);
+
+	return g_variant_new ("(tuua(ssuu))", self->serial, self->unreadCount, self->newCount, &feeds);
+}
+
+void
+liferea_dbus_watch_feedlist (LifereaDBus *self, GObject *feedlist)
+{
+	g_return_if_fail (IS_LIFEREA_DBUS (self));
+
+	if (self->feedlist)
+		return;
+
+	self->feedlist = feedlist;
+	g_object_add_weak_pointer (feedlist, (gpointer *)&self->feedlist);
+
+	self->unreadCount = feedlist_get_unread_item_count ();
+	self->newCount = feedlist_get_new_item_count ();
+
+	g_signal_connect_object (feedlist, "new-items", G_CALLBACK (liferea_dbus_counters_changed), self, 0);
+	g_signal_connect_object (feedlist, "node-updated", G_CALLBACK (liferea_dbus_counters_changed), self, 0);
+	g_signal_connect_object (feedlist, "items-updated", G_CALLBACK (liferea_dbus_counters_changed), self, 0);
+	g_signal_connect_object (feedlist, "item-merged", G_CALLBACK (liferea_dbus_item_merged), self, 0);
+	g_signal_connect_object (feedlist, "node-update-finished", G_CALLBACK (liferea_dbus_node_update_finished), self, 0);
+}
+
 static void
 handle_method_call (GDBusConnection       *connection,
 		    const gchar           *sender,
@@ -139,6 +398,9 @@ handle_method_call (GDBusConnection       *connection,
 		res = liferea_dbus_refresh (self, NULL);
 		g_dbus_method_invocation_return_value (invocation,
 			g_variant_new ("(b)", res));
+	} else if (g_str_equal (method_name, "GetSnapshot")) {
+		g_dbus_method_invocation_return_value (invocation,
+			liferea_dbus_get_snapshot (self, NULL));
 	} else {
 		g_warning ("Unknown method name or unknown parameters: %s",
 			   method_name);
@@ -157,6 +419,7 @@ on_bus_acquired (GDBusConnection *connection,
 		 const gchar     *name,
 		 gpointer         user_data)
 {
+	LifereaDBus *self = LIFEREA_DBUS (user_data);
 	guint id;
 
 
@@ -168,12 +431,14 @@ on_bus_acquired (GDBusConnection *connection,
 						LF_DBUS_PATH,
 						introspection_data->interfaces[0],
 						&interface_vtable,
-						NULL,  /* user_data */
+						user_data,
 						NULL,  /* user_data_free_func */
 						NULL); /* GError** */
 
 	g_assert (id > 0);
 
+	self->connection = g_object_ref (connection);
+	self->registration_id = id;
 }
 
 static void
@@ -192,14 +457,43 @@ on_name_lost (GDBusConnection *connection,
 	debug (DEBUG_GUI, "Lost the name %s on the session bus", name);
 }
 
-static void liferea_dbus_init(LifereaDBus *obj) { }
+static void
+liferea_dbus_init (LifereaDBus *self)
+{
+	self->newPerNode = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	self->finished = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	self->newItems = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+}
 
 static void
 liferea_dbus_dispose (GObject *obj)
 {
 	LifereaDBus *self = LIFEREA_DBUS (obj);
 
-	g_bus_unown_name (self->owner_id);
+	if (self->owner_id) {
+		g_bus_unown_name (self->owner_id);
+		self->owner_id = 0;
+	}
+
+	if (self->emitTimer) {
+		g_source_remove (self->emitTimer);
+		self->emitTimer = 0;
+	}
+
+	if (self->feedlist) {
+		g_object_remove_weak_pointer (self->feedlist, (gpointer *)&self->feedlist);
+		self->feedlist = NULL;
+	}
+
+	if (self->connection && self->registration_id) {
+		g_dbus_connection_unregister_object (self->connection, self->registration_id);
+		self->registration_id = 0;
+	}
+
+	g_clear_object (&self->connection);
+	g_clear_pointer (&self->newPerNode, g_hash_table_destroy);
+	g_clear_pointer (&self->finished, g_hash_table_destroy);
+	g_clear_pointer (&self->newItems, g_ptr_array_unref);
 
 	G_OBJECT_CLASS (liferea_dbus_parent_class)->dispose (obj);
 }
@@ -226,7 +520,7 @@ liferea_dbus_new (void)
 					on_bus_acquired,
 					on_name_acquired,
 					on_name_lost,
-					NULL,
+					obj,
 					NULL);
 
 
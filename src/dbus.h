@@ -22,6 +22,7 @@
 #ifndef __LIFEREA_DBUS_H__
 #define __LIFEREA_DBUS_H__
 
+#include <gio/gio.h>
 #include <glib-object.h>
 
 #define LF_DBUS_PATH "/org/gnome/feed/Reader"
@@ -30,6 +31,21 @@
 typedef struct _LifereaDBus {
 	GObject parent;
 	guint owner_id;
+
+	GDBusConnection	*connection;	/*<< session bus connection once acquired */
+	guint		registration_id;/*<< object registration on the connection */
+	GObject		*feedlist;	/*<< watched feed list (weak pointer) */
+
+	guint64		serial;		/*<< serial of the last emitted change event batch */
+	guint		unreadCount;	/*<< unread count as last reported */
+	guint		newCount;	/*<< new count as last reported */
+	gboolean	countersChanged;/*<< TRUE if counters might have changed */
+	GHashTable	*newPerNode;	/*<< node id -> items merged since the last finished update */
+	GHashTable	*finished;	/*<< node id -> new items of finished updates not yet emitted */
+	GPtrArray	*newItems;	/*<< (uss) tuples of merged items not yet emitted */
+	guint		droppedItems;	/*<< merged items not reported because the batch was full */
+	guint		emitTimer;	/*<< timer for the next coalesced emission */
+	gint64		lastEmit;	/*<< monotonic time of the last emission */
 } LifereaDBus;
 
 typedef struct _LifereaDBusClass {
@@ -47,4 +63,14 @@ GType liferea_dbus_get_type (void);
 
 LifereaDBus* liferea_dbus_new (void);
 
+/**
+ * liferea_dbus_watch_feedlist:
+ * @self:	the D-Bus object
+ * @feedlist:	the feed list to watch
+ *
+ * Connects to the feed list change signals so that changes are
+ * broadcasted as coalesced D-Bus signals.
+ */
+void liferea_dbus_watch_feedlist (LifereaDBus *self, GObject *feedlist);
+
 #endif
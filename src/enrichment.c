@@ -0,0 +1,384 @@
+/**
+ * @file enrichment.c  item content extraction queue
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "enrichment.h"
+
+#include <json-glib/json-glib.h>
+
+#include "db.h"
+#include "debug.h"
+#include "metadata.h"
+#include "node.h"
+#include "update.h"
+#include "update_job.h"
+#include "xml.h"
+
+/* For subscriptions with HTML5 extraction enabled the link of each new
+   item is fetched and the article content is extracted. A single feed
+   update can add many items linking to the same site, so instead of
+   firing all fetches at once they are queued here and dispatched with
+   a small budget of parallel fetches, at most one fetch per host at a
+   time and a minimum pause between fetches to the same host.
+
+   Items linking to the same URL (e.g. duplicates in different feeds)
+   share a single fetch. The queue is persisted in the DB so a backlog
+   is resumed after a restart. */
+
+#define ENRICHMENT_MAX_RUNNING	4			/* parallel fetches */
+#define ENRICHMENT_HOST_PAUSE	(2 * G_USEC_PER_SEC)	/* pause between fetches to a host */
+
+typedef struct {
+	gchar		*url;
+	gchar		*host;
+	gchar		*nodeId;	/* node whose update options are used */
+	GSList		*items;		/* ids of the items to enrich */
+	gint64		started;	/* monotonic start time, 0 if pending */
+} EnrichmentTask;
+
+typedef struct {
+	gboolean	busy;		/* a fetch to this host is running */
+	gint64		next;		/* monotonic time of earliest next fetch */
+} EnrichmentHost;
+
+static struct {
+	GQueue		*pending;	/* tasks waiting for dispatch */
+	GHashTable	*tasks;		/* URL -> EnrichmentTask (pending and running) */
+	GHashTable	*hosts;		/* host -> EnrichmentHost */
+	guint		running;
+	guint		timer;
+	enrichmentStats	stats;
+} enrichment;
+
+static void enrichment_dispatch (void);
+
+static void
+enrichment_task_free (gpointer data)
+{
+	EnrichmentTask *task = (EnrichmentTask *)data;
+
+	g_free (task->url);
+	g_free (task->host);
+	g_free (task->nodeId);
+	g_slist_free (task->items);
+	g_free (task);
+}
+
+static void
+enrichment_setup (void)
+{
+	if (enrichment.tasks)
+		return;
+
+	enrichment.pending = g_queue_new ();
+	enrichment.tasks = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, enrichment_task_free);
+	enrichment.hosts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static EnrichmentHost *
+enrichment_get_host (const gchar *name)
+{
+	EnrichmentHost *host = g_hash_table_lookup (enrichment.hosts, name);
+
+	if (!host) {
+		host = g_new0 (EnrichmentHost, 1);
+		g_hash_table_insert (enrichment.hosts, g_strdup (name), host);
+	}
+
+	return host;
+}
+
+static void
+enrichment_queue_item (gulong id, const gchar *nodeId, const gchar *url, gint64 queued, gpointer user_data)
+{
+	EnrichmentTask *task;
+
+	if (!nodeId || !url)
+		return;
+
+	task = g_hash_table_lookup (enrichment.tasks, url);
+	if (task) {
+		if (!g_slist_find (task->items, GUINT_TO_POINTER (id))) {
+			task->items = g_slist_append (task->items, GUINT_TO_POINTER (id));
+			enrichment.stats.deduplicated++;
+		}
+		return;
+	}
+
+	g_autoptr(GUri) uri = g_uri_parse (url, G_URI_FLAGS_PARSE_RELAXED, NULL);
+
+	task = g_new0 (EnrichmentTask, 1);
+	task->url = g_strdup (url);
+	task->host = g_strdup ((uri && g_uri_get_host (uri))?g_uri_get_host (uri):"");
+	task->nodeId = g_strdup (nodeId);
+	task->items = g_slist_append (NULL, GUINT_TO_POINTER (id));
+
+	g_hash_table_insert (enrichment.tasks, task->url, task);
+	g_queue_push_tail (enrichment.pending, task);
+	enrichment.stats.queued++;
+}
+
+static gchar *
+enrichment_extract_html5 (UpdateResult *result)
+{
+	gchar *article;
+
+	if (!result->data || result->httpstatus >= 400)
+		return NULL;
+
+	article = xhtml_extract_from_string (result->data, result->source);
+	if (article) {
+		// Enable AMP images by replacing <amg-img> by <img>
+		gchar **tmp_split = g_strsplit (article, "<amp-img", 0);
+		gchar *tmp = g_strjoinv ("<img", tmp_split);
+		g_strfreev (tmp_split);
+		g_free (article);
+		article = tmp;
+	}
+
+	return article;
+}
+
+static gchar *
+enrichment_extract_text (UpdateResult *result)
+{
+	GString *description;
+
+	if (!result->data || result->size <= 0)
+		return NULL;
+
+	description = g_string_new ("<pre>");
+	g_string_append_len (description, result->data, result->size);
+	g_string_append (description, "</pre>");
+
+	return g_string_free (description, FALSE);
+}
+
+static void
+enrichment_task_finish (EnrichmentTask *task, const gchar *content)
+{
+	EnrichmentHost *host = enrichment_get_host (task->host);
+
+	for (GSList *iter = task->items; iter; iter = g_slist_next (iter)) {
+		gulong id = GPOINTER_TO_UINT (iter->data);
+
+		if (content) {
+			itemPtr item = item_load (id);
+			if (item) {
+				metadata_list_set (&(item->metadata), "richContent", content);
+				db_item_update (item);
+				item_unload (item);
+			}
+		}
+		db_enrichment_queue_remove (id);
+	}
+
+	if (task->started) {
+		enrichment.running--;
+		enrichment.stats.completed++;
+		enrichment.stats.latency += g_get_monotonic_time () - task->started;
+		if (content)
+			enrichment.stats.extracted++;
+		else
+			enrichment.stats.failed++;
+
+		host->busy = FALSE;
+		host->next = g_get_monotonic_time () + ENRICHMENT_HOST_PAUSE;
+
+		debug (DEBUG_UPDATE, "content extraction %s for %s (%u items) after %.1fms, %u pending, %u running",
+		       content?"succeeded":"failed", task->url, g_slist_length (task->items),
+		       (g_get_monotonic_time () - task->started) / 1000.0,
+		       g_queue_get_length (enrichment.pending), enrichment.running);
+	}
+
+	g_hash_table_remove (enrichment.tasks, task->url);
+}
+
+static gboolean
+enrichment_fetch_cb (UpdateJob *job)
+{
+	EnrichmentTask		*task;
+	g_autofree gchar	*content = NULL;
+
+	/* The task is looked up by URL as it might be gone after a deinit */
+	if (!enrichment.tasks)
+		return TRUE;
+	task = g_hash_table_lookup (enrichment.tasks, (gchar *)job->user_data);
+	if (!task || !task->started)
+		return TRUE;
+
+	if (g_str_has_prefix (task->url, "gopher://"))
+		content = enrichment_extract_text (job->result);
+	else
+		content = enrichment_extract_html5 (job->result);
+
+	enrichment_task_finish (task, content);
+	enrichment_dispatch ();
+
+	return TRUE;
+}
+
+static void
+enrichment_task_start (EnrichmentTask *task)
+{
+	EnrichmentHost	*host = enrichment_get_host (task->host);
+	Node		*node = node_from_id (task->nodeId);
+	UpdateRequest	*request;
+	UpdateJob	*job;
+
+	/* Subscription removed while the task was pending */
+	if (!node || !node->subscription) {
+		enrichment_task_finish (task, NULL);
+		return;
+	}
+
+	debug (DEBUG_PARSING, "Fetching content for %u item(s): %s", g_slist_length (task->items), task->url);
+
+	task->started = g_get_monotonic_time ();
+	host->busy = TRUE;
+	enrichment.running++;
+
+	request = update_request_new (
+		"GET",
+		task->url,
+		NULL,	// updateState
+		node->subscription->updateOptions	// Pass options of parent feed (e.g. password, proxy...)
+	);
+
+	job = update_job_new (&enrichment, request, enrichment_fetch_cb, g_strdup (task->url), UPDATE_REQUEST_NO_FEED);
+	job->destroy = g_free;
+}
+
+static gboolean
+enrichment_dispatch_cb (gpointer user_data)
+{
+	enrichment.timer = 0;
+	enrichment_dispatch ();
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+enrichment_dispatch (void)
+{
+	gint64	now = g_get_monotonic_time ();
+	gint64	wakeup = 0;
+	GList	*iter;
+
+	iter = enrichment.pending->head;
+	while (iter && enrichment.running < ENRICHMENT_MAX_RUNNING) {
+		EnrichmentTask	*task = (EnrichmentTask *)iter->data;
+		EnrichmentHost	*host = enrichment_get_host (task->host);
+		GList		*next = iter->next;
+
+		if (!host->busy) {
+			if (host->next <= now) {
+				g_queue_delete_link (enrichment.pending, iter);
+				enrichment_task_start (task);
+			} else if (!wakeup || host->next < wakeup) {
+				wakeup = host->next;
+			}
+		}
+		iter = next;
+	}
+
+	/* Hosts still pausing, check again when the first pause ends */
+	if (wakeup && !enrichment.timer)
+		enrichment.timer = g_timeout_add (MAX (1, (wakeup - now) / 1000), enrichment_dispatch_cb, NULL);
+}
+
+void
+enrichment_init (void)
+{
+	enrichment_setup ();
+	db_enrichment_queue_load (enrichment_queue_item, NULL);
+
+	debug (DEBUG_UPDATE, "resuming %u content extraction requests", g_queue_get_length (enrichment.pending));
+
+	enrichment_dispatch ();
+}
+
+void
+enrichment_deinit (void)
+{
+	if (!enrichment.tasks)
+		return;
+
+	update_job_cancel_by_owner (&enrichment);
+
+	if (enrichment.timer) {
+		g_source_remove (enrichment.timer);
+		enrichment.timer = 0;
+	}
+
+	g_queue_free (enrichment.pending);
+	g_hash_table_destroy (enrichment.tasks);
+	g_hash_table_destroy (enrichment.hosts);
+	enrichment.pending = NULL;
+	enrichment.tasks = NULL;
+	enrichment.hosts = NULL;
+	enrichment.running = 0;
+}
+
+void
+enrichment_add (subscriptionPtr subscription, itemPtr item)
+{
+	gint64 queued = g_get_real_time () / G_USEC_PER_SEC;
+
+	if (!item->source) {
+		debug (DEBUG_PARSING, "Cannot enrich item %s because it has no source!", item->title);
+		return;
+	}
+
+	// Don't enrich twice
+	if (NULL != metadata_list_get (item->metadata, "richContent")) {
+		debug (DEBUG_PARSING, "Skipping already enriched item %s", item->title);
+		return;
+	}
+
+	enrichment_setup ();
+
+	db_enrichment_queue_add (item->id, subscription->node->id, item->source, queued);
+	enrichment_queue_item (item->id, subscription->node->id, item->source, queued, NULL);
+	enrichment_dispatch ();
+}
+
+void
+enrichment_to_json (gpointer builder)
+{
+	JsonBuilder *b = JSON_BUILDER (builder);
+
+	json_builder_set_member_name (b, "enrichment");
+	json_builder_begin_object (b);
+	json_builder_set_member_name (b, "pending");
+	json_builder_add_int_value (b, enrichment.pending?g_queue_get_length (enrichment.pending):0);
+	json_builder_set_member_name (b, "running");
+	json_builder_add_int_value (b, enrichment.running);
+	json_builder_set_member_name (b, "queued");
+	json_builder_add_int_value (b, enrichment.stats.queued);
+	json_builder_set_member_name (b, "deduplicated");
+	json_builder_add_int_value (b, enrichment.stats.deduplicated);
+	json_builder_set_member_name (b, "extracted");
+	json_builder_add_int_value (b, enrichment.stats.extracted);
+	json_builder_set_member_name (b, "failed");
+	json_builder_add_int_value (b, enrichment.stats.failed);
+	json_builder_set_member_name (b, "latency");
+	json_builder_add_int_value (b, enrichment.stats.completed?enrichment.stats.latency / enrichment.stats.completed / 1000:0);
+	json_builder_end_object (b);
+}
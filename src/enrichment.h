@@ -0,0 +1,70 @@
+/**
+ * @file enrichment.h  item content extraction queue
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _ENRICHMENT_H
+#define _ENRICHMENT_H
+
+#include <glib.h>
+
+#include "item.h"
+#include "subscription.h"
+
+typedef struct enrichmentStats {
+	guint	queued;		/*<< items queued for extraction */
+	guint	deduplicated;	/*<< items sharing a fetch with another item */
+	guint	completed;	/*<< finished fetches */
+	guint	extracted;	/*<< fetches resulting in extracted content */
+	guint	failed;		/*<< failed fetches */
+	gint64	latency;	/*<< total fetch and extraction time of completed fetches [µs] */
+} enrichmentStats;
+
+/**
+ * enrichment_init: (skip)
+ *
+ * Resumes the content extraction requests persisted
+ * in the last session. To be called once the feed list is loaded.
+ */
+void enrichment_init (void);
+
+/**
+ * enrichment_deinit: (skip)
+ *
+ * Stops processing. Pending requests stay persisted.
+ */
+void enrichment_deinit (void);
+
+/**
+ * enrichment_add: (skip)
+ * @subscription:	the subscription the item belongs to
+ * @item:		the item to enrich
+ *
+ * Queues fetching the item link for content extraction.
+ */
+void enrichment_add (subscriptionPtr subscription, itemPtr item);
+
+/**
+ * enrichment_to_json: (skip)
+ * @b:		a JsonBuilder to append to
+ *
+ * Adds an "enrichment" member with backlog and statistics.
+ */
+void enrichment_to_json (gpointer b);
+
+#endif
@@ -24,7 +24,10 @@
 #include <errno.h>
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
 #include <libxml/tree.h>
+#include <libxml/xmlreader.h>
+#include <string.h>
 
 #include "auth.h"
 #include "common.h"
@@ -34,10 +37,24 @@
 #include "feedlist.h"
 #include "node_providers/folder.h"
 #include "node.h"
+#include "update_ramp.h"
 #include "xml.h"
+#include "ui/liferea_shell.h"
 #include "ui/ui_common.h"
 #include "ui/feed_list_view.h"
 
+/* Number of imported nodes between progress messages */
+#define IMPORT_PROGRESS_STEP	500
+
+typedef struct importCtxt {
+	xmlTextReaderPtr	reader;
+	gboolean		trusted;	/**< Import Liferea-specific tags and ids */
+	gint64			size;		/**< file size for progress reporting */
+	guint			feeds;		/**< subscriptions imported */
+	guint			folders;	/**< folders imported */
+	guint			reported;	/**< node count of the last progress report */
+} importCtxt;
+
 struct exportData {
 	gboolean	trusted; /**< Include all the extra Liferea-specific tags */
 	xmlNodePtr	cur;
@@ -45,6 +62,90 @@ struct exportData {
 
 static void export_node_children (Node *node, xmlNodePtr cur, gboolean trusted);
 
+static const gchar *
+export_sort_column_name (Node *node)
+{
+	switch (node->sortColumn) {
+		case NODE_VIEW_SORT_BY_TITLE:
+			return "title";
+		case NODE_VIEW_SORT_BY_TIME:
+			return "time";
+		case NODE_VIEW_SORT_BY_PARENT:
+			return "parent";
+		case NODE_VIEW_SORT_BY_STATE:
+			return "state";
+		default:
+			g_assert_not_reached();
+			break;
+	}
+
+	return NULL;
+}
+
+/* Retention ages are given in days or as "forever" */
+static gchar *
+export_retention_to_string (gint days)
+{
+	if (days < 0)
+		return g_strdup ("forever");
+
+	return g_strdup_printf ("%d", days);
+}
+
+static gint
+import_retention_from_string (const gchar *str)
+{
+	if (!str)
+		return 0;
+	if (g_str_equal (str, "forever"))
+		return -1;
+
+	return MAX (0, common_parse_long (str, 0));
+}
+
+typedef void (*exportAttrFunc) (const gchar *name, const gchar *value, gpointer user_data);
+
+/* Passes the generic attributes of a node to the given writer, the
+   ones only Liferea understands are added for trusted exports only */
+static void
+export_node_attrs (Node *node, gboolean trusted, exportAttrFunc func, gpointer user_data)
+{
+	(*func) ("title", node_get_title (node), user_data);
+	(*func) ("text", node_get_title (node), user_data); /* The OPML spec requires "text" */
+	(*func) ("description", node_get_title (node), user_data);
+
+	if (node_provider_get_name (node))
+		(*func) ("type", node_provider_get_name (node), user_data);
+
+	/* Don't add the following tags if we are exporting to other applications */
+	if (!trusted)
+		return;
+
+	(*func) ("id", node_get_id (node), user_data);
+	(*func) ("sortColumn", export_sort_column_name (node), user_data);
+
+	if (FALSE == node->sortReversed)
+		(*func) ("sortReversed", "false", user_data);
+
+	if (node->children)
+		(*func) ("expanded", feed_list_view_is_expanded (node->id)?"true":"false", user_data);
+
+	if (node->retainUnread) {
+		g_autofree gchar *days = export_retention_to_string (node->retainUnread);
+		(*func) ("retainUnread", days, user_data);
+	}
+	if (node->retainRead) {
+		g_autofree gchar *days = export_retention_to_string (node->retainRead);
+		(*func) ("retainRead", days, user_data);
+	}
+}
+
+static void
+export_attr_to_xml (const gchar *name, const gchar *value, gpointer user_data)
+{
+	xmlNewProp ((xmlNodePtr)user_data, BAD_CAST name, BAD_CAST value);
+}
+
 /* Used for exporting, this adds a folder or feed's node to the XML tree */
 static void
 export_append_node_tag (Node *node, gpointer userdata)
@@ -60,41 +161,7 @@ export_append_node_tag (Node *node, gpointer userdata)
 	childNode = xmlNewChild (cur, NULL, BAD_CAST"outline", NULL);
 
 	/* 1. write generic node attributes */
-	xmlNewProp (childNode, BAD_CAST"title", BAD_CAST node_get_title(node));
-	xmlNewProp (childNode, BAD_CAST"text", BAD_CAST node_get_title(node)); /* The OPML spec requires "text" */
-	xmlNewProp (childNode, BAD_CAST"description", BAD_CAST node_get_title(node));
-
-	if (node_provider_get_name (node))
-		xmlNewProp (childNode, BAD_CAST"type", BAD_CAST node_provider_get_name (node));
-
-	/* Don't add the following tags if we are exporting to other applications */
-	if (internal) {
-		xmlNewProp (childNode, BAD_CAST"id", BAD_CAST node_get_id (node));
-
-		switch (node->sortColumn) {
-			case NODE_VIEW_SORT_BY_TITLE:
-				xmlNewProp (childNode, BAD_CAST"sortColumn", BAD_CAST"title");
-				break;
-			case NODE_VIEW_SORT_BY_TIME:
-				xmlNewProp (childNode, BAD_CAST"sortColumn", BAD_CAST"time");
-				break;
-			case NODE_VIEW_SORT_BY_PARENT:
-				xmlNewProp (childNode, BAD_CAST"sortColumn", BAD_CAST"parent");
-				break;
-			case NODE_VIEW_SORT_BY_STATE:
-				xmlNewProp (childNode, BAD_CAST"sortColumn", BAD_CAST"state");
-				break;
-			default:
-				g_assert_not_reached();
-				break;
-		}
-
-		if (FALSE == node->sortReversed)
-			xmlNewProp (childNode, BAD_CAST"sortReversed", BAD_CAST"false");
-
-		if (node->children)
-			xmlNewProp (childNode, BAD_CAST"expanded", BAD_CAST(feed_list_view_is_expanded (node->id)?"true":"false"));
-	}
+	export_node_attrs (node, internal, export_attr_to_xml, childNode);
 
 	/* 2. add node type specific stuff */
 	NODE_PROVIDER (node)->export (node, childNode, internal);
@@ -114,6 +181,366 @@ export_node_children (Node *node, xmlNodePtr cur, gboolean trusted)
 	node_foreach_child_data (node, export_append_node_tag, &params);
 }
 
+/* Incremental saving of the internal feed list
+
+   Every feed list change used to serialize the complete tree into a
+   DOM and write it synchronously from the main loop. Now only the
+   provider specific part of a node (subscription properties, search
+   folder rules...) is serialized when the node was marked as changed,
+   all other nodes reuse a cached fragment. The generic attributes
+   (title, sorting, expansion) are cheap and always written fresh, so
+   renames, moves and expanding folders need no invalidation. Documents
+   that did not change are not written at all, the others are written
+   atomically by a single background writer in the order of the saves.
+
+   Node source root nodes are never cached, as their export writes the
+   OPML file of the node source. */
+
+typedef struct exportFragment {
+	gchar	*attrs;		/*<< serialized provider attributes */
+	gchar	**children;	/*<< serialized provider child elements */
+} exportFragment;
+
+typedef struct exportWriteJob {
+	gchar	*filename;
+	gchar	*digest;	/*<< digest of the content */
+	GString	*content;
+	gint64	started;	/*<< time the save was started [µs] */
+} exportWriteJob;
+
+static GHashTable	*fragments = NULL;	/*<< node id -> exportFragment */
+static GHashTable	*digests = NULL;	/*<< filename -> digest of the last document written successfully */
+static guint		pendingWrites = 0;	/*<< writes queued and not yet done */
+static GThreadPool	*writer = NULL;
+static xmlDocPtr	scratchDoc = NULL;
+static exportStats	stats = { .importProgress = -1 };
+static GMutex		statsLock;		/*<< protects stats, digests and pendingWrites */
+
+static void
+export_fragment_free (gpointer data)
+{
+	exportFragment *fragment = (exportFragment *)data;
+
+	g_free (fragment->attrs);
+	g_strfreev (fragment->children);
+	g_free (fragment);
+}
+
+static void
+export_append_escaped (GString *out, const gchar *value)
+{
+	if (!value)
+		return;
+
+	for (; *value; value++) {
+		switch (*value) {
+			case '&':  g_string_append (out, "&amp;"); break;
+			case '<':  g_string_append (out, "&lt;"); break;
+			case '>':  g_string_append (out, "&gt;"); break;
+			case '"':  g_string_append (out, "&quot;"); break;
+			case '\n': g_string_append (out, "&#10;"); break;
+			case '\r': g_string_append (out, "&#13;"); break;
+			case '\t': g_string_append (out, "&#9;"); break;
+			default:   g_string_append_c (out, *value); break;
+		}
+	}
+}
+
+static void
+export_append_attr (GString *out, const gchar *name, const gchar *value)
+{
+	g_string_append_printf (out, " %s=\"", name);
+	export_append_escaped (out, value);
+	g_string_append_c (out, '"');
+}
+
+static void
+export_attr_to_string (const gchar *name, const gchar *value, gpointer user_data)
+{
+	export_append_attr ((GString *)user_data, name, value);
+}
+
+static exportFragment *
+export_fragment_new (Node *node)
+{
+	exportFragment	*fragment;
+	xmlNodePtr	xml, iter;
+	xmlAttrPtr	attr;
+	GString		*attrs;
+	GPtrArray	*children;
+
+	if (!scratchDoc)
+		scratchDoc = xmlNewDoc (BAD_CAST"1.0");
+
+	xml = xmlNewDocNode (scratchDoc, NULL, BAD_CAST"outline", NULL);
+	NODE_PROVIDER (node)->export (node, xml, TRUE);
+
+	attrs = g_string_new (NULL);
+	for (attr = xml->properties; attr; attr = attr->next) {
+		xmlChar *value = xmlNodeListGetString (scratchDoc, attr->children, 1);
+		export_append_attr (attrs, (const gchar *)attr->name, (const gchar *)value);
+		xmlFree (value);
+	}
+
+	children = g_ptr_array_new ();
+	for (iter = xml->children; iter; iter = iter->next) {
+		xmlBufferPtr buf = xmlBufferCreate ();
+		xmlNodeDump (buf, scratchDoc, iter, 0, 0);
+		g_ptr_array_add (children, g_strdup ((const gchar *)xmlBufferContent (buf)));
+		xmlBufferFree (buf);
+	}
+	g_ptr_array_add (children, NULL);
+
+	xmlFreeNode (xml);
+
+	fragment = g_new0 (exportFragment, 1);
+	fragment->attrs = g_string_free (attrs, FALSE);
+	fragment->children = (gchar **)g_ptr_array_free (children, FALSE);
+
+	return fragment;
+}
+
+static void
+export_serialize_node (Node *node, GString *out, guint depth, guint *rebuilt, guint *reused)
+{
+	exportFragment	*fragment;
+	gchar		**iter;
+	gboolean	empty;
+
+	g_string_append_printf (out, "%*s<outline", (gint)(2 * depth), "");
+
+	/* 1. generic node attributes */
+	export_node_attrs (node, TRUE, export_attr_to_string, out);
+
+	/* 2. node type specific stuff */
+	if (IS_NODE_SOURCE (node)) {
+		fragment = export_fragment_new (node);
+		(*rebuilt)++;
+	} else {
+		fragment = g_hash_table_lookup (fragments, node->id);
+		if (fragment) {
+			(*reused)++;
+		} else {
+			fragment = export_fragment_new (node);
+			g_hash_table_insert (fragments, g_strdup (node->id), fragment);
+			(*rebuilt)++;
+		}
+	}
+	g_string_append (out, fragment->attrs);
+
+	/* 3. children */
+	empty = !fragment->children[0] && !(IS_FOLDER (node) && node->children);
+	if (empty) {
+		g_string_append (out, "/>\n");
+	} else {
+		g_string_append (out, ">\n");
+		for (iter = fragment->children; *iter; iter++)
+			g_string_append_printf (out, "%*s%s\n", (gint)(2 * (depth + 1)), "", *iter);
+		if (IS_FOLDER (node)) {
+			GSList *child;
+			for (child = node->children; child; child = child->next)
+				export_serialize_node ((Node *)child->data, out, depth + 1, rebuilt, reused);
+		}
+		g_string_append_printf (out, "%*s</outline>\n", (gint)(2 * depth), "");
+	}
+
+	if (IS_NODE_SOURCE (node))
+		export_fragment_free (fragment);
+}
+
+static void
+export_write_job_free (exportWriteJob *job)
+{
+	g_free (job->filename);
+	g_free (job->digest);
+	g_string_free (job->content, TRUE);
+	g_free (job);
+}
+
+static void
+export_write_thread (gpointer data, gpointer user_data)
+{
+	exportWriteJob	*job = (exportWriteJob *)data;
+	g_autoptr(GError) error = NULL;
+	gint64		start = g_get_monotonic_time ();
+	gboolean	success;
+
+	/* g_file_set_contents() writes to a temporary file and renames it */
+	success = g_file_set_contents (job->filename, job->content->str, job->content->len, &error);
+	if (!success)
+		g_warning ("Could not save feed list to %s: %s", job->filename, error->message);
+
+	g_mutex_lock (&statsLock);
+	pendingWrites--;
+	/* Only a written document may be skipped next time */
+	if (success) {
+		if (digests)
+			g_hash_table_insert (digests, g_strdup (job->filename), g_steal_pointer (&job->digest));
+		stats.written++;
+		stats.bytes += job->content->len;
+		stats.writeTime += g_get_monotonic_time () - start;
+	}
+	stats.lastLatency = g_get_monotonic_time () - job->started;
+	g_mutex_unlock (&statsLock);
+
+	debug (DEBUG_CACHE, "export: wrote %s (%" G_GSIZE_FORMAT " bytes, %" G_GINT64_FORMAT "ms after save)",
+	       job->filename, job->content->len, (g_get_monotonic_time () - job->started) / 1000);
+
+	export_write_job_free (job);
+}
+
+static gboolean
+export_OPML_feedlist_incremental (const gchar *filename, Node *node)
+{
+	exportWriteJob	*job;
+	GSList		*iter;
+	gchar		*digest;
+	gint64		start = g_get_monotonic_time ();
+	guint		rebuilt = 0, reused = 0;
+	gboolean	unchanged;
+
+	if (!fragments)
+		fragments = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, export_fragment_free);
+	g_mutex_lock (&statsLock);
+	if (!digests)
+		digests = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	g_mutex_unlock (&statsLock);
+
+	job = g_new0 (exportWriteJob, 1);
+	job->filename = g_strdup (filename);
+	job->content = g_string_sized_new (4096);
+	job->started = start;
+
+	g_string_append (job->content, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+	                               "<opml version=\"1.0\">\n"
+	                               "  <head>\n"
+	                               "    <title>Liferea Feed List Export</title>\n"
+	                               "  </head>\n"
+	                               "  <body>\n");
+	for (iter = node->children; iter; iter = iter->next)
+		export_serialize_node ((Node *)iter->data, job->content, 2, &rebuilt, &reused);
+	g_string_append (job->content, "  </body>\n</opml>\n");
+
+	digest = g_compute_checksum_for_data (G_CHECKSUM_SHA1, (const guchar *)job->content->str, job->content->len);
+
+	/* A document equal to the last one written is skipped, unless
+	   another write is still pending and will overwrite it */
+	g_mutex_lock (&statsLock);
+	stats.saves++;
+	stats.rebuilt += rebuilt;
+	stats.reused += reused;
+	stats.buildTime += g_get_monotonic_time () - start;
+	unchanged = (0 == pendingWrites && !g_strcmp0 (digest, g_hash_table_lookup (digests, filename)));
+	if (unchanged)
+		stats.unchanged++;
+	else
+		pendingWrites++;
+	g_mutex_unlock (&statsLock);
+
+	if (unchanged) {
+		debug (DEBUG_CACHE, "export: %s unchanged (%u nodes serialized, %u reused)", filename, rebuilt, reused);
+		g_free (digest);
+		export_write_job_free (job);
+		return TRUE;
+	}
+	job->digest = digest;
+
+	debug (DEBUG_CACHE, "export: saving %s (%" G_GSIZE_FORMAT " bytes, %u nodes serialized, %u reused, %" G_GINT64_FORMAT "us)",
+	       filename, job->content->len, rebuilt, reused, g_get_monotonic_time () - start);
+
+	/* A single thread keeps the writes in order */
+	if (!writer)
+		writer = g_thread_pool_new (export_write_thread, NULL, 1, TRUE, NULL);
+	g_thread_pool_push (writer, job, NULL);
+
+	return TRUE;
+}
+
+void
+export_OPML_node_changed (Node *node)
+{
+	if (!node) {
+		if (fragments)
+			g_hash_table_remove_all (fragments);
+		g_mutex_lock (&statsLock);
+		if (digests)
+			g_hash_table_remove_all (digests);
+		g_mutex_unlock (&statsLock);
+		return;
+	}
+
+	if (fragments && node->id)
+		g_hash_table_remove (fragments, node->id);
+}
+
+void
+export_OPML_flush (void)
+{
+	if (writer) {
+		g_thread_pool_free (writer, FALSE, TRUE);
+		writer = NULL;
+	}
+
+	g_clear_pointer (&fragments, g_hash_table_destroy);
+	g_mutex_lock (&statsLock);
+	g_clear_pointer (&digests, g_hash_table_destroy);
+	g_mutex_unlock (&statsLock);
+	g_clear_pointer (&scratchDoc, xmlFreeDoc);
+}
+
+void
+export_OPML_get_stats (exportStats *result)
+{
+	g_mutex_lock (&statsLock);
+	*result = stats;
+	g_mutex_unlock (&statsLock);
+}
+
+void
+export_OPML_to_json (gpointer builder)
+{
+	JsonBuilder	*b = JSON_BUILDER (builder);
+	exportStats	s;
+
+	export_OPML_get_stats (&s);
+
+	json_builder_set_member_name (b, "persistence");
+	json_builder_begin_object (b);
+	json_builder_set_member_name (b, "saves");
+	json_builder_add_int_value (b, s.saves);
+	json_builder_set_member_name (b, "written");
+	json_builder_add_int_value (b, s.written);
+	json_builder_set_member_name (b, "unchanged");
+	json_builder_add_int_value (b, s.unchanged);
+	json_builder_set_member_name (b, "rebuilt");
+	json_builder_add_int_value (b, s.rebuilt);
+	json_builder_set_member_name (b, "reused");
+	json_builder_add_int_value (b, s.reused);
+	json_builder_set_member_name (b, "bytes");
+	json_builder_add_int_value (b, s.bytes);
+	json_builder_set_member_name (b, "buildTime");
+	json_builder_add_int_value (b, s.saves?(s.buildTime / s.saves):0);
+	json_builder_set_member_name (b, "writeTime");
+	json_builder_add_int_value (b, s.written?(s.writeTime / s.written):0);
+	json_builder_set_member_name (b, "latency");
+	json_builder_add_int_value (b, s.lastLatency / 1000);
+	json_builder_set_member_name (b, "imports");
+	json_builder_add_int_value (b, s.imports);
+	json_builder_set_member_name (b, "imported");
+	json_builder_add_int_value (b, s.imported);
+	json_builder_set_member_name (b, "importTime");
+	json_builder_add_int_value (b, s.importTime / 1000);
+	json_builder_set_member_name (b, "importRunning");
+	json_builder_add_boolean_value (b, s.importProgress >= 0);
+	if (s.importProgress >= 0) {
+		json_builder_set_member_name (b, "importing");
+		json_builder_add_int_value (b, s.importing);
+		json_builder_set_member_name (b, "importProgress");
+		json_builder_add_int_value (b, s.importProgress);
+	}
+	json_builder_end_object (b);
+}
+
 gboolean
 export_OPML_feedlist (const gchar *filename, Node *node, gboolean trusted)
 {
@@ -123,6 +550,8 @@ export_OPML_feedlist (const gchar *filename, Node *node, gboolean trusted)
 	gchar		*backupFilename;
 	int		old_umask = 0;
 
+	if (trusted)
+		return export_OPML_feedlist_incremental (filename, node);
 
 	backupFilename = g_strdup_printf ("%s~", filename);
 
@@ -179,11 +608,14 @@ export_OPML_feedlist (const gchar *filename, Node *node, gboolean trusted)
 	return !error;
 }
 
-static void
-import_parse_outline (xmlNodePtr cur, Node *parentNode, gboolean trusted)
+/* Creates a node for an outline element. The children of folders are
+   not imported here but by the reader loop in import_OPML_feedlist().
+   Returns the new node or NULL if the outline was skipped. */
+static Node *
+import_parse_outline (xmlNodePtr cur, Node *parentNode, importCtxt *ctxt)
 {
+	gboolean	trusted = ctxt->trusted;
 	gchar		*title, *type, *tmp, *sortStr;
-	xmlNodePtr	child;
 	Node		*node;
 	gboolean	needsUpdate = FALSE;
 
@@ -206,7 +638,7 @@ import_parse_outline (xmlNodePtr cur, Node *parentNode, gboolean trusted)
 			if (!trusted && tmp[0] == '|') {
 				debug (DEBUG_CACHE, "-> Unsafe command found in untrusted OPML, skipping: %s", tmp);
 				xmlFree (tmp);
-				return;
+				return NULL;
 			}
 
 			type = g_strdup ("feed");
@@ -296,21 +728,23 @@ import_parse_outline (xmlNodePtr cur, Node *parentNode, gboolean trusted)
 	}
 	g_free (tmp);
 
+	/* retention policy */
+	if (trusted) {
+		tmp = (gchar *)xmlGetProp (cur, BAD_CAST"retainUnread");
+		node->retainUnread = import_retention_from_string (tmp);
+		xmlFree (tmp);
+		tmp = (gchar *)xmlGetProp (cur, BAD_CAST"retainRead");
+		node->retainRead = import_retention_from_string (tmp);
+		xmlFree (tmp);
+	}
+
 	/* 3. Try to load the favicon (needs to be done before adding to the feed list) */
 	node_load_icon (node);
 
 	/* 4. add to GUI parent */
 	feedlist_node_imported (node);
 
-	/* 5. import child nodes */
-	if (IS_FOLDER (node)) {
-		child = cur->xmlChildrenNode;
-		while (child) {
-			if (!xmlStrcmp (child->name, BAD_CAST"outline"))
-				import_parse_outline (child, node, trusted);
-			child = child->next;
-		}
-	}
+	/* 5. child nodes of folders are imported by the caller */
 
 	/* 6. do node type specific parsing */
 	NODE_PROVIDER (node)->import (node, parentNode, cur, trusted);
@@ -318,11 +752,10 @@ import_parse_outline (xmlNodePtr cur, Node *parentNode, gboolean trusted)
 	if (node->subscription)
 		liferea_auth_info_query (node->id);
 
-	/* 7. update immediately if necessary */
-	// FIXME: this should not be done here!!!
+	/* 7. schedule the first download, paced to not start all at once */
 	if (node->subscription && needsUpdate) {
-		debug (DEBUG_CACHE, "seems to be an import, setting new id: %s and doing first download...", node_get_id(node));
-		subscription_update (node->subscription, 0);
+		debug (DEBUG_CACHE, "seems to be an import, setting new id: %s and scheduling first download...", node_get_id(node));
+		update_ramp_add (node, 0);
 	}
 
 	/* 8. Always update the node info in the DB to ensure a proper
@@ -330,91 +763,228 @@ import_parse_outline (xmlNodePtr cur, Node *parentNode, gboolean trusted)
 	   silentely fail to work without node entry. */
 	db_node_update (node);
 
+	if (node->subscription)
+		ctxt->feeds++;
+	else if (IS_FOLDER (node))
+		ctxt->folders++;
+
+	return node;
 }
 
-static void
-import_parse_body (xmlNodePtr n, Node *parentNode, gboolean trusted)
+/* Folder outlines have an explicit type or neither type nor URL */
+static gboolean
+import_outline_is_folder (xmlTextReaderPtr reader)
 {
-	xmlNodePtr cur;
-
-	cur = n->xmlChildrenNode;
-	while (cur) {
-		if (!xmlStrcmp (cur->name, BAD_CAST"outline"))
-			import_parse_outline (cur, parentNode, trusted);
-		cur = cur->next;
+	xmlChar		*type, *url;
+	gboolean	folder;
+
+	type = xmlTextReaderGetAttribute (reader, BAD_CAST"type");
+	if (type) {
+		folder = !xmlStrcmp (type, BAD_CAST"folder");
+		xmlFree (type);
+		return folder;
 	}
+
+	url = xmlTextReaderGetAttribute (reader, BAD_CAST"xmlUrl");
+	if (!url)
+		url = xmlTextReaderGetAttribute (reader, BAD_CAST"xmlurl");
+	if (!url)
+		url = xmlTextReaderGetAttribute (reader, BAD_CAST"xmlURL");
+
+	folder = (NULL == url);
+	xmlFree (url);
+
+	return folder;
 }
 
+/* Publishes the progress of a running import in the statistics */
 static void
-import_parse_OPML (xmlNodePtr n, Node *parentNode, gboolean trusted)
+import_report_progress (importCtxt *ctxt)
 {
-	xmlNodePtr cur;
+	guint	count = ctxt->feeds + ctxt->folders;
+	gint	progress;
+
+	/* Skipped outlines do not change the count */
+	if (count == ctxt->reported || 0 != count % IMPORT_PROGRESS_STEP)
+		return;
+
+	ctxt->reported = count;
+	progress = ctxt->size?(gint)MIN (100, 100 * xmlTextReaderByteConsumed (ctxt->reader) / ctxt->size):0;
+
+	g_mutex_lock (&statsLock);
+	stats.importing = count;
+	stats.importProgress = progress;
+	g_mutex_unlock (&statsLock);
+
+	debug (DEBUG_CACHE, "Importing OPML file: %u feeds, %u folders (%d%%)",
+	       ctxt->feeds, ctxt->folders, progress);
+}
 
-	cur = n->xmlChildrenNode;
-	while (cur) {
-		/* we ignore the head */
-		if (!xmlStrcmp (cur->name, BAD_CAST"body")) {
-			import_parse_body (cur, parentNode, trusted);
+/* Walks the OPML document with a streaming reader. Folder outlines
+   become the parent of the following outlines until their end tag,
+   all other outlines are expanded (search folders have rule children)
+   and skipped as a whole. Returns 1 on success, -1 on XML errors and
+   0 if the document is not an OPML document. */
+static gint
+import_read_OPML (importCtxt *ctxt, Node *parentNode)
+{
+	xmlTextReaderPtr	reader = ctxt->reader;
+	GPtrArray		*parents = g_ptr_array_new ();
+	const xmlChar		*section = NULL;
+	gboolean		root = TRUE;
+	gint			ret, result = 1;
+
+	/* parents[i] is the node outlines at depth i + 2 are added to */
+	g_ptr_array_add (parents, parentNode);
+
+	ret = xmlTextReaderRead (reader);
+	while (1 == ret) {
+		const xmlChar	*name = xmlTextReaderConstLocalName (reader);
+		gint		depth = xmlTextReaderDepth (reader);
+		gint		type = xmlTextReaderNodeType (reader);
+
+		if (XML_READER_TYPE_END_ELEMENT == type) {
+			if (1 == depth)
+				section = NULL;
+			else if (depth > 1 && (guint)depth == parents->len && !xmlStrcmp (name, BAD_CAST"outline"))
+				g_ptr_array_remove_index (parents, parents->len - 1);
+
+			ret = xmlTextReaderRead (reader);
+			continue;
+		}
+
+		if (XML_READER_TYPE_ELEMENT != type) {
+			ret = xmlTextReaderRead (reader);
+			continue;
 		}
-		cur = cur->next;
+
+		if (root) {
+			root = FALSE;
+			if (xmlStrcmp (name, BAD_CAST"opml")) {
+				result = 0;
+				break;
+			}
+		} else if (1 == depth) {
+			/* we ignore the head except for the title */
+			section = xmlTextReaderIsEmptyElement (reader)?NULL:xmlTextReaderConstString (reader, name);
+		} else if (2 == depth && section && !xmlStrcmp (section, BAD_CAST"head") && !xmlStrcmp (name, BAD_CAST"title")) {
+			/* set title only when importing as folder and not as OPML source */
+			if (!ctxt->trusted) {
+				xmlChar *titleStr = xmlTextReaderReadString (reader);
+				if (titleStr) {
+					node_set_title (parentNode, (gchar *)titleStr);
+					xmlFree (titleStr);
+				}
+			}
+		} else if (section && !xmlStrcmp (section, BAD_CAST"body") &&
+		           (guint)depth == parents->len + 1 &&
+		           !xmlStrcmp (name, BAD_CAST"outline")) {
+			Node *parent = g_ptr_array_index (parents, parents->len - 1);
+
+			if (import_outline_is_folder (reader)) {
+				Node *node = import_parse_outline (xmlTextReaderCurrentNode (reader), parent, ctxt);
+
+				import_report_progress (ctxt);
+				if (!node) {
+					ret = xmlTextReaderNext (reader);
+					continue;
+				}
+				if (!xmlTextReaderIsEmptyElement (reader))
+					g_ptr_array_add (parents, node);
+			} else {
+				xmlNodePtr cur = xmlTextReaderExpand (reader);
+
+				if (cur) {
+					import_parse_outline (cur, parent, ctxt);
+					import_report_progress (ctxt);
+				}
+				ret = xmlTextReaderNext (reader);
+				continue;
+			}
+		}
+
+		ret = xmlTextReaderRead (reader);
 	}
+
+	if (-1 == ret)
+		result = -1;
+
+	g_ptr_array_free (parents, TRUE);
+
+	return result;
 }
 
 gboolean
 import_OPML_feedlist (const gchar *filename, Node *parentNode, gboolean showErrors, gboolean trusted)
 {
-	xmlDocPtr 	doc;
-	xmlNodePtr 	cur;
+	importCtxt	ctxt;
+	GStatBuf	st;
+	gint64		start = g_get_monotonic_time ();
+	gint		result;
 	gboolean	error = FALSE;
 
 	debug (DEBUG_CACHE, "Importing OPML file: %s", filename);
 
+	memset (&ctxt, 0, sizeof (ctxt));
+	ctxt.trusted = trusted;
+	if (0 == g_stat (filename, &st))
+		ctxt.size = st.st_size;
+
 	/* read the feed list */
-	doc = xmlParseFile (filename);
-	if (!doc) {
+	ctxt.reader = xmlReaderForFile (filename, NULL, XML_PARSE_NONET);
+	if (!ctxt.reader) {
 		if (showErrors)
 			ui_show_error_box (_("XML error while reading OPML file! Could not import \"%s\"!"), filename);
 		else
 			g_warning (_("XML error while reading OPML file! Could not import \"%s\"!"), filename);
-		error = TRUE;
-	} else {
-		cur = xmlDocGetRootElement (doc);
-		if (!cur) {
-			if (showErrors)
-				ui_show_error_box (_("Empty document! OPML document \"%s\" should not be empty when importing."), filename);
-			else
-				g_warning (_("Empty document! OPML document \"%s\" should not be empty when importing."), filename);
-			error = TRUE;
-		} else {
-			if (!trusted) {
-				/* set title only when importing as folder and not as OPML source */
-				xmlNodePtr title = xpath_find (cur, "/opml/head/title");
-				if (title) {
-					xmlChar *titleStr = xmlNodeListGetString (title->doc, title->xmlChildrenNode, 1);
-					if (titleStr) {
-						node_set_title (parentNode, (gchar *)titleStr);
-						xmlFree (titleStr);
-					}
-				}
-			}
+		return FALSE;
+	}
 
-			while (cur) {
-				if (!xmlIsBlankNode (cur)) {
-					if (!xmlStrcmp (cur->name, BAD_CAST"opml")) {
-						import_parse_OPML (cur, parentNode, trusted);
-					} else {
-						if (showErrors)
-							ui_show_error_box (_("\"%s\" is not a valid OPML document! Liferea cannot import this file!"), filename);
-						else
-							g_warning (_("\"%s\" is not a valid OPML document! Liferea cannot import this file!"), filename);
-					}
-				}
-				cur = cur->next;
-			}
-		}
-		xmlFreeDoc (doc);
+	g_mutex_lock (&statsLock);
+	stats.importing = 0;
+	stats.importProgress = 0;
+	g_mutex_unlock (&statsLock);
+
+	/* Create all nodes in one transaction and save the feed list once */
+	db_begin_transaction ();
+	feedlist_import_begin ();
+
+	result = import_read_OPML (&ctxt, parentNode);
+
+	feedlist_import_end ();
+	db_end_transaction ();
+
+	xmlFreeTextReader (ctxt.reader);
+
+	if (-1 == result) {
+		if (showErrors)
+			ui_show_error_box (_("XML error while reading OPML file! Could not import \"%s\"!"), filename);
+		else
+			g_warning (_("XML error while reading OPML file! Could not import \"%s\"!"), filename);
+		error = TRUE;
+	} else if (0 == result) {
+		if (showErrors)
+			ui_show_error_box (_("\"%s\" is not a valid OPML document! Liferea cannot import this file!"), filename);
+		else
+			g_warning (_("\"%s\" is not a valid OPML document! Liferea cannot import this file!"), filename);
 	}
 
+	g_mutex_lock (&statsLock);
+	stats.imports++;
+	stats.imported += ctxt.feeds + ctxt.folders;
+	stats.importTime += g_get_monotonic_time () - start;
+	stats.importing = 0;
+	stats.importProgress = -1;
+	g_mutex_unlock (&statsLock);
+
+	debug (DEBUG_CACHE, "Imported OPML file %s: %u feeds, %u folders in %.1fms",
+	       filename, ctxt.feeds, ctxt.folders, (g_get_monotonic_time () - start) / 1000.0);
+
+	if (showErrors && !error && ctxt.feeds)
+		liferea_shell_toast (ngettext ("Imported %u feed, it will be updated shortly",
+		                               "Imported %u feeds, they will be updated gradually",
+		                               ctxt.feeds), ctxt.feeds);
+
 	return !error;
 }
 
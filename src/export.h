@@ -25,10 +25,32 @@
 
 #include "node.h"
 
+typedef struct exportStats {
+	guint	saves;		/*<< internal feed list documents serialized */
+	guint	written;	/*<< documents written */
+	guint	unchanged;	/*<< documents not written as nothing changed */
+	guint	rebuilt;	/*<< node fragments serialized */
+	guint	reused;		/*<< node fragments taken from the cache */
+	guint64	bytes;		/*<< bytes written */
+	gint64	buildTime;	/*<< total serialization time [µs] */
+	gint64	writeTime;	/*<< total write time [µs] */
+	gint64	lastLatency;	/*<< time from the last save to its write being done [µs] */
+	guint	imports;	/*<< OPML files imported */
+	guint	imported;	/*<< nodes created by imports */
+	gint64	importTime;	/*<< total import time [µs] */
+	guint	importing;	/*<< nodes created so far by the running import */
+	gint	importProgress;	/*<< progress of the running import [%], -1 if none */
+} exportStats;
+
 /**
  * Exports a given feed list tree. Can be used to export
  * the static feed list but also to export subtrees.
  *
+ * Internal exports are incremental: only nodes passed to
+ * export_OPML_node_changed() are serialized again, unchanged
+ * documents are not written and the write itself happens
+ * asynchronously (see export_OPML_flush()).
+ *
  * @param filename	filename of export file
  * @param node		root node of the tree to export
  * @param internal	FALSE if export to other programs
@@ -39,9 +61,43 @@
  */
 gboolean export_OPML_feedlist(const gchar *filename, Node *node, gboolean internal);
 
+/**
+ * Marks the node specific OPML attributes of a node as changed
+ * so the next internal export serializes them again.
+ *
+ * @param node		the changed node, NULL to drop all cached
+ *			serializations and force the next write
+ */
+void export_OPML_node_changed (Node *node);
+
+/**
+ * Waits for all pending internal exports to be written and
+ * drops the serialization cache. To be called on shutdown.
+ */
+void export_OPML_flush (void);
+
+/**
+ * Returns the statistics of the internal feed list exports.
+ *
+ * @param stats		statistics to fill
+ */
+void export_OPML_get_stats (exportStats *stats);
+
+/**
+ * Adds a "persistence" member with the export statistics.
+ *
+ * @param b		a JsonBuilder to append to
+ */
+void export_OPML_to_json (gpointer b);
+
 /**
  * Reads an OPML file and inserts it into the feedlist.
  *
+ * The file is read with a streaming parser, all nodes are
+ * created in one DB transaction and the feed list is saved
+ * once afterwards. First downloads of new subscriptions are
+ * started gradually (see update_ramp.h).
+ *
  * @param filename	path to file that will be read for importing
  * @param parentNode	node of the parent folder
  * @param showErrors	set to TRUE if errors should generate a error dialog
@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <json-glib/json-glib.h>
 
 #include "common.h"
 #include "debug.h"
@@ -37,30 +38,249 @@
 #include "html.h"
 #include "metadata.h"
 
-GdkPixbuf *
-favicon_load_from_cache (const gchar *id, guint size)
+/* Decoded favicons are kept in memory as textures per node id and
+   size, as the feed list, the item list and every node update ask for
+   them. The cache is invalidated whenever a favicon file is written or
+   removed. Cache misses from the GUI are decoded in a worker thread. */
+
+static GHashTable	*textures = NULL;	/* "<id>/<size>" -> GdkTexture */
+static GHashTable	*pending = NULL;	/* "<id>/<size>" -> GSList of faviconLoadRequest */
+static GHashTable	*generations = NULL;	/* node id -> counter bumped on every invalidation */
+static struct {
+	guint	hits;		/* lookups answered from memory */
+	guint	misses;		/* lookups that needed a decode */
+	guint	decodes;	/* asynchronous decodes completed */
+	gsize	bytes;		/* approximate texture memory in use */
+} stats;
+
+typedef struct {
+	faviconLoadedFunc	func;
+	gpointer		user_data;
+} faviconLoadRequest;
+
+static gchar *
+favicon_cache_key (const gchar *id, guint size)
 {
-	struct stat	statinfo;
-	gchar		*filename;
-	GdkPixbuf	*pixbuf, *result = NULL;
-	GError 		*error = NULL;
+	return g_strdup_printf ("%s/%u", id, size);
+}
 
-	filename = common_create_cache_filename ("favicons", id, "png");
+static gsize
+favicon_texture_bytes (GdkTexture *texture)
+{
+	return (gsize)gdk_texture_get_width (texture) * gdk_texture_get_height (texture) * 4;
+}
+
+static void
+favicon_cache_insert (gchar *key, GdkTexture *texture)
+{
+	if (!textures)
+		textures = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+
+	GdkTexture *old = g_hash_table_lookup (textures, key);
+	if (old)
+		stats.bytes -= favicon_texture_bytes (old);
 
-	if (0 == stat ((const char*)filename, &statinfo)) {
-		pixbuf = gdk_pixbuf_new_from_file (filename, &error);
-		if (pixbuf && !error) {
-			result = gdk_pixbuf_scale_simple (pixbuf, size, size, GDK_INTERP_BILINEAR);
-			g_object_unref (pixbuf);
-		} else { /* Error */
-			fprintf (stderr, "Failed to load pixbuf file: %s: %s\n",
-			        filename, error->message);
-			g_error_free (error);
+	stats.bytes += favicon_texture_bytes (texture);
+	g_hash_table_replace (textures, key, g_object_ref (texture));
+}
+
+static guint
+favicon_generation (const gchar *id)
+{
+	if (!generations)
+		return 0;
+
+	return GPOINTER_TO_UINT (g_hash_table_lookup (generations, id));
+}
+
+static void
+favicon_cache_invalidate (const gchar *id)
+{
+	GHashTableIter	iter;
+	gpointer	key, value;
+	gsize		len = strlen (id);
+
+	/* Only decodes of this node's icon become outdated */
+	if (!generations)
+		generations = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	g_hash_table_replace (generations, g_strdup (id), GUINT_TO_POINTER (favicon_generation (id) + 1));
+
+	if (!textures)
+		return;
+
+	g_hash_table_iter_init (&iter, textures);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (0 == strncmp (key, id, len) && ((gchar *)key)[len] == '/') {
+			stats.bytes -= favicon_texture_bytes (GDK_TEXTURE (value));
+			g_hash_table_iter_remove (&iter);
 		}
 	}
-	g_free (filename);
+}
+
+static GdkTexture *
+favicon_decode (const gchar *id, guint size)
+{
+	g_autofree gchar	*filename = common_create_cache_filename ("favicons", id, "png");
+	g_autoptr(GdkPixbuf)	pixbuf = NULL;
+	g_autoptr(GdkPixbuf)	scaled = NULL;
+	GError 			*error = NULL;
+
+	if (!g_file_test (filename, G_FILE_TEST_EXISTS))
+		return NULL;
+
+	pixbuf = gdk_pixbuf_new_from_file (filename, &error);
+	if (!pixbuf || error) {
+		g_warning ("Failed to load pixbuf file: %s: %s", filename, error?error->message:"unknown error");
+		g_clear_error (&error);
+		return NULL;
+	}
+
+	scaled = gdk_pixbuf_scale_simple (pixbuf, size, size, GDK_INTERP_BILINEAR);
+	if (!scaled)
+		return NULL;
 
-	return result;
+	return gdk_texture_new_for_pixbuf (scaled);
+}
+
+GdkTexture *
+favicon_lookup (const gchar *id, guint size)
+{
+	g_autofree gchar	*key = favicon_cache_key (id, size);
+	GdkTexture		*texture = NULL;
+
+	if (textures)
+		texture = g_hash_table_lookup (textures, key);
+
+	if (texture)
+		stats.hits++;
+	else
+		stats.misses++;
+
+	return texture?g_object_ref (texture):NULL;
+}
+
+GdkTexture *
+favicon_load_from_cache (const gchar *id, guint size)
+{
+	GdkTexture *texture = favicon_lookup (id, size);
+
+	if (!texture) {
+		texture = favicon_decode (id, size);
+		if (texture)
+			favicon_cache_insert (favicon_cache_key (id, size), texture);
+	}
+
+	return texture;
+}
+
+typedef struct {
+	gchar	*id;
+	guint	size;
+	guint	generation;
+} faviconDecodeTask;
+
+static void
+favicon_decode_task_free (gpointer data)
+{
+	faviconDecodeTask *t = (faviconDecodeTask *)data;
+
+	g_free (t->id);
+	g_free (t);
+}
+
+static void
+favicon_decode_thread (GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+	faviconDecodeTask *t = (faviconDecodeTask *)task_data;
+
+	g_task_return_pointer (task, favicon_decode (t->id, t->size), g_object_unref);
+}
+
+static void
+favicon_decode_done (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	faviconDecodeTask	*t = g_task_get_task_data (G_TASK (res));
+	g_autoptr(GdkTexture)	texture = g_task_propagate_pointer (G_TASK (res), NULL);
+	g_autofree gchar	*key = favicon_cache_key (t->id, t->size);
+	g_autofree gchar	*pendingKey = NULL;
+	GSList			*requests = NULL;
+
+	stats.decodes++;
+
+	g_hash_table_steal_extended (pending, key, (gpointer *)&pendingKey, (gpointer *)&requests);
+
+	/* Do not cache a result that might have been outdated while decoding */
+	if (texture && t->generation == favicon_generation (t->id))
+		favicon_cache_insert (g_strdup (key), texture);
+
+	for (GSList *iter = requests; iter; iter = g_slist_next (iter)) {
+		faviconLoadRequest *request = (faviconLoadRequest *)iter->data;
+		(*request->func) (t->id, texture, request->user_data);
+	}
+	g_slist_free_full (requests, g_free);
+
+	debug (DEBUG_CACHE, "favicon cache: %u textures, %zu bytes, %u hits, %u misses, %u decodes",
+	       textures?g_hash_table_size (textures):0, stats.bytes, stats.hits, stats.misses, stats.decodes);
+}
+
+void
+favicon_load_async (const gchar *id, guint size, faviconLoadedFunc func, gpointer user_data)
+{
+	gchar			*key;
+	GSList			*requests;
+	faviconLoadRequest	*request;
+	GTask			*task;
+	faviconDecodeTask	*t;
+
+	g_autoptr(GdkTexture) texture = favicon_lookup (id, size);
+	if (texture) {
+		(*func) (id, texture, user_data);
+		return;
+	}
+
+	if (!pending)
+		pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	request = g_new0 (faviconLoadRequest, 1);
+	request->func = func;
+	request->user_data = user_data;
+
+	/* Join a decode already running for the same icon */
+	key = favicon_cache_key (id, size);
+	requests = g_hash_table_lookup (pending, key);
+	g_hash_table_insert (pending, key, g_slist_append (requests, request));
+	if (requests)
+		return;
+
+	t = g_new0 (faviconDecodeTask, 1);
+	t->id = g_strdup (id);
+	t->size = size;
+	t->generation = favicon_generation (id);
+
+	task = g_task_new (NULL, NULL, favicon_decode_done, NULL);
+	g_task_set_task_data (task, t, favicon_decode_task_free);
+	g_task_run_in_thread (task, favicon_decode_thread);
+	g_object_unref (task);
+}
+
+void
+favicon_to_json (gpointer builder)
+{
+	JsonBuilder *b = JSON_BUILDER (builder);
+
+	json_builder_set_member_name (b, "faviconCache");
+	json_builder_begin_object (b);
+	json_builder_set_member_name (b, "textures");
+	json_builder_add_int_value (b, textures?g_hash_table_size (textures):0);
+	json_builder_set_member_name (b, "bytes");
+	json_builder_add_int_value (b, stats.bytes);
+	json_builder_set_member_name (b, "hits");
+	json_builder_add_int_value (b, stats.hits);
+	json_builder_set_member_name (b, "misses");
+	json_builder_add_int_value (b, stats.misses);
+	json_builder_set_member_name (b, "decodes");
+	json_builder_add_int_value (b, stats.decodes);
+	json_builder_end_object (b);
 }
 
 void
@@ -68,6 +288,8 @@ favicon_remove_from_cache (const gchar *id)
 {
 	gchar		*filename;
 
+	favicon_cache_invalidate (id);
+
 	/* try to load a saved favicon */
 	filename = common_create_cache_filename ("favicons", id, "png");
 	if (g_file_test (filename, G_FILE_TEST_EXISTS)) {
@@ -77,6 +299,31 @@ favicon_remove_from_cache (const gchar *id)
 	g_free (filename);
 }
 
+gboolean
+favicon_copy (const gchar *fromId, const gchar *toId)
+{
+	g_autofree gchar	*from = common_create_cache_filename ("favicons", fromId, "png");
+	g_autofree gchar	*to = common_create_cache_filename ("favicons", toId, "png");
+	g_autofree gchar	*data = NULL;
+	gsize			length;
+	GError			*error = NULL;
+
+	if (g_str_equal (fromId, toId))
+		return g_file_test (from, G_FILE_TEST_EXISTS);
+
+	if (!g_file_get_contents (from, &data, &length, NULL))
+		return FALSE;
+
+	favicon_cache_invalidate (toId);
+	if (!g_file_set_contents (to, data, length, &error)) {
+		g_warning ("Could not copy favicon %s to %s: %s", from, to, error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 /* prevent saving overly huge favicons loaded from net */
 static void
 favicon_pixbuf_size_prepared_cb (GdkPixbufLoader *loader, gint width, gint height, gpointer user_data)
@@ -108,6 +355,7 @@ favicon_save_from_data (const UpdateResult * const result, const gchar *id)
 			if (pixbuf) {
 				gchar *tmp = common_create_cache_filename ("favicons", id, "png");
 				debug (DEBUG_UPDATE, "saving favicon %s to file %s", id, tmp);
+				favicon_cache_invalidate (id);
 				if (!gdk_pixbuf_save (pixbuf, tmp, "png", &err, NULL)) {
 					g_warning ("Could not save favicon (id=%s) to file %s!", id, tmp);
 				} else {
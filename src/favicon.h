@@ -27,16 +27,59 @@
 
 #include "subscription.h"
 
+/**
+ * faviconLoadedFunc:
+ * Callback for favicon_load_async()
+ *
+ * @id:			the node id
+ * @texture:		(nullable): the favicon texture or NULL
+ * @user_data:		user data passed to favicon_load_async()
+ */
+typedef void (*faviconLoadedFunc)(const gchar *id, GdkTexture *texture, gpointer user_data);
+
 /**
  * favicon_load_from_cache: (skip)
- * Tries to load a given favicon from cache.
+ * Tries to load a given favicon from the in-memory texture cache
+ * and decodes it from the disk cache synchronously on a miss.
+ *
+ * @id:			the node id
+ * @size:		width / height in pixel
+ *
+ * Returns: (transfer full): a texture (or NULL)
+ */
+GdkTexture * favicon_load_from_cache (const gchar *id, guint size);
+
+/**
+ * favicon_lookup: (skip)
+ * Returns a favicon only if it is already decoded in memory.
+ *
+ * @id:			the node id
+ * @size:		width / height in pixel
+ *
+ * Returns: (transfer full): a texture (or NULL)
+ */
+GdkTexture * favicon_lookup (const gchar *id, guint size);
+
+/**
+ * favicon_load_async: (skip)
+ * Decodes a favicon from the disk cache in a worker thread. The
+ * callback is run from the main loop (immediately on a memory hit).
+ * Concurrent requests for the same icon share one decode.
  *
  * @id:			the node id
  * @size:		width / height in pixel
+ * @func:		callback
+ * @user_data:		user data for the callback
+ */
+void favicon_load_async (const gchar *id, guint size, faviconLoadedFunc func, gpointer user_data);
+
+/**
+ * favicon_to_json: (skip)
+ * Adds a "faviconCache" member with the texture cache counters.
  *
- * Returns: (transfer null): a pixmap (or NULL)
+ * @b:			a JsonBuilder to append to
  */
-GdkPixbuf * favicon_load_from_cache (const gchar *id, guint size);
+void favicon_to_json (gpointer b);
 
 /**
  * favicon_remove_from_cache:
@@ -46,6 +89,17 @@ GdkPixbuf * favicon_load_from_cache (const gchar *id, guint size);
  */
 void favicon_remove_from_cache (const gchar *id);
 
+/**
+ * favicon_copy:
+ * Shares an already downloaded favicon with another node.
+ *
+ * @fromId:		the node id holding the favicon
+ * @toId:		the node id to copy the favicon to
+ *
+ * Returns: TRUE on success
+ */
+gboolean favicon_copy (const gchar *fromId, const gchar *toId);
+
 /**
  * favicon_save_from_data:
  *
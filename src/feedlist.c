@@ -24,8 +24,13 @@
 #include "common.h"
 #include "conf.h"
 #include "db.h"
+#include "db_maintenance.h"
 #include "debug.h"
+#include "enrichment.h"
+#include "export.h"
+#include "favicon.h"
 #include "feedlist.h"
+#include "item_extract.h"
 #include "itemlist.h"
 #include "json.h"
 #include "node.h"
@@ -34,6 +39,8 @@
 #include "node_providers/vfolder.h"
 #include "node_provider.h"
 #include "node_source.h" 
+#include "retention.h"
+#include "update_ramp.h"
 #include "update.h"
 #include "ui/feed_list_view.h"
 
@@ -82,6 +89,9 @@ struct _FeedList {
 	guint		recountTimer;		/*<< timer id for delayed counter recomputation */
 
 	gboolean	loading;		/*<< prevents the feed list being saved before it is completely loaded */
+	guint		importing;		/*<< number of running OPML imports, defers saving until they are done */
+
+	Node		*updatingNode;		/*<< node whose subscription update result is being processed */
 };
 
 enum {
@@ -92,6 +102,8 @@ enum {
 	NODE_ADDED,		/*<< a new node was added */
 	NODE_REMOVED,		/*<< a node was removed */
 	NODE_MOVED,		/*<< a node was moved (e.g. DnD or by remote account update)*/
+	ITEM_MERGED,		/*<< a new item was merged into an item set */
+	NODE_UPDATE_FINISHED,	/*<< a subscription update result was processed */
 	LAST_SIGNAL
 };
 
@@ -141,6 +153,11 @@ feedlist_finalize (GObject *object)
 		feedlist->recountTimer = 0;
 	}
 
+	enrichment_deinit ();
+	db_maintenance_deinit ();
+	retention_deinit ();
+	update_ramp_deinit ();
+
 	/* Enforce synchronous save upon exit */
 	feedlist_save ();
 
@@ -244,6 +261,30 @@ feedlist_class_init (FeedListClass *klass)
 		G_TYPE_NONE,
 		1,
 		G_TYPE_STRING);
+
+	feedlist_signals[ITEM_MERGED] =
+		g_signal_new ("item-merged",
+		G_OBJECT_CLASS_TYPE (object_class),
+		(GSignalFlags)(G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION),
+		0,
+		NULL,
+		NULL,
+		g_cclosure_marshal_VOID__POINTER,
+		G_TYPE_NONE,
+		1,
+		G_TYPE_POINTER);
+
+	feedlist_signals[NODE_UPDATE_FINISHED] =
+		g_signal_new ("node-update-finished",
+		G_OBJECT_CLASS_TYPE (object_class),
+		(GSignalFlags)(G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION),
+		0,
+		NULL,
+		NULL,
+		g_cclosure_marshal_VOID__STRING,
+		G_TYPE_NONE,
+		1,
+		G_TYPE_STRING);
 }
 
 /* Deferred unread count handling */
@@ -321,13 +362,41 @@ feedlist_mark_node_recount (Node *node)
 		feedlist->recountTimer = g_timeout_add (500, feedlist_flush_pending_node_recounts_cb, NULL);
 }
 
-/* This method is used to initialize the node states in the feed list */
+void
+feedlist_node_adjust_unread_count (Node *node, gint delta)
+{
+	/* A pending recount will query the DB anyway */
+	if (node->needsRecount) {
+		feedlist_mark_node_recount (node);
+		return;
+	}
+
+	if (delta < 0 && (guint)(-delta) > node->unreadCount)
+		node->unreadCount = 0;
+	else
+		node->unreadCount += delta;
+
+	g_signal_emit_by_name (feedlist, "node-updated", node->id);
+
+	/* Parents just sum up their children counters */
+	if (node->parent)
+		feedlist_mark_node_recount (node->parent);
+}
+
 static void
-feedlist_init_node (Node *node)
+feedlist_collect_subscriptions (Node *node, gpointer user_data)
 {
 	if (node->subscription)
-		db_subscription_load (node->subscription);
+		g_hash_table_insert ((GHashTable *)user_data, node->id, node->subscription);
+
+	if (node->children)
+		node_foreach_child_data (node, feedlist_collect_subscriptions, user_data);
+}
 
+/* This method is used to initialize the node states in the feed list */
+static void
+feedlist_init_node (Node *node)
+{
 	node_foreach_child (node, feedlist_init_node);
 	feedlist_update_node_counters_now (node);
 }
@@ -335,6 +404,9 @@ feedlist_init_node (Node *node)
 static void
 feedlist_init (FeedList *fl)
 {
+	GHashTable	*subscriptions;
+	gint64		start, structure, loaded, counted;
+
 	/* 1. Prepare globally accessible singleton */
 	g_assert (NULL == feedlist);
 	feedlist = fl;
@@ -342,17 +414,43 @@ feedlist_init (FeedList *fl)
 
 	/* 2. Set up a root node and import the feed list source structure. */
 	debug (DEBUG_CACHE, "Setting up root node");
+	start = g_get_monotonic_time ();
 	ROOTNODE = node_source_setup_root ();
+	structure = g_get_monotonic_time ();
 
-	/* 3. Import nodes from DB */
+	/* 3. Import nodes from DB. Subscription state and counters are
+	      loaded with a few bulk queries instead of per node. */
 	debug (DEBUG_CACHE, "Initializing node state");
+	subscriptions = g_hash_table_new (g_str_hash, g_str_equal);
+	feedlist_collect_subscriptions (ROOTNODE, subscriptions);
+	db_subscriptions_load (subscriptions);
+	loaded = g_get_monotonic_time ();
+
+	db_counters_preload ();
 	feedlist_foreach (feedlist_init_node);
 	feedlist_flush_pending_node_recounts ();
+	db_counters_drop ();
+	counted = g_get_monotonic_time ();
+
+	debug (DEBUG_CACHE, "startup: feed list structure %.1fms, %u subscriptions %.1fms, counters %.1fms",
+	       (structure - start) / 1000.0,
+	       g_hash_table_size (subscriptions), (loaded - structure) / 1000.0,
+	       (counted - loaded) / 1000.0);
+	g_hash_table_destroy (subscriptions);
 
 	/* 4. Finally save the new feed list state (to persist migration 
 	      related feed drops or initial default feed list import) */
 	feedlist->loading = FALSE;
 	feedlist_schedule_save ();
+
+	/* 5. Resume content extraction of the last session */
+	enrichment_init ();
+
+	/* 6. Check DB consistency in idle time */
+	db_maintenance_init ();
+
+	/* 7. Apply item retention policies in idle time */
+	retention_init ();
 }
 
 static void feedlist_unselect(void);
@@ -387,6 +485,9 @@ feedlist_set_selected (Node *node)
 		if (SELECTED)
 			itemlist_load (SELECTED);
 
+		/* Fetch the selected feeds first if they wait to be updated */
+		update_ramp_promote (SELECTED);
+
 		g_signal_emit_by_name (feedlist, "node-selected", SELECTED?SELECTED->id:NULL);
 	} else {
 		debug (DEBUG_GUI, "selected node stayed: %s", node?node_get_title (node):"none");
@@ -569,6 +670,23 @@ feedlist_node_imported (Node *node)
 	feedlist_schedule_save ();
 }
 
+void
+feedlist_import_begin (void)
+{
+	if (feedlist)
+		feedlist->importing++;
+}
+
+void
+feedlist_import_end (void)
+{
+	if (!feedlist || !feedlist->importing)
+		return;
+
+	if (0 == --feedlist->importing)
+		feedlist_schedule_save ();
+}
+
 void
 feedlist_node_added (Node *node)
 {
@@ -615,6 +733,7 @@ feedlist_node_removed (Node *node)
 
 	node->parent->children = g_slist_remove (node->parent->children, node);
 
+	export_OPML_node_changed (node);
 	g_object_unref (node);
 
 	feedlist_schedule_save ();
@@ -681,6 +800,12 @@ feedlist_schedule_save_cb (gpointer user_data)
 	if (!feedlist || !ROOTNODE)
 		return FALSE;
 
+	/* Imports schedule the save once they are done */
+	if (feedlist->importing) {
+		feedlist->saveTimer = 0;
+		return FALSE;
+	}
+
 	/* Request saving for the root node and thereby forcing the root node
 	   and all node sources to write an OPML file */
 	node_source_export_feedlist ();
@@ -693,7 +818,7 @@ feedlist_schedule_save_cb (gpointer user_data)
 void
 feedlist_schedule_save (void)
 {
-	if (feedlist->loading || feedlist->saveTimer)
+	if (feedlist->loading || feedlist->importing || feedlist->saveTimer)
 		return;
 
 	debug (DEBUG_CONF, "Scheduling feedlist save");
@@ -722,9 +847,54 @@ feedlist_new_items (guint newCount)
 }
 
 void
-feedlist_node_was_updated (Node *node)
+feedlist_item_was_merged (itemPtr item)
+{
+	/* Merging happens without a feed list in the test cases */
+	if (!feedlist)
+		return;
+
+	g_signal_emit_by_name (feedlist, "item-merged", item);
+}
+
+void
+feedlist_node_update_started (Node *node)
+{
+	if (!feedlist)
+		return;
+
+	feedlist->updatingNode = node;
+}
+
+gboolean
+feedlist_node_is_updating (const gchar *nodeId)
+{
+	return feedlist && feedlist->updatingNode && !g_strcmp0 (feedlist->updatingNode->id, nodeId);
+}
+
+void
+feedlist_node_update_finished (Node *node)
+{
+	/* Updates finish without a feed list in the test cases */
+	if (!feedlist)
+		return;
+
+	feedlist->updatingNode = NULL;
+	g_signal_emit_by_name (feedlist, "node-update-finished", node->id);
+}
+
+void
+feedlist_schedule_save_node (Node *node)
 {
+	if (node)
+		export_OPML_node_changed (node);
+
 	feedlist_schedule_save ();
+}
+
+void
+feedlist_node_was_updated (Node *node)
+{
+	feedlist_schedule_save_node (node);
 
 	g_signal_emit_by_name (feedlist, "node-updated", node->id);
 }
@@ -775,7 +945,12 @@ static void
 feedlist_save (void)
 {
 	debug (DEBUG_CONF, "Forced feedlist save");
+
+	/* Serialize everything once more to be sure nothing stale
+	   is left and wait for the write to be done */
+	export_OPML_node_changed (NULL);
 	feedlist_schedule_save_cb (NULL);
+	export_OPML_flush ();
 }
 
 static void
@@ -869,6 +1044,13 @@ feedlist_to_json (void)
 	json_builder_end_array (b);
 
 	update_job_queue_to_json (b);
+	enrichment_to_json (b);
+	item_extract_stats_to_json (b);
+	favicon_to_json (b);
+	db_maintenance_to_json (b);
+	retention_to_json (b);
+	update_ramp_to_json (b);
+	export_OPML_to_json (b);
 
 	json_builder_end_object (b);
 
@@ -58,6 +58,16 @@ void feedlist_set_selected (Node *node);
  */
 void feedlist_mark_node_recount (Node *node);
 
+/**
+ * feedlist_node_adjust_unread_count:
+ * @node: the node whose unread counter changed
+ * @delta: the number of items that became unread (negative if read)
+ *
+ * Applies a known unread count change to @node without recounting
+ * it in the DB. The parents are marked for a coalesced recount.
+ */
+void feedlist_node_adjust_unread_count (Node *node, gint delta);
+
 /**
  * feedlist_get_selected:
  *
@@ -223,6 +233,23 @@ void feedlist_node_added (Node *node);
  */
 void feedlist_node_imported (Node *node);
 
+/**
+ * feedlist_import_begin:
+ *
+ * To be called before importing many nodes (e.g. from an OPML
+ * file). Saving the feed list is deferred until the matching
+ * feedlist_import_end(). Calls can be nested.
+ */
+void feedlist_import_begin (void);
+
+/**
+ * feedlist_import_end:
+ *
+ * Ends an import started with feedlist_import_begin() and
+ * schedules saving the feed list after the outermost one.
+ */
+void feedlist_import_end (void);
+
 /**
  * feedlist_remove_node:
  * @node:		the node to remove
@@ -251,6 +278,17 @@ void feedlist_node_removed (Node *node);
  */
 void feedlist_schedule_save (void);
 
+/**
+ * feedlist_schedule_save_node: (skip)
+ * @node:	the node whose properties were changed
+ *
+ * Like feedlist_schedule_save(), but also marks the node specific
+ * properties (e.g. subscription settings) of @node as changed so
+ * they are serialized again. Generic properties like the title,
+ * sorting or the position in the tree do not need this.
+ */
+void feedlist_schedule_save_node (Node *node);
+
 /**
  * feedlist_is_writable: (skip)
  * 
@@ -324,6 +362,43 @@ Node * feedlist_find_unread_feed (Node *folder);
  */
 void feedlist_new_items (guint newCount);
 
+/**
+ * feedlist_item_was_merged:
+ * @item:	the item just added to an item set
+ *
+ * To be called for each new item a subscription update merged.
+ * Emits "item-merged" with the item which is only valid during
+ * signal emission.
+ */
+void feedlist_item_was_merged (itemPtr item);
+
+/**
+ * feedlist_node_update_started: (skip)
+ * @node:	the node whose subscription update result is processed
+ *
+ * To be called before a subscription update result is processed.
+ * Items merged until feedlist_node_update_finished() is called are
+ * attributed to this update.
+ */
+void feedlist_node_update_started (Node *node);
+
+/**
+ * feedlist_node_is_updating:
+ * @nodeId:	the node id
+ *
+ * Returns: TRUE if the update result of the given node is being processed
+ */
+gboolean feedlist_node_is_updating (const gchar *nodeId);
+
+/**
+ * feedlist_node_update_finished:
+ * @node:	the node whose subscription update was processed
+ *
+ * To be called once a subscription update result (successful
+ * or not) was completely processed. Emits "node-update-finished".
+ */
+void feedlist_node_update_finished (Node *node);
+
 /**
  * feedlist_to_json:
  * 
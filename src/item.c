@@ -256,12 +256,9 @@ item_get_base_url (LifereaItem *item)
 	return node_get_base_url (node_from_id (item->nodeId));
 }
 
-gchar *
-item_to_json (LifereaItem *item)
+void
+item_to_json_members (LifereaItem *item, JsonBuilder *b)
 {
-	g_autoptr(JsonBuilder) b = json_builder_new ();
-
-	json_builder_begin_object (b);
 	json_builder_set_member_name (b, "id");
 	json_builder_add_int_value (b, item->id);
 
@@ -337,7 +334,15 @@ item_to_json (LifereaItem *item)
 
 		json_builder_end_array (b);
 	}
+}
 
+gchar *
+item_to_json (LifereaItem *item)
+{
+	g_autoptr(JsonBuilder) b = json_builder_new ();
+
+	json_builder_begin_object (b);
+	item_to_json_members (item, b);
 	json_builder_end_object (b);
 
 	return json_dump (b);
@@ -24,6 +24,7 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <json-glib/json-glib.h>
 
 #include "enclosure.h"
 
@@ -239,6 +240,15 @@ void item_set_id (LifereaItem *item, const gchar * id);
  */
 void item_set_time (LifereaItem *item, gint64 time);
 
+/**
+ * item_to_json_members: (skip)
+ * @item:	the item to serialize
+ * @b:		a JSON builder with an open object
+ *
+ * Adds all item members to the currently open object of @b.
+ */
+void item_to_json_members (LifereaItem *item, JsonBuilder *b);
+
 /**
  * item_to_json: (skip)
  * @item:	the item to serialize
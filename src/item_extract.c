@@ -0,0 +1,137 @@
+/**
+ * @file item_extract.c  cache for extracted rich content
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "item_extract.h"
+
+#include <string.h>
+
+#include "db.h"
+#include "debug.h"
+#include "json.h"
+#include "metadata.h"
+
+/* Items with scraped HTML5 content ("richContent" metadata) are run
+   through Readability and DOMPurify by the item view. As this is by far
+   the most expensive part of rendering an item the result is reported
+   back by the view and stored in the DB keyed by item id and a hash of
+   the rich content. Subsequent views get the result passed along with
+   the item and skip the extraction. A content change (e.g. a re-scrape)
+   results in a different hash and thereby invalidates the result. */
+
+static struct {
+	guint	hits;		/*<< cached extraction results served to the renderer */
+	guint	misses;		/*<< rich content items the renderer had to extract */
+	guint	stores;		/*<< extraction results saved */
+	guint	coldRenders;	/*<< renderings including an extraction */
+	gdouble	coldMs;		/*<< total time of cold renderings */
+	guint	warmRenders;	/*<< renderings using a cached result */
+	gdouble	warmMs;		/*<< total time of warm renderings */
+} stats;
+
+gchar *
+item_extract_to_json (itemPtr item)
+{
+	g_autoptr(JsonBuilder)	b = NULL;
+	g_autofree gchar	*hash = NULL;
+	g_autofree gchar	*title = NULL;
+	g_autofree gchar	*content = NULL;
+	const gchar		*richContent;
+
+	richContent = metadata_list_get (item->metadata, "richContent");
+	if (!richContent)
+		return item_to_json (item);
+
+	hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, richContent, -1);
+
+	b = json_builder_new ();
+	json_builder_begin_object (b);
+	item_to_json_members (item, b);
+
+	json_builder_set_member_name (b, "extractHash");
+	json_builder_add_string_value (b, hash);
+
+	if (db_item_extract_load (item->id, hash, &title, &content)) {
+		stats.hits++;
+
+		json_builder_set_member_name (b, "extract");
+		json_builder_begin_object (b);
+		json_builder_set_member_name (b, "title");
+		json_builder_add_string_value (b, title);
+		json_builder_set_member_name (b, "content");
+		json_builder_add_string_value (b, content);
+		json_builder_end_object (b);
+	} else {
+		stats.misses++;
+	}
+
+	json_builder_end_object (b);
+
+	return json_dump (b);
+}
+
+void
+item_extract_save (gulong id, const gchar *hash, const gchar *title, const gchar *content)
+{
+	g_return_if_fail (hash != NULL);
+
+	db_item_extract_save (id, hash, title, content);
+	stats.stores++;
+
+	debug (DEBUG_HTML, "saved extraction result for item #%lu (%zu bytes)", id, content?strlen (content):0);
+}
+
+void
+item_extract_rendered (const gchar *result, gdouble ms)
+{
+	if (g_str_equal (result, "hit")) {
+		stats.warmRenders++;
+		stats.warmMs += ms;
+	} else if (g_str_equal (result, "miss")) {
+		stats.coldRenders++;
+		stats.coldMs += ms;
+	} else {
+		return;
+	}
+
+	debug (DEBUG_HTML, "extraction cache: %u hits, %u misses, cold %.1fms avg, warm %.1fms avg",
+	       stats.hits, stats.misses,
+	       stats.coldRenders?stats.coldMs / stats.coldRenders:0.0,
+	       stats.warmRenders?stats.warmMs / stats.warmRenders:0.0);
+}
+
+void
+item_extract_stats_to_json (gpointer builder)
+{
+	JsonBuilder *b = JSON_BUILDER (builder);
+
+	json_builder_set_member_name (b, "extractCache");
+	json_builder_begin_object (b);
+	json_builder_set_member_name (b, "hits");
+	json_builder_add_int_value (b, stats.hits);
+	json_builder_set_member_name (b, "misses");
+	json_builder_add_int_value (b, stats.misses);
+	json_builder_set_member_name (b, "stores");
+	json_builder_add_int_value (b, stats.stores);
+	json_builder_set_member_name (b, "coldAvg");
+	json_builder_add_int_value (b, stats.coldRenders?(gint64)(stats.coldMs / stats.coldRenders):0);
+	json_builder_set_member_name (b, "warmAvg");
+	json_builder_add_int_value (b, stats.warmRenders?(gint64)(stats.warmMs / stats.warmRenders):0);
+	json_builder_end_object (b);
+}
@@ -0,0 +1,68 @@
+/**
+ * @file item_extract.h  cache for extracted rich content
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _ITEM_EXTRACT_H
+#define _ITEM_EXTRACT_H
+
+#include <glib.h>
+
+#include "item.h"
+
+/**
+ * item_extract_to_json: (skip)
+ * @item:	the item to serialize
+ *
+ * Serializes the item like item_to_json() and adds the hash of its
+ * rich content plus a cached extraction result if there is one.
+ *
+ * Returns: (transfer full): JSON string (to be free'd using g_free())
+ */
+gchar * item_extract_to_json (itemPtr item);
+
+/**
+ * item_extract_save: (skip)
+ * @id:		the item id
+ * @hash:	the content hash passed to the renderer
+ * @title:	the extracted title
+ * @content:	the extracted and sanitized content
+ *
+ * Saves an extraction result reported by the renderer.
+ */
+void item_extract_save (gulong id, const gchar *hash, const gchar *title, const gchar *content);
+
+/**
+ * item_extract_rendered: (skip)
+ * @result:	"hit" or "miss" as reported by the renderer
+ * @ms:		rendering time in milliseconds
+ *
+ * Records the rendering time of an item with rich content.
+ */
+void item_extract_rendered (const gchar *result, gdouble ms);
+
+/**
+ * item_extract_stats_to_json: (skip)
+ * @b:		a JsonBuilder to append to
+ *
+ * Adds an "extractCache" member with the cache statistics of
+ * this session.
+ */
+void item_extract_stats_to_json (gpointer b);
+
+#endif
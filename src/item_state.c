@@ -66,6 +66,89 @@ item_set_read_state (itemPtr item, gboolean newState)
 	node_source_item_mark_read (node_from_id (item->nodeId), item, newState);
 }
 
+static void
+item_duplicate_update_in_item_list (gpointer id, gpointer user_data)
+{
+	itemPtr duplicate = item_load (GPOINTER_TO_UINT (id));
+
+	if (duplicate) {
+		itemlist_update_item (duplicate);
+		item_unload (duplicate);
+	}
+}
+
+static void
+item_read_state_propagate_to_duplicates (itemPtr item)
+{
+	GHashTable	*duplicates;
+	GHashTableIter	iter;
+	gpointer	nodeId, ids;
+	Node		*displayed = itemlist_get_displayed_node ();
+	GSList		*localNodes = NULL, *list;
+
+	/* Duplicates of node sources with their own read state handling
+	   need to be synced one by one so the remote side learns about
+	   them. Duplicates in local nodes are marked read with a single
+	   update of the duplicate group per node. */
+	duplicates = db_item_get_unread_duplicates (item->sourceId);
+	g_hash_table_iter_init (&iter, duplicates);
+	while (g_hash_table_iter_next (&iter, &nodeId, &ids)) {
+		/* The check on node_from_id() is an evil workaround
+		   to handle "lost" items in the DB that have no
+		   associated node in the feed list. This should be
+		   fixed by having the feed list in the DB too, so
+		   we can clean up correctly after crashes. */
+		Node *node = node_from_id (nodeId);
+		if (!node)
+			continue;
+
+		if (NODE_SOURCE_TYPE (node)->item_mark_read) {
+			for (list = ids; list; list = g_slist_next (list)) {
+				itemPtr duplicate;
+
+				if (GPOINTER_TO_UINT (list->data) == item->id)
+					continue;
+
+				duplicate = item_load (GPOINTER_TO_UINT (list->data));
+				if (duplicate) {
+					item_set_read_state (duplicate, TRUE);
+					item_unload (duplicate);
+				}
+			}
+		} else {
+			localNodes = g_slist_prepend (localNodes, node);
+		}
+	}
+
+	if (localNodes) {
+		guint total = 0;
+
+		db_begin_transaction ();
+		for (list = localNodes; list; list = g_slist_next (list)) {
+			Node	*node = (Node *)list->data;
+			GSList	*nodeIds = g_hash_table_lookup (duplicates, node->id);
+			guint	changes = db_item_duplicates_mark_read (item->sourceId, node->id, nodeIds);
+
+			if (!changes)
+				continue;
+
+			total += changes;
+			feedlist_node_adjust_unread_count (node, -(gint)changes);
+
+			/* Only duplicates possibly visible need a GUI refresh */
+			if (displayed && (displayed == node || IS_VFOLDER (displayed) || node_is_ancestor (displayed, node)))
+				g_slist_foreach (nodeIds, item_duplicate_update_in_item_list, NULL);
+		}
+		db_end_transaction ();
+
+		if (total)
+			vfolder_foreach (node_update_counters);
+	}
+
+	g_slist_free (localNodes);
+	g_hash_table_destroy (duplicates);
+}
+
 void
 item_read_state_changed (itemPtr item, gboolean newState)
 {
@@ -88,28 +171,8 @@ item_read_state_changed (itemPtr item, gboolean newState)
 	node_update_counters (node);
 
 	/* 6. duplicate state propagation (only for transition to read!) */
-	if (item->validGuid && newState == TRUE) {
-		GSList *duplicates, *iter;
-
-		duplicates = iter = db_item_get_duplicates (item->sourceId);
-		while (iter) {
-			itemPtr duplicate = item_load (GPOINTER_TO_UINT (iter->data));
-
-			/* The check on node_from_id() is an evil workaround
-			   to handle "lost" items in the DB that have no 
-			   associated node in the feed list. This should be 
-			   fixed by having the feed list in the DB too, so
-			   we can clean up correctly after crashes. */
-			if (duplicate && duplicate->id != item->id && node_from_id (duplicate->nodeId)) {
-				item_set_read_state (duplicate, newState);
-			}
-			if (duplicate)
-				item_unload (duplicate);
-			iter = g_slist_next (iter);
-		}
-		g_slist_free (duplicates);
-	}
-
+	if (item->validGuid && newState == TRUE)
+		item_read_state_propagate_to_duplicates (item);
 }
 
 void
@@ -72,6 +72,7 @@ enum {
 	ITEM_ADDED,		/*<< a new item has been added to the list */
 	ITEM_UPDATED,		/*<< state of a currently visible item has changed */
 	ITEM_REMOVED,		/*<< an item has been removed from the list */
+	ITEMS_REMOVED,		/*<< a batch of items (GArray of ids) has been removed from the list */
 	ALL_ITEMS_REMOVED,	/*<< all items have been removed from the list */
 	ITEM_SELECTED,		/*<< the currently selected item has changed */
 	ITEM_BATCH_START,	/*<< item list has been reset and new batch load starts */
@@ -177,6 +178,18 @@ itemlist_class_init (ItemListClass *klass)
 		1,
 		G_TYPE_INT);
 
+	itemlist_signals[ITEMS_REMOVED] =
+		g_signal_new ("items-removed",
+		G_OBJECT_CLASS_TYPE (object_class),
+		(GSignalFlags)(G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION),
+		0,
+		NULL,
+		NULL,
+		g_cclosure_marshal_VOID__POINTER,
+		G_TYPE_NONE,
+		1,
+		G_TYPE_POINTER);
+
 	itemlist_signals[ALL_ITEMS_REMOVED] =
 		g_signal_new ("all-items-removed",
 		G_OBJECT_CLASS_TYPE (object_class),
@@ -503,42 +516,35 @@ itemlist_remove_item (itemPtr item)
 	item_unload (item);
 }
 
-/* soft possibly delayed item remove */
-static void
-itemlist_request_remove_item (itemPtr item)
+/* Notifies about items removed from the DB in one batch */
+static guint
+itemlist_items_removed (const gchar *nodeId, GArray *ids)
 {
-	/* if the currently selected item should be removed we
-	   don't do it and set a flag to do it when unselecting */
-	if (itemlist->priv->selectedId != item->id) {
-		g_signal_emit_by_name (itemlist, "item-removed", item->id);
-	} else {
-		itemlist->priv->deferredRemove = TRUE;
-		/* update the item to show new state that forces
-		   later removal */
-		g_signal_emit_by_name (itemlist, "item-updated", item->id);
+	guint	removed = ids->len;
+
+	if (removed) {
+		g_signal_emit_by_name (itemlist, "items-removed", ids);
+
+		vfolder_foreach (node_update_counters);
+		node_update_counters (node_from_id (nodeId));
 	}
-}
 
-void
-itemlist_remove_items (itemSetPtr itemSet, GList *items)
-{
-	GList		*iter = items;
+	g_array_unref (ids);
 
-	while (iter) {
-		itemPtr item = (itemPtr) iter->data;
-		if (itemlist->priv->selectedId != item->id) {
-			g_signal_emit_by_name (itemlist, "item-removed", item->id);
-			db_item_remove(item->id);
-		} else {
-			itemlist_request_remove_item(item);
-		}
-		g_object_unref (item);
+	return removed;
+}
 
-		iter = g_list_next (iter);
-	}
+guint
+itemlist_prune_items (const gchar *nodeId, guint count, guint64 *bytes)
+{
+	/* The selected item is kept, it will be pruned later */
+	return itemlist_items_removed (nodeId, db_itemset_prune (nodeId, count, itemlist->priv->selectedId, bytes));
+}
 
-	vfolder_foreach (node_update_counters);
-	node_update_counters (node_from_id (itemSet->nodeId));
+guint
+itemlist_expire_items (const gchar *nodeId, gint64 unreadBefore, gint64 readBefore, guint limit, guint64 *bytes)
+{
+	return itemlist_items_removed (nodeId, db_itemset_expire (nodeId, unreadBefore, readBefore, limit, itemlist->priv->selectedId, bytes));
 }
 
 void
@@ -145,16 +145,34 @@ void itemlist_update_item (itemPtr item);
 void itemlist_remove_item (itemPtr item);
 
 /**
- * itemlist_remove_items: (skip)
- * @itemSet:	the item set from which items are to be removed
- * @items:	the items to be removed
+ * itemlist_prune_items: (skip)
+ * @nodeId:	the node whose items are to be removed
+ * @count:	number of items to remove
+ * @bytes:	(nullable): adds the approximate size of the removed items
  *
- * To be called whenever some of the items of an item set
- * are to be removed. In difference to itemlist_remove_item()
- * this function will remove all items first and update the
- * GUI once.
+ * Removes the @count oldest unflagged items of a node to
+ * apply its cache limit. The currently selected item is never
+ * removed. In difference to itemlist_remove_item() the items are
+ * removed with a single DB statement and the GUI is notified once.
+ *
+ * Returns: the number of items removed
+ */
+guint itemlist_prune_items (const gchar *nodeId, guint count, guint64 *bytes);
+
+/**
+ * itemlist_expire_items: (skip)
+ * @nodeId:		the node whose items are to be removed
+ * @unreadBefore:	remove unread items older than this [s], 0 to keep all
+ * @readBefore:		remove read items older than this [s], 0 to keep all
+ * @limit:		maximum number of items to remove
+ * @bytes:		(nullable): adds the approximate size of the removed items
+ *
+ * Removes unflagged items older than the given dates like
+ * itemlist_prune_items() does. Used to apply retention policies.
+ *
+ * Returns: the number of items removed
  */
-void itemlist_remove_items (itemSetPtr itemSet, GList *items);
+guint itemlist_expire_items (const gchar *nodeId, gint64 unreadBefore, gint64 readBefore, guint limit, guint64 *bytes);
 
 /**
  * itemlist_remove_all_items: (skip)
@@ -27,11 +27,13 @@
 #include "debug.h"
 #include "download.h"
 #include "enclosure.h"
+#include "feedlist.h"
 #include "node_providers/feed.h"
 #include "itemlist.h"
 #include "itemset.h"
 #include "metadata.h"
 #include "node.h"
+#include "retention.h"
 #include "rule.h"
 #include "node_providers/vfolder.h"
 #include "node_source.h"
@@ -171,7 +173,7 @@ itemset_generic_merge_check (GList *items, itemPtr newItem, gint maxChecks, gboo
 				if (newItem->validTime)
 					oldItem->time = newItem->time;
 
-				// FIXME: this does not remove metadata from DB
+				/* replaced as a whole, db_item_update() rewrites the packed metadata */
 				metadata_list_free (oldItem->metadata);
 				oldItem->metadata = newItem->metadata;
 				newItem->metadata = NULL;
@@ -240,6 +242,8 @@ itemset_merge_item (itemSetPtr itemSet, GList *items, itemPtr item, gint maxChec
 
 		debug (DEBUG_UPDATE, "-> added \"%s\" (id=%d) to item set %p...", item_get_title (item), item->id, itemSet);
 
+		feedlist_item_was_merged (item);
+
 		/* step 4: duplicate detection, mark read if it is a duplicate */
 		if (item->validGuid) {
 			GSList	*iter, *duplicates;
@@ -279,45 +283,47 @@ itemset_merge_item (itemSetPtr itemSet, GList *items, itemPtr item, gint maxChec
 	return merge;
 }
 
-static gint
-itemset_sort_by_date (gconstpointer a, gconstpointer b)
+/* Items older than the retention age would be removed by the next
+   retention round and merged again as new items on the next update */
+static GList *
+itemset_remove_expired (GList *list, Node *node, gboolean markAsRead)
 {
-	itemPtr item1 = (itemPtr)a;
-	itemPtr item2 = (itemPtr)b;
-
-	g_assert(item1 && item2);
-
-	/* We have a problem here if all items of the feed
-	   do have no date, then this comparison is useless.
-	   To avoid such a case we alternatively compare by
-	   item id (which should be an ever-increasing number)
-	   and thereby indicate merge order as a secondary
-	   order criterion */
-	if (item1->time == item2->time) {
-		if (item1->id < item2->id)
-			return 1;
-		if (item1->id > item2->id)
-			return -1;
-		return 0;
-	}
+	GList	*iter = list;
+	gint64	unreadBefore, readBefore;
+
+	retention_get_expiry (node, &unreadBefore, &readBefore);
+	if (!unreadBefore && !readBefore)
+		return list;
 
-	if (item1->time < item2->time)
-		return 1;
-	if (item1->time > item2->time)
-		return -1;
+	while (iter) {
+		GList	*next = g_list_next (iter);
+		itemPtr	item = (itemPtr)iter->data;
+		gint64	before = (markAsRead || item->readStatus)?readBefore:unreadBefore;
+
+		if (before && !item->flagStatus && item->time < before) {
+			debug (DEBUG_UPDATE, "ignoring expired item \"%s\"", item_get_title (item));
+			list = g_list_delete_link (list, iter);
+			item_unload (item);
+		}
+		iter = next;
+	}
 
-	return 0;
+	return list;
 }
 
 guint
 itemset_merge_items (itemSetPtr itemSet, GList *list, gboolean allowUpdates, gboolean markAsRead)
 {
-	GList	*iter, *droppedItems = NULL, *items = NULL;
+	GList	*iter, *items = NULL;
 	guint	i, max, length, toBeDropped, newCount = 0, flagCount = 0;
 	Node	*node;
 
 	debug (DEBUG_UPDATE, "old item set %p of (node id=%s):", itemSet, itemSet->nodeId);
 
+	node = node_from_id (itemSet->nodeId);
+	if (node)
+		list = itemset_remove_expired (list, node, markAsRead);
+
 	/* 1. Preparation: determine effective maximum cache size
 
 	   The problem here is that the configured maximum cache
@@ -406,50 +412,34 @@ itemset_merge_items (itemSetPtr itemSet, GList *list, gboolean allowUpdates, gbo
 
 	vfolder_foreach (node_update_counters);
 
-	node = node_from_id (itemSet->nodeId);
 	if (node && (NODE_SOURCE_TYPE (node)->capabilities & NODE_SOURCE_CAPABILITY_ITEM_STATE_SYNC))
 		node_update_counters (node);
 
 	debug (DEBUG_UPDATE, "added %d new items", newCount);
 
 	/* 4. Apply cache limit for effective item set size
-	      and unload older items as necessary. In this step
+	      and remove older items as necessary. In this step
 	      it is important never to drop flagged items and
-	      to drop the oldest items only. */
+	      to drop the oldest items only. The surplus is
+	      determined and removed by the DB in one go. */
 
-	if (g_list_length (items) > max)
-		toBeDropped = g_list_length (items) - max;
+	length = g_list_length (items);
+	if (length > max)
+		toBeDropped = length - max;
 	else
 		toBeDropped = 0;
 
-	debug (DEBUG_UPDATE, "%u new items, cache limit is %u -> dropping %u items", newCount, max, toBeDropped);
-	items = g_list_sort (items, itemset_sort_by_date);
-	iter = g_list_last (items);
-	while (iter) {
-		itemPtr item = (itemPtr) iter->data;
-		if (toBeDropped > 0 && !item->flagStatus) {
-			debug (DEBUG_UPDATE, "dropping item nr %u (%s)....", item->id, item_get_title (item));
-			droppedItems = g_list_append (droppedItems, item);
-			/* no unloading here, it's done in itemlist_remove_items() */
-			toBeDropped--;
-		} else {
-			item_unload (item);
-		}
-		iter = g_list_previous (iter);
-	}
+	g_list_free_full (items, g_object_unref);
+	items = NULL;
 
-	if (droppedItems) {
-		itemlist_remove_items (itemSet, droppedItems);
-		g_list_free (droppedItems);
-	}
+	debug (DEBUG_UPDATE, "%u new items, cache limit is %u -> dropping %u items", newCount, max, toBeDropped);
+	if (toBeDropped > 0)
+		length -= itemlist_prune_items (itemSet->nodeId, toBeDropped, NULL);
 
-	/* 5. Sanity check to detect merging bugs */
-	if (g_list_length (items) > itemset_get_max_item_count (itemSet) + flagCount)
+	/* 5. Sanity check to detect merging bugs (the selected item is never pruned) */
+	if (length > itemset_get_max_item_count (itemSet) + flagCount + 1)
 		debug (DEBUG_CACHE, "Fatal: Item merging bug! Resulting item list is too long! Cache limit does not work. This is a severe program bug!");
 
-	g_list_free (items);
-
-
 	return newCount;
 }
 
@@ -81,6 +81,19 @@ liferea_application_finalize (GObject *gobject)
 	G_OBJECT_CLASS(liferea_application_parent_class)->finalize(gobject);
 }
 
+static void
+liferea_application_create_shell (LifereaApplication *app)
+{
+	GObject *feedlist;
+
+	app->shell = liferea_shell_create (GTK_APPLICATION (app), app->initialStateOption, app->pluginsDisabled);
+
+	/* Broadcast feed list changes on D-Bus */
+	g_object_get (G_OBJECT (app->shell), "feedlist", &feedlist, NULL);
+	liferea_dbus_watch_feedlist (app->dbus, feedlist);
+	g_object_unref (feedlist);
+}
+
 /* GApplication "open" callback for receiving feed-add requests from remote --add-feed option or
  * adding feeds passed as argument. */
 static void
@@ -92,11 +105,10 @@ on_app_open (GApplication *application,
 {
 	int			i;
 	GFile			**uris = (GFile **)files;
-	GtkApplication		*gtk_app = GTK_APPLICATION (application);
 	LifereaApplication	*app = LIFEREA_APPLICATION (application);
 
 	if (!app->shell)
-		app->shell = liferea_shell_create (gtk_app, app->initialStateOption, app->pluginsDisabled);
+		liferea_application_create_shell (app);
 
 	for (i=0;(i<n_files) && uris[i];i++) {
 		gchar *uri = g_file_get_uri (uris[i]);
@@ -129,7 +141,7 @@ on_app_activate (AdwApplication *adw_app, gpointer user_data)
 	if (app->shell)
 		liferea_shell_show_window ();
 	else
-		app->shell = liferea_shell_create (GTK_APPLICATION (app), app->initialStateOption, app->pluginsDisabled);
+		liferea_application_create_shell (app);
 }
 
 /* Callback to the startup signal emitted only by the primary instance upon registration. */
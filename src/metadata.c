@@ -38,8 +38,12 @@ static GHashTable *metadataTypes = NULL;	/**< hash table with all registered met
 struct pair {
 	gchar		*strid;		/** metadata type id */
 	GSList		*data;		/** list of metadata values */
+	GHashTable	*index;		/** type id -> pair, only set on the first pair of a list */
 };
 
+/* Lists with less pairs are searched linearly */
+#define METADATA_INDEX_MIN	8
+
 /* register metadata types to check validity on adding */
 static void
 metadata_init (void)
@@ -164,6 +168,60 @@ metadata_get_type (const gchar *name)
 	return type;
 }
 
+/* Lists grown past METADATA_INDEX_MIN pairs get a hash index on
+   their first pair, so lookups do not depend on the list length. */
+static void
+metadata_list_index (GSList *metadata)
+{
+	struct pair	*head = (struct pair *)metadata->data;
+	GSList		*iter;
+
+	head->index = g_hash_table_new (g_str_hash, g_str_equal);
+	for (iter = metadata; iter; iter = iter->next) {
+		struct pair *p = (struct pair *)iter->data;
+		g_hash_table_insert (head->index, p->strid, p);
+	}
+}
+
+static struct pair *
+metadata_list_lookup (GSList *metadata, const gchar *strid)
+{
+	GSList	*iter;
+
+	if (!metadata)
+		return NULL;
+
+	if (((struct pair *)metadata->data)->index)
+		return g_hash_table_lookup (((struct pair *)metadata->data)->index, strid);
+
+	for (iter = metadata; iter; iter = iter->next) {
+		struct pair *p = (struct pair *)iter->data;
+		if (g_str_equal (p->strid, strid))
+			return p;
+	}
+
+	return NULL;
+}
+
+static GSList *
+metadata_list_add_pair (GSList *metadata, const gchar *strid, gchar *data)
+{
+	struct pair	*p, *head;
+
+	p = g_new0 (struct pair, 1);
+	p->strid = g_strdup (strid);
+	p->data = g_slist_append (NULL, data);
+	metadata = g_slist_append (metadata, p);
+
+	head = (struct pair *)metadata->data;
+	if (head->index)
+		g_hash_table_insert (head->index, p->strid, p);
+	else if (g_slist_length (metadata) >= METADATA_INDEX_MIN)
+		metadata_list_index (metadata);
+
+	return metadata;
+}
+
 static gint
 metadata_value_cmp (gconstpointer a, gconstpointer b)
 {
@@ -176,7 +234,6 @@ metadata_value_cmp (gconstpointer a, gconstpointer b)
 GSList *
 metadata_list_append (GSList *metadata, const gchar *strid, const gchar *data)
 {
-	GSList		*iter = metadata;
 	gchar		*tmp, *checked_data = NULL;
 	struct pair 	*p;
 
@@ -221,44 +278,32 @@ metadata_list_append (GSList *metadata, const gchar *strid, const gchar *data)
 			break;
 	}
 
-	while (iter) {
-		p = (struct pair*)iter->data;
-		if (g_str_equal (p->strid, strid)) {
-			/* Avoid duplicate values */
-			if (NULL == g_slist_find_custom (p->data, checked_data, metadata_value_cmp))
-				p->data = g_slist_append (p->data, checked_data);
-                        else
-                                g_free (checked_data);
-			return metadata;
-		}
-		iter = iter->next;
+	p = metadata_list_lookup (metadata, strid);
+	if (p) {
+		/* Avoid duplicate values */
+		if (NULL == g_slist_find_custom (p->data, checked_data, metadata_value_cmp))
+			p->data = g_slist_append (p->data, checked_data);
+		else
+			g_free (checked_data);
+		return metadata;
 	}
-	p = g_new (struct pair, 1);
-	p->strid = g_strdup (strid);
-	p->data = g_slist_append (NULL, checked_data);
-	metadata = g_slist_append (metadata, p);
-	return metadata;
+
+	return metadata_list_add_pair (metadata, strid, checked_data);
 }
 
 void
 metadata_list_set (GSList **metadata, const gchar *strid, const gchar *data)
 {
-	GSList	*iter = *metadata;
 	struct pair *p;
 
-	while (iter) {
-		p = (struct pair*)iter->data;
-		if (g_str_equal (p->strid, strid)) {
-                        g_slist_free_full (p->data, g_free);
-                        p->data = g_slist_append (NULL, g_strdup (data));
-			return;
-		}
-		iter = iter->next;
+	p = metadata_list_lookup (*metadata, strid);
+	if (p) {
+		g_slist_free_full (p->data, g_free);
+		p->data = g_slist_append (NULL, g_strdup (data));
+		return;
 	}
-	p = g_new (struct pair, 1);
-	p->strid = g_strdup (strid);
-	p->data = g_slist_append (NULL, g_strdup (data));
-	*metadata = g_slist_append (*metadata, p);
+
+	*metadata = metadata_list_add_pair (*metadata, strid, g_strdup (data));
 }
 
 void
@@ -282,15 +327,9 @@ metadata_list_foreach (GSList *metadata, metadataForeachFunc func, gpointer user
 GSList *
 metadata_list_get_values (GSList *metadata, const gchar *strid)
 {
-	GSList *list = metadata;
+	struct pair *p = metadata_list_lookup (metadata, strid);
 
-	while (list) {
-		struct pair *p = (struct pair*)list->data;
-		if (g_str_equal (p->strid, strid))
-			return p->data;
-		list = list->next;
-	}
-	return NULL;
+	return p?p->data:NULL;
 }
 
 const gchar *
@@ -331,6 +370,8 @@ metadata_list_free (GSList *metadata)
 	while (iter) {
 		struct pair *p = (struct pair*)iter->data;
                 g_slist_free_full (p->data, g_free);
+		if (p->index)
+			g_hash_table_destroy (p->index);
 		g_free (p->strid);
 		g_free (p);
 		iter = iter->next;
@@ -338,6 +379,72 @@ metadata_list_free (GSList *metadata)
 	g_slist_free (metadata);
 }
 
+GVariant *
+metadata_list_to_variant (GSList *metadata)
+{
+	GVariantBuilder	builder;
+	GSList		*iter = metadata;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE (METADATA_VARIANT_TYPE));
+
+	while (iter) {
+		struct pair *p = (struct pair*)iter->data;
+		GSList *values = p->data;
+
+		g_variant_builder_open (&builder, G_VARIANT_TYPE ("(sas)"));
+		g_variant_builder_add (&builder, "s", p->strid);
+		g_variant_builder_open (&builder, G_VARIANT_TYPE ("as"));
+		while (values) {
+			g_variant_builder_add (&builder, "s", (gchar *)values->data);
+			values = values->next;
+		}
+		g_variant_builder_close (&builder);
+		g_variant_builder_close (&builder);
+		iter = iter->next;
+	}
+
+	return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+GSList *
+metadata_list_from_variant (GVariant *variant)
+{
+	GSList		*metadata = NULL;
+	GVariantIter	iter;
+	GVariantIter	*values;
+	const gchar	*strid, *value;
+
+	if (!g_variant_is_of_type (variant, G_VARIANT_TYPE (METADATA_VARIANT_TYPE)))
+		return NULL;
+
+	/* Values were checked when they were first added, so the pairs
+	   are rebuilt directly without running the type specific checks
+	   of metadata_list_append() again. */
+	g_variant_iter_init (&iter, variant);
+	while (g_variant_iter_loop (&iter, "(&sas)", &strid, &values)) {
+		struct pair *p;
+
+		if (!metadata_is_type_registered (strid)) {
+			debug (DEBUG_CACHE, "Skipping unregistered metadata type %s.", strid);
+			continue;
+		}
+
+		p = g_new0 (struct pair, 1);
+		p->strid = g_strdup (strid);
+		while (g_variant_iter_loop (values, "&s", &value))
+			p->data = g_slist_prepend (p->data, g_strdup (value));
+		p->data = g_slist_reverse (p->data);
+
+		metadata = g_slist_prepend (metadata, p);
+	}
+
+	metadata = g_slist_reverse (metadata);
+	if (g_slist_length (metadata) >= METADATA_INDEX_MIN)
+		metadata_list_index (metadata);
+
+	return metadata;
+}
+
 void
 metadata_list_to_json (GSList *metadata, JsonBuilder *b)
 {
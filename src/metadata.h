@@ -151,6 +151,29 @@ GSList * metadata_list_copy (GSList *list);
  */
 void metadata_list_free(GSList *metadata);
 
+/** GVariant type string of packed metadata lists */
+#define METADATA_VARIANT_TYPE	"a(sas)"
+
+/**
+ * Packs the given metadata list into a GVariant of type
+ * METADATA_VARIANT_TYPE for compact storage.
+ *
+ * @param metadata	the metadata list
+ *
+ * @returns a new GVariant (to be free'd using g_variant_unref())
+ */
+GVariant * metadata_list_to_variant (GSList *metadata);
+
+/**
+ * Unpacks a metadata list from a GVariant created with
+ * metadata_list_to_variant(). Unregistered types are dropped.
+ *
+ * @param variant	the packed metadata
+ *
+ * @returns a new metadata list (or NULL)
+ */
+GSList * metadata_list_from_variant (GVariant *variant);
+
 /**
  * metadata_list_to_json:
  * @metadata:	the metadata list
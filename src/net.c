@@ -378,6 +378,10 @@ network_process_request (UpdateJob *job)
 					    update_state_get_etag (job->request->updateState));
 	}
 
+	/* Set the If-Match header for conditional uploads */
+	if (job->request->ifMatch)
+		soup_message_headers_append (request_headers, "If-Match", job->request->ifMatch);
+
 	/* Set the A-IM header */
 	if (job->request->updateState &&
 	    (update_state_get_lastmodified (job->request->updateState) ||
@@ -370,24 +370,42 @@ node_get_title (Node *node)
 	return node->title;
 }
 
+static void
+node_icon_loaded (const gchar *id, GdkTexture *texture, gpointer user_data)
+{
+	Node *node = node_from_id (id);
+
+	/* The node might have been removed meanwhile */
+	if (!node || !texture)
+		return;
+
+	if (node->icon)
+		g_object_unref (node->icon);
+	node->icon = g_object_ref (texture);
+
+	feed_list_view_update_node_icon (node);
+}
+
 void
 node_load_icon (Node *node)
 {
-	/* Load pixbuf for all widget based rendering */
+	/* Load texture for all widget based rendering */
 	if (node->icon)
 		g_object_unref (node->icon);
 
 	// FIXME: don't use constant size, but size corresponding to GTK icon
 	// size used in wide view
-	node->icon = favicon_load_from_cache (node->id, 128);
+	node->icon = favicon_lookup (node->id, 128);
+	if (!node->icon)
+		favicon_load_async (node->id, 128, node_icon_loaded, NULL);
 
 	/* Create filename for HTML rendering */
 	g_free (node->iconFile);
-
-	if (node->icon)
-		node->iconFile = common_create_cache_filename ("favicons", node->id, "png");
-	else
+	node->iconFile = common_create_cache_filename ("favicons", node->id, "png");
+	if (!g_file_test (node->iconFile, G_FILE_TEST_EXISTS)) {
+		g_free (node->iconFile);
 		node->iconFile = g_build_filename (PACKAGE_DATA_DIR, "pixmaps", "default.svg", NULL);
+	}
 }
 
 /* determines the nodes favicon or default icon */
@@ -75,7 +75,7 @@ struct _Node {
 	guint			newCount;	/*<< number of recently downloaded items */
 
 	gchar			*title;		/*<< the label of the node in the feed list */
-	gpointer		icon;		/*<< favicon GdkPixBuf (or NULL) */
+	gpointer		icon;		/*<< favicon GdkTexture (or NULL) */
 	gboolean		available;	/*<< availability of this node (usually the last downloading state) */
 	gboolean		expanded;	/*<< expansion state (for nodes with childs) */
 
@@ -83,6 +83,10 @@ struct _Node {
 	nodeViewSortType	sortColumn;	/*<< Node *specific item view sort attribute. */
 	gboolean		sortReversed;	/*<< Sort in the reverse order? */
 
+	/* retention policy of this node (see retention.c) */
+	gint			retainUnread;	/*<< max. age of unread items [days], 0 to inherit, -1 to keep forever */
+	gint			retainRead;	/*<< max. age of read items [days], 0 to inherit, -1 to keep forever */
+
 	nodeSyncState		syncState; 	/*<< sync state of this node, only used for online accounts */
 	
 	/* current state of this node */	
@@ -21,6 +21,7 @@
 #include "node_providers/folder.h"
 
 #include "common.h"
+#include "db.h"
 #include "debug.h"
 #include "feedlist.h"
 #include "itemset.h"
@@ -37,27 +38,46 @@
 
    The folder node type does not implement the hierarchy of the feed list! */
 
+static itemSetPtr folder_load (Node *node);
+
+typedef struct {
+	GSList	*nodeIds;		/*<< ids of nodes storing items */
+	GSList	*searchFolderIds;	/*<< ids of search folders */
+} folderDescendants;
+
 static void
-folder_merge_child_items (Node *node, gpointer user_data)
+folder_collect_descendants (Node *node, gpointer user_data)
 {
-	itemSetPtr	folderItemSet = (itemSetPtr)user_data;
-	itemSetPtr	nodeItemSet;
-
-	nodeItemSet = node_get_itemset (node);
-	folderItemSet->ids = g_list_concat (folderItemSet->ids, nodeItemSet->ids);
-	nodeItemSet->ids = NULL;
-	itemset_free (nodeItemSet);
+	folderDescendants	*descendants = (folderDescendants *)user_data;
+
+	/* Node sources and the root node use the folder loader too */
+	if (NODE_PROVIDER (node)->load == folder_load)
+		node_foreach_child_data (node, folder_collect_descendants, descendants);
+	else if (IS_VFOLDER (node))
+		descendants->searchFolderIds = g_slist_prepend (descendants->searchFolderIds, node->id);
+	else
+		descendants->nodeIds = g_slist_prepend (descendants->nodeIds, node->id);
 }
 
 static itemSetPtr
 folder_load (Node *node)
 {
-	itemSetPtr	itemSet;
+	folderDescendants	descendants = { NULL, NULL };
+	itemSetPtr		itemSet;
+
+	/* Instead of merging the item sets of all children resolve
+	   all descendants first and fetch their items in one query */
+	node_foreach_child_data (node, folder_collect_descendants, &descendants);
+
+	itemSet = db_itemset_load_multiple (node->id,
+	                                    descendants.nodeIds,
+	                                    descendants.searchFolderIds,
+	                                    node->sortColumn,
+	                                    node->sortReversed);
 
-	itemSet = g_new0 (struct itemSet, 1);
-	itemSet->nodeId = node->id;
+	g_slist_free (descendants.nodeIds);
+	g_slist_free (descendants.searchFolderIds);
 
-	node_foreach_child_data (node, folder_merge_child_items, itemSet);
 	return itemSet;
 }
 
@@ -85,7 +85,7 @@ on_newsbin_common_btn_clicked (GtkButton *button, gpointer user_data)
 	if (newly_created)
 		feedlist_node_added (newsbin);
 
-	feedlist_schedule_save ();
+	feedlist_schedule_save_node (newsbin);
 
 	adw_dialog_close (ADW_DIALOG (dialog));
 }
@@ -46,6 +46,7 @@
 #include "node_sources/dummy_source.h"
 #include "node_sources/google_source.h"
 #include "node_sources/google_reader_api.h"
+#include "node_sources/google_reader_api_edit.h"
 #include "node_sources/opml_source.h"
 #include "node_sources/reedah_source.h"
 #include "node_sources/webdav_source.h"
@@ -657,6 +658,9 @@ node_source_convert_to_local_child_node (Node *node)
 		node_foreach_child (node, node_source_convert_to_local_child_node);
 
 	node->source = feedlist_get_root ()->source;
+
+	/* The cached OPML fragment still has the node source attributes */
+	feedlist_schedule_save_node (node);
 }
 
 void
@@ -680,7 +684,7 @@ node_source_convert_to_local (Node *node)
 
 	node_foreach_child (node, node_source_convert_to_local_child_node);
 
-	feedlist_schedule_save ();
+	feedlist_schedule_save_node (node);
 
 	/* FIXME: something is not perfect, because if you immediately
 	   remove the subscription tree afterwards there is a double free */
@@ -707,6 +711,11 @@ node_source_to_json (Node *node, JsonBuilder *b)
 		json_builder_set_member_name (b, "actionQueueLength");
 		json_builder_add_int_value (b, g_queue_get_length (node->source->actionQueue));
 	}
+
+	if (node->source->api.edit_tag)
+		google_reader_api_edit_to_json (node->source, b);
+	if (node->source->type == google_source_get_type ())
+		google_source_feed_to_json (node->source, b);
 	json_builder_end_object (b);
 }
 
@@ -30,6 +30,7 @@
 #include "feedlist.h"
 #include "node_providers/folder.h"
 #include "update.h"
+#include "update_ramp.h"
 #include "net_monitor.h"
 #include "node_sources/default_source.h"
 #include "node_source.h"
@@ -57,7 +58,7 @@ default_source_start_updating (Node *root)
 	conf_get_int_value (STARTUP_FEED_ACTION, &startup_feed_action);
 	if (0 == startup_feed_action) {
 		debug (DEBUG_UPDATE, "default_source: initial update: updating all feeds");
-		node_update_subscription (root, NULL /* flags*/);
+		update_ramp_add_tree (root, 0);
 	} else {
 		debug (DEBUG_UPDATE, "default_source: initial update: disabled");
 	}
@@ -89,6 +89,11 @@ typedef struct GoogleReaderAction {
 	 * The action result data (available on callback)
 	 */
 	gchar *response;
+
+	/**
+	 * Number of failed attempts to send this action.
+	 */
+	guint attempts;
 } *GoogleReaderActionPtr;
 
 enum {
@@ -107,9 +112,37 @@ typedef struct GoogleReaderAction* editPtr;
 
 typedef struct GoogleReaderActionCtxt {
 	gchar			*nodeId;
-	GoogleReaderActionPtr	action;
+	GSList			*actions;	/**< the actions sent with one request */
 } *GoogleReaderActionCtxtPtr;
 
+/**
+ * Per node source edit state. Read and star edits of several items
+ * are sent with a single edit-tag request (multiple i= parameters)
+ * and the edit token is reused for a while, so marking many items
+ * read does not cost two round trips per item. Only one request is
+ * in flight at a time to keep the edits in order.
+ */
+typedef struct GoogleReaderEditState {
+	GHashTable	*guids;		/**< guid -> number of queued or running actions */
+	gchar		*token;		/**< last edit token */
+	gint64		tokenTime;	/**< time the token was fetched [µs] */
+	gboolean	busy;		/**< TRUE while a request is running */
+	guint		retryTimer;	/**< source id of the timer retrying after a failure (or 0) */
+	guint		failures;	/**< consecutive failed requests, for the retry backoff */
+	guint		requests;	/**< edit requests sent */
+	guint		actions;	/**< actions sent */
+	guint		tokenFetches;	/**< token requests sent */
+	guint		saved;		/**< round trips saved by batching and token reuse */
+	guint		retries;	/**< actions queued again after a failed request */
+	guint		dropped;	/**< actions given up after too many failures */
+} *GoogleReaderEditStatePtr;
+
+#define EDIT_BATCH_MAX	100			/**< items per edit-tag request */
+#define EDIT_TOKEN_TTL	(10 * 60 * G_USEC_PER_SEC)	/**< time a token is reused [µs] */
+#define EDIT_RETRY_MIN	5			/**< first retry delay after a failure [s] */
+#define EDIT_RETRY_MAX	(15 * 60)		/**< maximum retry delay [s] */
+#define EDIT_MAX_ATTEMPTS	5		/**< failed attempts before an action is given up */
+
 static void google_reader_api_edit_push (nodeSourcePtr source, GoogleReaderActionPtr action, gboolean head);
 
 static GoogleReaderActionPtr
@@ -130,14 +163,77 @@ google_reader_api_action_free (GoogleReaderActionPtr action)
 }
 
 static GoogleReaderActionCtxtPtr
-google_reader_api_action_context_new(nodeSourcePtr source, GoogleReaderActionPtr action)
+google_reader_api_action_context_new(nodeSourcePtr source, GSList *actions)
 {
 	GoogleReaderActionCtxtPtr ctxt = g_slice_new0(struct GoogleReaderActionCtxt);
 	ctxt->nodeId = g_strdup(source->root->id);
-	ctxt->action = action;
+	ctxt->actions = actions;
 	return ctxt;
 }
 
+static void
+google_reader_api_edit_state_free (gpointer data)
+{
+	GoogleReaderEditStatePtr state = (GoogleReaderEditStatePtr)data;
+
+	if (state->retryTimer)
+		g_source_remove (state->retryTimer);
+	g_hash_table_destroy (state->guids);
+	g_free (state->token);
+	g_free (state);
+}
+
+static GoogleReaderEditStatePtr
+google_reader_api_edit_state (nodeSourcePtr source)
+{
+	GoogleReaderEditStatePtr state = g_object_get_data (G_OBJECT (source->root), "googleReaderEdit");
+
+	if (!state) {
+		state = g_new0 (struct GoogleReaderEditState, 1);
+		state->guids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+		g_object_set_data_full (G_OBJECT (source->root), "googleReaderEdit", state, google_reader_api_edit_state_free);
+	}
+
+	return state;
+}
+
+static void
+google_reader_api_edit_index_add (GoogleReaderEditStatePtr state, const gchar *guid)
+{
+	guint count;
+
+	if (!guid)
+		return;
+
+	count = GPOINTER_TO_UINT (g_hash_table_lookup (state->guids, guid));
+	g_hash_table_insert (state->guids, g_strdup (guid), GUINT_TO_POINTER (count + 1));
+}
+
+static void
+google_reader_api_edit_index_remove (GoogleReaderEditStatePtr state, const gchar *guid)
+{
+	guint count;
+
+	if (!guid)
+		return;
+
+	count = GPOINTER_TO_UINT (g_hash_table_lookup (state->guids, guid));
+	if (count > 1)
+		g_hash_table_insert (state->guids, g_strdup (guid), GUINT_TO_POINTER (count - 1));
+	else
+		g_hash_table_remove (state->guids, guid);
+}
+
+static gboolean
+google_reader_api_edit_is_tag_action (GoogleReaderActionPtr action)
+{
+	return (action->actionType == EDIT_ACTION_MARK_READ ||
+	        action->actionType == EDIT_ACTION_MARK_UNREAD ||
+	        action->actionType == EDIT_ACTION_TRACKING_MARK_UNREAD ||
+	        action->actionType == EDIT_ACTION_MARK_STARRED ||
+	        action->actionType == EDIT_ACTION_MARK_UNSTARRED);
+}
+
 static void
 google_reader_api_action_context_free (GoogleReaderActionCtxtPtr ctxt)
 {
@@ -145,23 +241,69 @@ google_reader_api_action_context_free (GoogleReaderActionCtxtPtr ctxt)
 	g_slice_free (struct GoogleReaderActionCtxt, ctxt);
 }
 
+static gboolean
+google_reader_api_edit_retry_cb (gpointer user_data)
+{
+	Node				*node = node_from_id ((const gchar *)user_data);
+	GoogleReaderEditStatePtr	state;
+
+	if (!node || !node->source)
+		return G_SOURCE_REMOVE;
+
+	state = google_reader_api_edit_state (node->source);
+	state->retryTimer = 0;
+
+	if (node->source->loginState == NODE_SOURCE_STATE_ACTIVE)
+		google_reader_api_edit_process (node->source);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Schedules processing of the queue after a failed request with
+   an exponentially growing delay */
+static void
+google_reader_api_edit_retry (nodeSourcePtr source, GoogleReaderEditStatePtr state)
+{
+	guint delay = EDIT_RETRY_MAX;
+
+	state->busy = FALSE;
+
+	/* the token might have expired, get a new one next time */
+	g_clear_pointer (&state->token, g_free);
+
+	if (state->failures < 8)
+		delay = MIN (EDIT_RETRY_MIN << state->failures, EDIT_RETRY_MAX);
+	state->failures++;
+
+	if (state->retryTimer)
+		g_source_remove (state->retryTimer);
+	state->retryTimer = g_timeout_add_seconds_full (G_PRIORITY_DEFAULT, delay, google_reader_api_edit_retry_cb,
+	                                                g_strdup (source->root->id), g_free);
+
+	debug (DEBUG_UPDATE, "google_reader_api: %u edits waiting, retrying in %us", g_queue_get_length (source->actionQueue), delay);
+}
+
 static gboolean
 google_reader_api_edit_action_complete (UpdateJob *job)
 {
 	UpdateResult *result = job->result;
 	gpointer userdata = job->user_data;
 	GoogleReaderActionCtxtPtr	editCtxt = (GoogleReaderActionCtxtPtr) userdata;
-	GoogleReaderActionPtr		action = editCtxt->action;
+	GSList				*actions = editCtxt->actions, *iter;
+	GoogleReaderEditStatePtr	state;
 	Node				*node = node_from_id (editCtxt->nodeId);
 	gboolean			failed = FALSE;
 
 	google_reader_api_action_context_free (editCtxt);
 
-	if (!node) {
-		google_reader_api_action_free (action);
+	if (!node || !node->source) {
+		g_slist_free_full (actions, (GDestroyNotify)google_reader_api_action_free);
 		return TRUE; /* probably got deleted before this callback */
 	}
 
+	state = google_reader_api_edit_state (node->source);
+	state->busy = FALSE;
+
 	if (result->data == NULL) {
 		failed = TRUE;
 	} else {
@@ -189,17 +331,49 @@ google_reader_api_edit_action_complete (UpdateJob *job)
 		}
 	}
 
-	if (action->callback) {
-		action->response = result->data;
-		action->callback (node->source, action, !failed);
+	if (failed) {
+		debug (DEBUG_UPDATE, "The edit action failed with result: %s", result->data);
+
+		/* Put the actions back at the head of the queue in their
+		   original order, unless they failed too often already */
+		actions = g_slist_reverse (actions);
+		for (iter = actions; iter; iter = g_slist_next (iter)) {
+			GoogleReaderActionPtr action = (GoogleReaderActionPtr)iter->data;
+
+			if (++action->attempts < EDIT_MAX_ATTEMPTS) {
+				g_queue_push_head (node->source->actionQueue, action);
+				state->retries++;
+				iter->data = NULL;
+				continue;
+			}
+
+			debug (DEBUG_UPDATE, "google_reader_api: giving up action after %u attempts", action->attempts);
+			google_reader_api_edit_index_remove (state, action->guid);
+			state->dropped++;
+			if (action->callback) {
+				action->response = result->data;
+				action->callback (node->source, action, FALSE);
+			}
+			google_reader_api_action_free (action);
+		}
+		g_slist_free (actions);
+
+		google_reader_api_edit_retry (node->source, state);
+		return TRUE;
 	}
 
-	google_reader_api_action_free (action);
+	state->failures = 0;
 
-	if (failed) {
-		debug (DEBUG_UPDATE, "The edit action failed with result: %s", result->data);
-		return TRUE; /** @todo start a timer for next processing */
+	for (iter = actions; iter; iter = g_slist_next (iter)) {
+		GoogleReaderActionPtr action = (GoogleReaderActionPtr)iter->data;
+
+		google_reader_api_edit_index_remove (state, action->guid);
+		if (action->callback) {
+			action->response = result->data;
+			action->callback (node->source, action, TRUE);
+		}
 	}
+	g_slist_free_full (actions, (GDestroyNotify)google_reader_api_action_free);
 
 	/* process anything else waiting on the edit queue */
 	google_reader_api_edit_process (node->source);
@@ -244,17 +418,10 @@ google_reader_api_edit_label (GoogleReaderActionPtr action, UpdateRequest *reque
 	g_free (s_escaped);
 }
 
-static void
-google_reader_api_edit_tag (GoogleReaderActionPtr action, UpdateRequest *request, const gchar *token)
+/* Returns the stream prefix of an item source */
+static const gchar *
+google_reader_api_edit_tag_prefix (GoogleReaderActionPtr action)
 {
-	update_request_set_source (request, action->source->api.edit_tag);
-
-	const gchar* prefix = "feed";
-	gchar* s_escaped = g_uri_escape_string (action->feedUrl, NULL, TRUE);
-	gchar* a_escaped = NULL;
-	gchar* i_escaped = g_uri_escape_string (action->guid, NULL, TRUE);;
-	gchar* postdata = NULL;
-
 	/*
 	 * If the source of the item is a feed then the source *id* will be of
 	 * the form tag:google.com,2005:reader/feed/http://foo.com/bar
@@ -266,9 +433,28 @@ google_reader_api_edit_tag (GoogleReaderActionPtr action, UpdateRequest *request
 	 * :reader/user/ as the case might be). I therefore need to guess
 	 * the prefix ('feed/' or 'user/') from just this information.
 	 */
-
 	if (strstr(action->feedUrl, "://") == NULL)
-		prefix = "user" ;
+		return "user";
+
+	return "feed";
+}
+
+/* Builds one edit-tag request for a batch of actions of the same type */
+static void
+google_reader_api_edit_tag (GSList *actions, UpdateRequest *request, const gchar *token)
+{
+	GoogleReaderActionPtr action = (GoogleReaderActionPtr)actions->data;
+	g_autoptr(GHashTable) sent = g_hash_table_new (g_str_hash, g_str_equal);
+	GString *batch = g_string_new (NULL);
+	GSList *iter;
+
+	update_request_set_source (request, action->source->api.edit_tag);
+
+	const gchar* prefix = google_reader_api_edit_tag_prefix (action);
+	gchar* s_escaped = g_uri_escape_string (action->feedUrl, NULL, TRUE);
+	gchar* a_escaped = NULL;
+	gchar* i_escaped = g_uri_escape_string (action->guid, NULL, TRUE);;
+	gchar* postdata = NULL;
 
 	if (action->actionType == EDIT_ACTION_MARK_UNREAD) {
 		a_escaped = g_uri_escape_string (GOOGLE_READER_TAG_KEPT_UNREAD, NULL, TRUE);
@@ -293,6 +479,7 @@ google_reader_api_edit_tag (GoogleReaderActionPtr action, UpdateRequest *request
 		gchar* r_escaped = g_uri_escape_string(GOOGLE_READER_TAG_STARRED, NULL, TRUE);
 		postdata = g_strdup_printf (action->source->api.edit_tag_remove_post, i_escaped, prefix,
 			s_escaped, r_escaped, token);
+		g_free (r_escaped);
 	}
 
 	else g_assert (FALSE);
@@ -301,36 +488,82 @@ google_reader_api_edit_tag (GoogleReaderActionPtr action, UpdateRequest *request
 	g_free (a_escaped);
 	g_free (i_escaped);
 
-	request->postdata = postdata;
-}
+	/* all other items are added as further item/stream pairs */
+	g_hash_table_add (sent, action->guid);
+	for (iter = g_slist_next (actions); iter; iter = g_slist_next (iter)) {
+		GoogleReaderActionPtr other = (GoogleReaderActionPtr)iter->data;
 
-static gboolean
-google_reader_api_edit_token_cb (UpdateJob *job)
-{
-	UpdateResult *result = job->result;
-	gpointer userdata = job->user_data;
-	Node			*node;
-	const gchar		*token;
-	GoogleReaderActionPtr	action;
-	UpdateRequest		*request;
+		if (g_hash_table_contains (sent, other->guid))
+			continue;
+		g_hash_table_add (sent, other->guid);
 
-	if (result->httpstatus != 200 || result->data == NULL) {
-		/* FIXME: What is the behaviour that should go here? */
-		return TRUE;
+		i_escaped = g_uri_escape_string (other->guid, NULL, TRUE);
+		s_escaped = g_uri_escape_string (other->feedUrl, NULL, TRUE);
+		g_string_append_printf (batch, "&i=%s&s=%s%%2F%s", i_escaped, google_reader_api_edit_tag_prefix (other), s_escaped);
+		g_free (i_escaped);
+		g_free (s_escaped);
 	}
 
-	node = node_from_id ((gchar*) userdata);
-	g_free (userdata);
+	request->postdata = g_strconcat (postdata, batch->str, NULL);
+	g_string_free (batch, TRUE);
+	g_free (postdata);
+}
 
-	if (!node)
-		return TRUE;
+/* Takes the head action and all later queued actions of the same
+   type that can be sent together without changing the order of
+   edits of any item. Subscription edits are never passed. */
+static GSList *
+google_reader_api_edit_collect (nodeSourcePtr source)
+{
+	GoogleReaderActionPtr	first = g_queue_pop_head (source->actionQueue);
+	g_autoptr(GHashTable)	skipped = g_hash_table_new (g_str_hash, g_str_equal);
+	GSList			*batch = g_slist_prepend (NULL, first);
+	GList			*iter, *next;
+	guint			count = 1;
+
+	if (!google_reader_api_edit_is_tag_action (first))
+		return batch;
+
+	for (iter = source->actionQueue->head; iter && count < EDIT_BATCH_MAX; iter = next) {
+		GoogleReaderActionPtr action = (GoogleReaderActionPtr)iter->data;
+		next = g_list_next (iter);
+
+		if (!action->guid)
+			break;
+
+		if (action->actionType != first->actionType ||
+		    g_hash_table_contains (skipped, action->guid)) {
+			g_hash_table_add (skipped, action->guid);
+			continue;
+		}
 
-	token = result->data;
+		g_queue_delete_link (source->actionQueue, iter);
+		batch = g_slist_prepend (batch, action);
+		count++;
+	}
 
-	if (!node->source || g_queue_is_empty (node->source->actionQueue))
-		return TRUE;
+	return g_slist_reverse (batch);
+}
 
-	action = g_queue_peek_head (node->source->actionQueue);
+/* Sends the next request using the given edit token */
+static void
+google_reader_api_edit_send (nodeSourcePtr source, const gchar *token)
+{
+	GoogleReaderEditStatePtr	state = google_reader_api_edit_state (source);
+	Node				*node = source->root;
+	GoogleReaderActionPtr		action;
+	UpdateRequest			*request;
+	GSList				*actions;
+	guint				count;
+
+	if (g_queue_is_empty (source->actionQueue)) {
+		state->busy = FALSE;
+		return;
+	}
+
+	actions = google_reader_api_edit_collect (source);
+	action = (GoogleReaderActionPtr)actions->data;
+	count = g_slist_length (actions);
 
 	request = update_request_new (
 		"POST",
@@ -338,14 +571,10 @@ google_reader_api_edit_token_cb (UpdateJob *job)
 		node->subscription->updateState,
 		node->subscription->updateOptions
 	);
-	update_request_set_auth_value (request, node->source->authToken);
-
-	if (action->actionType == EDIT_ACTION_MARK_READ ||
-	    action->actionType == EDIT_ACTION_MARK_UNREAD ||
-	    action->actionType == EDIT_ACTION_TRACKING_MARK_UNREAD ||
-	    action->actionType == EDIT_ACTION_MARK_STARRED ||
-	    action->actionType == EDIT_ACTION_MARK_UNSTARRED)
-		google_reader_api_edit_tag (action, request, token);
+	update_request_set_auth_value (request, source->authToken);
+
+	if (google_reader_api_edit_is_tag_action (action))
+		google_reader_api_edit_tag (actions, request, token);
 	else if (action->actionType == EDIT_ACTION_ADD_SUBSCRIPTION)
 		google_reader_api_add_subscription (action, request, token);
 	else if (action->actionType == EDIT_ACTION_REMOVE_SUBSCRIPTION)
@@ -354,10 +583,41 @@ google_reader_api_edit_token_cb (UpdateJob *job)
 		 action->actionType == EDIT_ACTION_REMOVE_LABEL)
 		google_reader_api_edit_label (action, request, token);
 
-	debug (DEBUG_UPDATE, "google_reader_api: postdata [%s]", request->postdata);
-	update_job_new (node->source, request, google_reader_api_edit_action_complete, google_reader_api_action_context_new(node->source, action), UPDATE_REQUEST_NO_FEED);
+	state->requests++;
+	state->actions += count;
+	state->saved += count - 1;
+
+	debug (DEBUG_UPDATE, "google_reader_api: sending %u actions (%u requests for %u actions, %u round trips saved) postdata [%s]",
+	       count, state->requests, state->actions, state->saved, request->postdata);
+	update_job_new (source, request, google_reader_api_edit_action_complete, google_reader_api_action_context_new (source, actions), UPDATE_REQUEST_NO_FEED);
+}
+
+static gboolean
+google_reader_api_edit_token_cb (UpdateJob *job)
+{
+	UpdateResult *result = job->result;
+	Node			*node;
+	GoogleReaderEditStatePtr	state;
 
-	action = g_queue_pop_head (node->source->actionQueue);
+	node = node_from_id ((gchar*) job->user_data);
+	g_free (job->user_data);
+
+	if (!node || !node->source)
+		return TRUE;
+
+	state = google_reader_api_edit_state (node->source);
+
+	if (result->httpstatus != 200 || result->data == NULL) {
+		debug (DEBUG_UPDATE, "google_reader_api: fetching edit token failed (HTTP %d)", result->httpstatus);
+		google_reader_api_edit_retry (node->source, state);
+		return TRUE;
+	}
+
+	g_free (state->token);
+	state->token = g_strdup (result->data);
+	state->tokenTime = g_get_monotonic_time ();
+
+	google_reader_api_edit_send (node->source, state->token);
 
 	return TRUE;
 }
@@ -365,17 +625,33 @@ google_reader_api_edit_token_cb (UpdateJob *job)
 void
 google_reader_api_edit_process (nodeSourcePtr source)
 {
-	UpdateRequest *request;
+	GoogleReaderEditStatePtr	state;
+	UpdateRequest			*request;
 
 	g_assert (source);
 	if (g_queue_is_empty (source->actionQueue))
 		return;
 
+	state = google_reader_api_edit_state (source);
+
+	/* After a failure the retry timer continues processing */
+	if (state->busy || state->retryTimer)
+		return;
+
+	state->busy = TRUE;
+
+	/* A recent token is reused instead of requesting a new one */
+	if (state->token && g_get_monotonic_time () - state->tokenTime < EDIT_TOKEN_TTL) {
+		state->saved++;
+		google_reader_api_edit_send (source, state->token);
+		return;
+	}
+
 	/*
  	* Google reader has a system of tokens. So first, I need to request a
  	* token from google, before I can make the actual edit request. The
  	* code here is the token code, the actual edit commands are in
- 	* google_reader_api_edit_token_cb
+ 	* google_reader_api_edit_send
 	 */
 	request = update_request_new (
 		"GET",
@@ -385,6 +661,7 @@ google_reader_api_edit_process (nodeSourcePtr source)
 	);
 	update_request_set_auth_value(request, source->authToken);
 
+	state->tokenFetches++;
 	update_job_new (source, request, google_reader_api_edit_token_cb,
 	                        g_strdup(source->root->id), UPDATE_REQUEST_NO_FEED);
 }
@@ -394,6 +671,7 @@ google_reader_api_edit_push_ (nodeSourcePtr source, GoogleReaderActionPtr action
 {
 	g_assert (source->actionQueue);
 	action->source = source;
+	google_reader_api_edit_index_add (google_reader_api_edit_state (source), action->guid);
 	if (head)
 		g_queue_push_head (source->actionQueue, action);
 	else
@@ -585,14 +863,28 @@ google_reader_api_edit_remove_label (nodeSourcePtr source, const gchar* feedUrl,
 	google_reader_api_edit_push (source, action, TRUE);
 }
 
-gboolean google_reader_api_edit_is_in_queue (nodeSourcePtr source, const gchar* guid)
+gboolean
+google_reader_api_edit_is_in_queue (nodeSourcePtr source, const gchar* guid)
 {
-	/* this is inefficient, but works for the time being */
-	GList *cur = source->actionQueue->head;
-	for(; cur; cur = g_list_next (cur)) {
-		GoogleReaderActionPtr action = cur->data;
-		if (action->guid && g_str_equal (action->guid, guid))
-			return TRUE;
-	}
-	return FALSE;
+	return (NULL != g_hash_table_lookup (google_reader_api_edit_state (source)->guids, guid));
+}
+
+void
+google_reader_api_edit_to_json (nodeSourcePtr source, gpointer builder)
+{
+	JsonBuilder			*b = JSON_BUILDER (builder);
+	GoogleReaderEditStatePtr	state = google_reader_api_edit_state (source);
+
+	json_builder_set_member_name (b, "editRequests");
+	json_builder_add_int_value (b, state->requests);
+	json_builder_set_member_name (b, "editActions");
+	json_builder_add_int_value (b, state->actions);
+	json_builder_set_member_name (b, "editTokenFetches");
+	json_builder_add_int_value (b, state->tokenFetches);
+	json_builder_set_member_name (b, "editRoundTripsSaved");
+	json_builder_add_int_value (b, state->saved);
+	json_builder_set_member_name (b, "editRetries");
+	json_builder_add_int_value (b, state->retries);
+	json_builder_set_member_name (b, "editDropped");
+	json_builder_add_int_value (b, state->dropped);
 }
@@ -96,11 +96,20 @@ void google_reader_api_edit_remove_label (nodeSourcePtr gsource, const gchar* fe
 
 /**
  * See if an item with give guid is being modified 
- * in the queue.
+ * in the queue or by a running request.
  *
  * @param nodeSource the nodeSource structure
  * @param guid the guid of the item
  */
 gboolean google_reader_api_edit_is_in_queue (nodeSourcePtr gsource, const gchar* guid);
 
+/**
+ * Adds the edit request statistics (requests, actions, token
+ * fetches and round trips saved) to a node source JSON object.
+ *
+ * @param gsource The nodeSource structure
+ * @param b a JsonBuilder to append to
+ */
+void google_reader_api_edit_to_json (nodeSourcePtr gsource, gpointer b);
+
 #endif
@@ -85,5 +85,14 @@ void google_source_migrate_node (Node *node);
  */
 void google_source_login (Node *root, guint32 flags);
 
+/**
+ * Adds the item sync statistics of the given Google source
+ * (ids seen, fetched and skipped) to a JsonBuilder object.
+ *
+ * @param source	the node source
+ * @param builder	a JsonBuilder
+ */
+void google_source_feed_to_json (nodeSourcePtr source, gpointer builder);
+
 #endif
 
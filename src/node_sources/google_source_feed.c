@@ -40,22 +40,11 @@
 void
 google_source_migrate_node(Node *node) 
 {
-	/* scan the node for bad ID's, if so, brutally remove the node */
-	itemSetPtr itemset = node_get_itemset (node);
-	GList *iter = itemset->ids;
-	for (; iter; iter = g_list_next (iter)) {
-		itemPtr item = item_load (GPOINTER_TO_UINT (iter->data));
-		if (item && item->sourceId) {
-			if (!g_str_has_prefix(item->sourceId, "tag:google.com")) {
-				debug (DEBUG_UPDATE, "Item with sourceId [%s] will be deleted.", item->sourceId);
-				db_item_remove(GPOINTER_TO_UINT(iter->data));
-			} 
-		}
-		if (item) item_unload (item);
-	}
+	/* remove all items with bad ID's */
+	guint count = db_itemset_remove_foreign (node->id, "tag:google.com");
 
-	/* cleanup */
-	itemset_free (itemset);
+	if (count)
+		debug (DEBUG_UPDATE, "Removed %u items without Google Reader id from %s.", count, node->id);
 }
 
 static void
@@ -97,12 +86,414 @@ google_source_feed_item_cb (JsonNode *node, itemPtr item)
 	}
 }
 
+/* Delta sync: the ids returned by /stream/items/ids are checked against
+   the items already stored for the node, only unknown or changed ones are
+   fetched via /stream/items/contents in chunks of limited size.
+
+   An id is considered changed when its timestamp differs from the one
+   seen when it was last fetched. As remote read and starred state changes
+   do not change the timestamp, the state of the known items is synced on
+   every update from two more id lists: the unread ids of the feed and
+   the starred ids of the account. The starred list is shared by all feeds
+   of a node source for GOOGLE_SOURCE_FEED_STARRED_TTL. */
+
+#define GOOGLE_SOURCE_FEED_WINDOW		50	/* ids per update */
+#define GOOGLE_SOURCE_FEED_CHUNK_SIZE		20
+#define GOOGLE_SOURCE_FEED_STARRED_MAX		1000	/* starred ids per request */
+#define GOOGLE_SOURCE_FEED_STARRED_TTL		60	/* [s] */
+
+#define GOOGLE_READER_ITEM_ID_PREFIX		"tag:google.com,2005:reader/item/"
+
+typedef struct googleSourceFeedSync {
+	GHashTable	*stamps;	/*<< remote id -> timestampUsec when last fetched */
+	GPtrArray	*window;	/*<< remote ids of the last id list */
+} *googleSourceFeedSyncPtr;
+
+typedef struct googleSourceFeedStats {
+	guint		updates;	/*<< id lists processed */
+	guint		seen;		/*<< ids returned by the server */
+	guint		fetched;	/*<< ids requested */
+	guint		skipped;	/*<< ids already stored locally */
+	guint		requests;	/*<< content requests sent */
+	guint		stateRequests;	/*<< unread and starred id lists requested */
+	guint		stateChanges;	/*<< read or flag states changed by a state sync */
+} *googleSourceFeedStatsPtr;
+
+/* starred ids of a node source */
+typedef struct googleSourceFeedStarred {
+	GHashTable	*ids;		/*<< starred remote ids */
+	gboolean	complete;	/*<< TRUE if the list was not truncated */
+	gint64		fetched;	/*<< time of the last fetch [s] */
+	gboolean	running;	/*<< TRUE while a fetch is running */
+	GSList		*waiting;	/*<< ids of nodes to apply the list to */
+} *googleSourceFeedStarredPtr;
+
+/* a single content request */
+typedef struct googleSourceFeedChunk {
+	gchar		*nodeId;
+	GHashTable	*stamps;	/*<< remote id -> timestampUsec */
+} *googleSourceFeedChunkPtr;
+
+static void
+google_source_feed_sync_free (gpointer data)
+{
+	googleSourceFeedSyncPtr sync = (googleSourceFeedSyncPtr)data;
+
+	g_hash_table_destroy (sync->stamps);
+	if (sync->window)
+		g_ptr_array_unref (sync->window);
+	g_free (sync);
+}
+
+static googleSourceFeedSyncPtr
+google_source_feed_sync (Node *node)
+{
+	googleSourceFeedSyncPtr sync = g_object_get_data (G_OBJECT (node), "googleReaderSync");
+
+	if (!sync) {
+		sync = g_new0 (struct googleSourceFeedSync, 1);
+		sync->stamps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+		g_object_set_data_full (G_OBJECT (node), "googleReaderSync", sync, google_source_feed_sync_free);
+	}
+
+	return sync;
+}
+
+static googleSourceFeedStatsPtr
+google_source_feed_stats (nodeSourcePtr source)
+{
+	googleSourceFeedStatsPtr stats = g_object_get_data (G_OBJECT (source->root), "googleReaderFeedStats");
+
+	if (!stats) {
+		stats = g_new0 (struct googleSourceFeedStats, 1);
+		g_object_set_data_full (G_OBJECT (source->root), "googleReaderFeedStats", stats, g_free);
+	}
+
+	return stats;
+}
+
+static void
+google_source_feed_starred_free (gpointer data)
+{
+	googleSourceFeedStarredPtr starred = (googleSourceFeedStarredPtr)data;
+
+	if (starred->ids)
+		g_hash_table_destroy (starred->ids);
+	g_slist_free_full (starred->waiting, g_free);
+	g_free (starred);
+}
+
+static googleSourceFeedStarredPtr
+google_source_feed_starred (nodeSourcePtr source)
+{
+	googleSourceFeedStarredPtr starred = g_object_get_data (G_OBJECT (source->root), "googleReaderStarred");
+
+	if (!starred) {
+		starred = g_new0 (struct googleSourceFeedStarred, 1);
+		g_object_set_data_full (G_OBJECT (source->root), "googleReaderStarred", starred, google_source_feed_starred_free);
+	}
+
+	return starred;
+}
+
+static void
+google_source_feed_chunk_free (gpointer data)
+{
+	googleSourceFeedChunkPtr chunk = (googleSourceFeedChunkPtr)data;
+
+	g_hash_table_destroy (chunk->stamps);
+	g_free (chunk->nodeId);
+	g_free (chunk);
+}
+
+/* remember the fetched ids to skip them next time */
+static void
+google_source_feed_sync_remember (Node *node, googleSourceFeedChunkPtr chunk)
+{
+	googleSourceFeedSyncPtr	sync = google_source_feed_sync (node);
+	GHashTableIter		iter;
+	gpointer		id, stamp;
+
+	g_hash_table_iter_init (&iter, chunk->stamps);
+	while (g_hash_table_iter_next (&iter, &id, &stamp))
+		g_hash_table_insert (sync->stamps, g_strdup (id), g_strdup (stamp));
+}
+
+/* Looks up the state of the item with the given remote id in the result
+   of db_itemset_get_source_states(). Depending on the implementation
+   /stream/items/ids returns the short decimal form, a bare hex id or the
+   long form of the id, while the item contents always carry the long
+   form. If found the long form is returned in sourceId. */
+static dbSourceState *
+google_source_feed_lookup (GHashTable *states, const gchar *id, const gchar **sourceId)
+{
+	g_autofree gchar	*longId = NULL;
+	const gchar		*digits = (id[0] == '-')?id + 1:id;
+	gpointer		key = NULL, state = NULL;
+
+	if (g_str_has_prefix (id, "tag:")) {
+		g_hash_table_lookup_extended (states, id, &key, &state);
+	} else {
+		/* short form: signed 64bit decimal, long form: its 16 digit hex representation */
+		if (*digits && digits[strspn (digits, "0123456789")] == '\0') {
+			longId = g_strdup_printf (GOOGLE_READER_ITEM_ID_PREFIX "%016" G_GINT64_MODIFIER "x",
+			                          (guint64)g_ascii_strtoll (id, NULL, 10));
+			g_hash_table_lookup_extended (states, longId, &key, &state);
+			g_clear_pointer (&longId, g_free);
+		}
+
+		if (!state) {
+			longId = g_strdup_printf (GOOGLE_READER_ITEM_ID_PREFIX "%s", id);
+			g_hash_table_lookup_extended (states, longId, &key, &state);
+		}
+	}
+
+	if (sourceId)
+		*sourceId = (const gchar *)key;
+
+	return (dbSourceState *)state;
+}
+
+/* Parses an /stream/items/ids result into a set of ids, returns NULL on error */
+static GHashTable *
+google_source_feed_parse_ids (const UpdateResult * const result)
+{
+	g_autoptr(JsonParser)	parser = NULL;
+	GHashTable		*ids;
+	JsonNode		*refs;
+	GList			*elements, *iter;
+
+	if (!(result->data && result->httpstatus == 200))
+		return NULL;
+
+	parser = json_parser_new ();
+	if (!json_parser_load_from_data (parser, result->data, -1, NULL))
+		return NULL;
+
+	ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	/* Empty lists might come without "itemRefs" */
+	refs = json_get_node (json_parser_get_root (parser), "itemRefs");
+	if (!refs || JSON_NODE_TYPE (refs) != JSON_NODE_ARRAY)
+		return ids;
+
+	elements = json_array_get_elements (json_node_get_array (refs));
+	for (iter = elements; iter; iter = g_list_next (iter)) {
+		const gchar *id = json_get_string ((JsonNode *)iter->data, "id");
+		if (id)
+			g_hash_table_add (ids, g_strdup (id));
+	}
+	g_list_free (elements);
+
+	return ids;
+}
+
+/* Applies the read state (if unread != NULL) and the flag state (if
+   starred != NULL) reported by the server to the known items of the
+   last id list of the node. Items with pending edits are skipped. */
+static void
+google_source_feed_apply_state (Node *node, GHashTable *unread, GHashTable *starred, gboolean starredComplete)
+{
+	googleSourceFeedSyncPtr		sync = google_source_feed_sync (node);
+	googleSourceFeedStatsPtr	stats = google_source_feed_stats (node->source);
+	g_autoptr(GHashTable)		states = NULL;
+	guint				i, changes = 0;
+
+	if (!sync->window || !sync->window->len)
+		return;
+
+	states = db_itemset_get_source_states (node->id);
+
+	for (i = 0; i < sync->window->len; i++) {
+		const gchar	*id = g_ptr_array_index (sync->window, i);
+		const gchar	*sourceId = NULL;
+		dbSourceState	*state = google_source_feed_lookup (states, id, &sourceId);
+		gboolean	read = state?state->read:FALSE;
+		gboolean	flagged = state?state->flagged:FALSE;
+		itemPtr		item;
+
+		/* Items not yet fetched get their state with the content */
+		if (!state || google_reader_api_edit_is_in_queue (node->source, sourceId))
+			continue;
+
+		if (unread)
+			read = !g_hash_table_contains (unread, id);
+
+		/* A truncated list cannot tell about items not being starred */
+		if (starred && (starredComplete || g_hash_table_contains (starred, id)))
+			flagged = g_hash_table_contains (starred, id);
+
+		if (read == state->read && flagged == state->flagged)
+			continue;
+
+		item = item_load (state->itemId);
+		if (!item)
+			continue;
+
+		if (read != state->read)
+			item_read_state_changed (item, read);
+		if (flagged != state->flagged)
+			item_flag_state_changed (item, flagged);
+		item_unload (item);
+		changes++;
+	}
+
+	stats->stateChanges += changes;
+	if (changes)
+		debug (DEBUG_UPDATE, "synced state of %u items of %s (%s)", changes, node->id, node->title);
+}
+
+static gboolean
+google_source_feed_process_starred_result (UpdateJob *job)
+{
+	Node				*root = node_from_id ((const gchar *)job->user_data);
+	googleSourceFeedStarredPtr	starred;
+	GHashTable			*ids;
+	GSList				*waiting, *iter;
+
+	if (!root || !root->source)
+		return TRUE;
+
+	starred = google_source_feed_starred (root->source);
+	starred->running = FALSE;
+	waiting = g_steal_pointer (&starred->waiting);
+
+	ids = google_source_feed_parse_ids (job->result);
+	if (ids) {
+		if (starred->ids)
+			g_hash_table_destroy (starred->ids);
+		starred->ids = ids;
+		starred->complete = (g_hash_table_size (ids) < GOOGLE_SOURCE_FEED_STARRED_MAX);
+		starred->fetched = g_get_real_time () / G_USEC_PER_SEC;
+
+		for (iter = waiting; iter; iter = g_slist_next (iter)) {
+			Node *node = node_from_id ((const gchar *)iter->data);
+
+			/* the subscription might have been removed in the meantime */
+			if (node && node->subscription)
+				google_source_feed_apply_state (node, NULL, starred->ids, starred->complete);
+		}
+	} else {
+		debug (DEBUG_UPDATE, "fetching starred ids failed (HTTP %d)", job->result->httpstatus);
+	}
+
+	g_slist_free_full (waiting, g_free);
+
+	return TRUE;
+}
+
+/* Cancelled fetches never call back, so do not wait for them forever */
+static void
+google_source_feed_starred_job_free (gpointer data)
+{
+	Node *root = node_from_id ((const gchar *)data);
+
+	if (root && root->source) {
+		googleSourceFeedStarredPtr starred = google_source_feed_starred (root->source);
+
+		starred->running = FALSE;
+		g_slist_free_full (g_steal_pointer (&starred->waiting), g_free);
+	}
+
+	g_free (data);
+}
+
+/* Applies the starred ids to the node, fetching them first if needed */
+static void
+google_source_feed_sync_starred (Node *node, updateFlags flags)
+{
+	Node				*root = node->source->root;
+	googleSourceFeedStarredPtr	starred = google_source_feed_starred (node->source);
+	g_autofree gchar		*url = NULL;
+	UpdateRequest			*request;
+	UpdateJob			*job;
+
+	if (!starred->running && starred->ids &&
+	    g_get_real_time () / G_USEC_PER_SEC - starred->fetched < GOOGLE_SOURCE_FEED_STARRED_TTL) {
+		google_source_feed_apply_state (node, NULL, starred->ids, starred->complete);
+		return;
+	}
+
+	if (!g_slist_find_custom (starred->waiting, node->id, (GCompareFunc)g_strcmp0))
+		starred->waiting = g_slist_prepend (starred->waiting, g_strdup (node->id));
+
+	if (starred->running)
+		return;
+
+	url = g_strdup_printf ("%s/reader/api/0/stream/items/ids?s=%s&client=liferea&n=%d&output=json",
+	                       root->subscription->origSource, "user%2F-%2Fstate%2Fcom.google%2Fstarred",
+	                       GOOGLE_SOURCE_FEED_STARRED_MAX);
+
+	request = update_request_new ("GET", url, NULL, root->subscription->updateOptions);
+	update_request_set_auth_value (request, root->source->authToken);
+
+	starred->running = TRUE;
+	google_source_feed_stats (node->source)->stateRequests++;
+	job = update_job_new (root->subscription, request, google_source_feed_process_starred_result, g_strdup (root->id), flags);
+	job->destroy = google_source_feed_starred_job_free;
+}
+
+static gboolean
+google_source_feed_process_unread_result (UpdateJob *job)
+{
+	Node		*node = node_from_id ((const gchar *)job->user_data);
+	GHashTable	*unread;
+
+	/* the subscription might have been removed in the meantime */
+	if (!node || !node->subscription)
+		return TRUE;
+
+	unread = google_source_feed_parse_ids (job->result);
+	if (unread) {
+		google_source_feed_apply_state (node, unread, NULL, FALSE);
+		g_hash_table_destroy (unread);
+	} else {
+		debug (DEBUG_UPDATE, "fetching unread ids of %s (%s) failed (HTTP %d)", node->id, node->title, job->result->httpstatus);
+	}
+
+	google_source_feed_sync_starred (node, job->flags);
+
+	return TRUE;
+}
+
+/* Fetches the unread ids of the feed. As both lists are sorted newest
+   first every unread item of the last id list is among the first
+   GOOGLE_SOURCE_FEED_WINDOW unread ids. */
+static void
+google_source_feed_sync_state (subscriptionPtr subscription, updateFlags flags)
+{
+	Node			*root = subscription->node->source->root;
+	g_autofree gchar	*sourceEscaped = g_uri_escape_string (metadata_list_get (subscription->metadata, "feed-id"), NULL, TRUE);
+	g_autofree gchar	*url = NULL;
+	UpdateRequest		*request;
+	UpdateJob		*job;
+
+	url = g_strdup_printf ("%s/reader/api/0/stream/items/ids?s=%s&xt=%s&client=liferea&n=%d&output=json&merge=true",
+	                       root->subscription->origSource, sourceEscaped,
+	                       "user%2F-%2Fstate%2Fcom.google%2Fread", GOOGLE_SOURCE_FEED_WINDOW);
+
+	request = update_request_new ("GET", url, NULL, subscription->updateOptions);
+	update_request_set_auth_value (request, root->source->authToken);
+
+	google_source_feed_stats (subscription->node->source)->stateRequests++;
+	job = update_job_new (root->subscription, request, google_source_feed_process_unread_result, g_strdup (subscription->node->id), flags);
+	job->destroy = g_free;
+}
+
 static gboolean
 google_source_feed_subscription_process_update_result (UpdateJob *job)
 {
 	UpdateResult *result = job->result;
-	subscriptionPtr	subscription = (subscriptionPtr)job->user_data;
-	
+	googleSourceFeedChunkPtr chunk = (googleSourceFeedChunkPtr)job->user_data;
+	subscriptionPtr	subscription;
+	Node		*node;
+
+	/* the subscription might have been removed in the meantime */
+	node = node_from_id (chunk->nodeId);
+	if (!node || !node->subscription)
+		return TRUE;
+	subscription = node->subscription;
+
 	if (result->data && result->httpstatus == 200) {
 		GList		*items = NULL;
 		jsonApiMapping	mapping;
@@ -146,11 +537,23 @@ google_source_feed_subscription_process_update_result (UpdateJob *job)
 
 		/* merge against feed cache */
 		if (items) {
-			itemSetPtr itemSet = node_get_itemset (subscription->node);
+			itemSetPtr	itemSet = node_get_itemset (subscription->node);
+			guint		newCount;
+
 			debug (DEBUG_UPDATE, "merging %d items into node %s (%s)", g_list_length(itemSet->ids), subscription->node->id, subscription->node->title);
-			subscription->node->newCount = itemset_merge_items (itemSet, items, TRUE /* feed valid */, FALSE /* markAsRead */);
+			newCount = itemset_merge_items (itemSet, items, TRUE /* feed valid */, FALSE /* markAsRead */);
 			itemlist_merge_itemset (itemSet);
 			itemset_free (itemSet);
+
+			/* Chunks are merged after the subscription update
+			   finished, so they report their new items themselves */
+			subscription->node->newCount += newCount;
+			if (newCount) {
+				feedlist_new_items (newCount);
+				feedlist_node_was_updated (subscription->node);
+			}
+
+			google_source_feed_sync_remember (node, chunk);
 		} else {
 			debug (DEBUG_UPDATE, "result empty %s (%s): %s", subscription->node->id, subscription->node->title, result->data);
 		}
@@ -168,7 +571,10 @@ google_source_feed_subscription_process_ids_result (subscriptionPtr subscription
 {
 	JsonParser	*parser;
 	Node		*root = subscription->node->source->root;
-	
+
+	/* New items are counted by the content requests */
+	subscription->node->newCount = 0;
+
 	if (!(result->data && result->httpstatus == 200)) {
 		subscription->node->available = FALSE;
 		return;
@@ -200,51 +606,120 @@ google_source_feed_subscription_process_ids_result (subscriptionPtr subscription
 	if (json_parser_load_from_data (parser, result->data, -1, NULL)) {
 		JsonArray	*array = json_node_get_array (json_get_node (json_parser_get_root (parser), "itemRefs"));
 		GList		*elements = json_array_get_elements (array);
-		GList		*iter = elements;
-		GString		*query = g_string_new ("");
-		
-		g_string_append_printf (query, "output=json&mediaRss=true&T=%s", 
-		                        root->source->authToken + strlen("GoogleLogin auth="));
-
-		while (iter) {
-			JsonNode *node = (JsonNode *)iter->data;
-			const gchar *id = json_get_string (node, "id");
+		GList		*iter;
+		GHashTable	*stamps, *states;
+		GPtrArray	*wanted = g_ptr_array_new ();
+		googleSourceFeedSyncPtr	sync = google_source_feed_sync (subscription->node);
+		googleSourceFeedStatsPtr stats = google_source_feed_stats (subscription->node->source);
+		guint		seen = 0, skipped = 0, i;
+
+		/* Only ids of the current result need to be remembered, ids
+		   not returned anymore will not show up again. */
+		stamps = sync->stamps;
+		sync->stamps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+		if (sync->window)
+			g_ptr_array_unref (sync->window);
+		sync->window = g_ptr_array_new_with_free_func (g_free);
+
+		states = db_itemset_get_source_states (subscription->node->id);
+
+		for (iter = elements; iter; iter = g_list_next (iter)) {
+			JsonNode	*node = (JsonNode *)iter->data;
+			const gchar	*id = json_get_string (node, "id");
+			const gchar	*stamp = json_get_string (node, "timestampUsec");
+			const gchar	*lastStamp;
+			gboolean	known;
+
+			if (!id)
+				continue;
+
+			seen++;
+			if (!stamp)
+				stamp = "";
+
+			g_ptr_array_add (sync->window, g_strdup (id));
+
+			if (g_hash_table_lookup_extended (stamps, id, NULL, (gpointer *)&lastStamp)) {
+				known = g_str_equal (lastStamp, stamp);
+			} else {
+				known = (NULL != google_source_feed_lookup (states, id, NULL));
+			}
 
-			if (id)
-				g_string_append_printf (query, "&i=%s", id);
-				
-			iter = g_list_next (iter);
+			if (known) {
+				g_hash_table_insert (sync->stamps, g_strdup (id), g_strdup (stamp));
+				skipped++;
+			} else {
+				g_ptr_array_add (wanted, iter->data);
+			}
 		}
-		
-		debug (DEBUG_UPDATE, "got %d ids for %s (%s)", g_list_length(elements), subscription->node->id, subscription->node->title);
-		
-		/* Only if we got some ids */
-		if (elements) {
+		g_hash_table_destroy (stamps);
+		g_hash_table_destroy (states);
+
+		stats->updates++;
+		stats->seen += seen;
+		stats->skipped += skipped;
+		stats->fetched += wanted->len;
+
+		debug (DEBUG_UPDATE, "got %u ids for %s (%s): fetching %u, skipping %u",
+		       seen, subscription->node->id, subscription->node->title,
+		       wanted->len, skipped);
+
+		for (i = 0; i < wanted->len; i += GOOGLE_SOURCE_FEED_CHUNK_SIZE) {
 			g_autofree gchar 	*url = NULL;
+			GString			*query = g_string_new ("");
 			UpdateRequest		*request;
+			UpdateJob		*job;
+			googleSourceFeedChunkPtr chunk;
+			guint			j;
+
+			chunk = g_new0 (struct googleSourceFeedChunk, 1);
+			chunk->nodeId = g_strdup (subscription->node->id);
+			chunk->stamps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+			g_string_append_printf (query, "output=json&mediaRss=true&T=%s",
+			                        root->source->authToken + strlen("GoogleLogin auth="));
+
+			for (j = i; j < wanted->len && j < i + GOOGLE_SOURCE_FEED_CHUNK_SIZE; j++) {
+				JsonNode	*node = (JsonNode *)g_ptr_array_index (wanted, j);
+				const gchar	*id = json_get_string (node, "id");
+				const gchar	*stamp = json_get_string (node, "timestampUsec");
+
+				g_string_append_printf (query, "&i=%s", id);
+				g_hash_table_insert (chunk->stamps, g_strdup (id), g_strdup (stamp?stamp:""));
+			}
 
 			url = g_strdup_printf ("%s/reader/api/0/stream/items/contents", root->subscription->origSource);
-		
+
 			request = update_request_new (
 				"POST",
 				url,
 				subscription->updateState,
 				subscription->updateOptions
 			);
-			request->postdata = g_strdup (query->str);
+			request->postdata = g_string_free (query, FALSE);
 
 			// Redundant to the token already passed in postdata, but FreshRSS fails without it
 			update_request_set_auth_value (request, root->source->authToken);
 
-			(void) update_job_new (root->subscription,
-			                               request,
-			                               google_source_feed_subscription_process_update_result,
-       			                               subscription,
-       			                               flags);
+			job = update_job_new (root->subscription,
+			                      request,
+			                      google_source_feed_subscription_process_update_result,
+			                      chunk,
+			                      flags);
+			job->destroy = google_source_feed_chunk_free;
+			stats->requests++;
 		}
 
+		/* With nothing to fetch no content request will tell */
+		if (!wanted->len)
+			subscription->node->available = TRUE;
+
+		/* Known items might have changed their state remotely */
+		if (skipped)
+			google_source_feed_sync_state (subscription, flags);
+
+		g_ptr_array_free (wanted, TRUE);
 		g_list_free (elements);
-		g_string_free (query, TRUE);
 	} else {
 		subscription->node->available = FALSE;
 	}
@@ -280,11 +755,10 @@ google_source_feed_subscription_prepare_ids_request (subscriptionPtr subscriptio
 		   do not provide a GET endpoint (e.g. Miniflux) */
 		                       
 		// FIXME: move to API fields!
-		// FIXME: do not use hard-coded 50
 		// FIXME: consider passing nt=<epoch> (latest fetch timestamp)
-		url = g_strdup_printf ("%s/reader/api/0/stream/items/ids?s=%s&client=liferea&n=50&output=json&merge=true",
+		url = g_strdup_printf ("%s/reader/api/0/stream/items/ids?s=%s&client=liferea&n=%d&output=json&merge=true",
 		                       root->subscription->origSource,
-		                       sourceEscaped);                       
+		                       sourceEscaped, GOOGLE_SOURCE_FEED_WINDOW);
 
 		update_request_set_source (request, url);
 		update_request_set_auth_value (request, root->source->authToken);
@@ -298,3 +772,25 @@ struct subscriptionType googleSourceFeedSubscriptionType = {
 };
 
 
+
+void
+google_source_feed_to_json (nodeSourcePtr source, gpointer builder)
+{
+	JsonBuilder			*b = JSON_BUILDER (builder);
+	googleSourceFeedStatsPtr	stats = google_source_feed_stats (source);
+
+	json_builder_set_member_name (b, "syncUpdates");
+	json_builder_add_int_value (b, stats->updates);
+	json_builder_set_member_name (b, "syncIdsSeen");
+	json_builder_add_int_value (b, stats->seen);
+	json_builder_set_member_name (b, "syncIdsFetched");
+	json_builder_add_int_value (b, stats->fetched);
+	json_builder_set_member_name (b, "syncIdsSkipped");
+	json_builder_add_int_value (b, stats->skipped);
+	json_builder_set_member_name (b, "syncRequests");
+	json_builder_add_int_value (b, stats->requests);
+	json_builder_set_member_name (b, "syncStateRequests");
+	json_builder_add_int_value (b, stats->stateRequests);
+	json_builder_set_member_name (b, "syncStateChanges");
+	json_builder_add_int_value (b, stats->stateChanges);
+}
@@ -20,98 +20,119 @@
 
 #include "json_api_mapper.h"
 
-#include <string.h>
-
 #include "debug.h"
 #include "item.h"
 #include "metadata.h"
 #include "xml.h"
 
-JsonNode *
-json_api_get_node (JsonNode *parent, const gchar *mapping)
+/* A mapping path like "summary/content" is compiled once per mapping into
+   its location steps, the last step naming the field to extract. Resolving
+   a compiled path then only walks object members without any string work. */
+typedef struct jsonApiPath {
+	gchar		**steps;	/**< location steps, NULL if unmapped */
+	guint		depth;		/**< number of steps before the field */
+} jsonApiPath;
+
+typedef struct jsonApiProgram {
+	jsonApiPath	id;
+	jsonApiPath	title;
+	jsonApiPath	link;
+	jsonApiPath	description;
+	jsonApiPath	updated;
+	jsonApiPath	author;
+	jsonApiPath	read;
+	jsonApiPath	flag;
+} jsonApiProgram;
+
+static void
+json_api_path_compile (jsonApiPath *path, const gchar *mapping)
 {
-	JsonNode	*node = parent;
-	gchar		**step;
-	gchar		**steps = g_strsplit (g_strdup (mapping), "/", 0);
+	path->steps = NULL;
+	path->depth = 0;
 
-	step = steps;
-	if (!*step)
-		return node;
+	if (!mapping || !*mapping)
+		return;
 
-	while (*(step + 1) && node) {
-		node = json_get_node (node, *step);
-		step++;
-	}
+	path->steps = g_strsplit (mapping, "/", 0);
+	path->depth = g_strv_length (path->steps) - 1;
+}
 
-	g_strfreev (steps);
+static void
+json_api_program_compile (jsonApiProgram *program, jsonApiMapping *mapping)
+{
+	json_api_path_compile (&program->id,		mapping->id);
+	json_api_path_compile (&program->title,		mapping->title);
+	json_api_path_compile (&program->link,		mapping->link);
+	json_api_path_compile (&program->description,	mapping->description);
+	json_api_path_compile (&program->updated,	mapping->updated);
+	json_api_path_compile (&program->author,	mapping->author);
+	json_api_path_compile (&program->read,		mapping->read);
+	json_api_path_compile (&program->flag,		mapping->flag);
+}
 
-	return node;
+static void
+json_api_program_free (jsonApiProgram *program)
+{
+	g_strfreev (program->id.steps);
+	g_strfreev (program->title.steps);
+	g_strfreev (program->link.steps);
+	g_strfreev (program->description.steps);
+	g_strfreev (program->updated.steps);
+	g_strfreev (program->author.steps);
+	g_strfreev (program->read.steps);
+	g_strfreev (program->flag.steps);
 }
 
-const gchar *
-json_api_get_string (JsonNode *parent, const gchar *mapping)
+/* Returns the field node a compiled path points to or NULL */
+static JsonNode *
+json_api_path_resolve (JsonNode *node, const jsonApiPath *path)
 {
-	JsonNode	*node;
-	const gchar	*field;
+	guint	i;
 
-	if (!parent || !mapping)
+	if (!path->steps)
 		return NULL;
 
-	node = json_api_get_node (parent, mapping);
-	if (!node)
-		return NULL;
+	for (i = 0; i <= path->depth; i++) {
+		if (!node || !JSON_NODE_HOLDS_OBJECT (node))
+			return NULL;
 
-	field = strrchr (mapping, '/');
-	if (!field)
-		field = mapping;
-	else
-		field++;
+		node = json_object_get_member (json_node_get_object (node), path->steps[i]);
+	}
 
-	return json_get_string (node, field);
+	return node;
 }
 
-gint
-json_api_get_int (JsonNode *parent, const gchar *mapping)
+static const gchar *
+json_api_get_string (JsonNode *parent, const jsonApiPath *path)
 {
-	JsonNode	*node;
-	const gchar	*field;
+	JsonNode *node = json_api_path_resolve (parent, path);
 
-	if (!parent || !mapping)
-		return 0;
+	if (!node)
+		return NULL;
+
+	return json_node_get_string (node);
+}
+
+static gint64
+json_api_get_int (JsonNode *parent, const jsonApiPath *path)
+{
+	JsonNode *node = json_api_path_resolve (parent, path);
 
-	node = json_api_get_node (parent, mapping);
 	if (!node)
 		return 0;
 
-	field = strrchr (mapping, '/');
-	if (!field)
-		field = mapping;
-	else
-		field++;
-
-	return json_get_int (node, field);
+	return json_node_get_int (node);
 }
 
-gboolean
-json_api_get_bool (JsonNode *parent, const gchar *mapping)
+static gboolean
+json_api_get_bool (JsonNode *parent, const jsonApiPath *path)
 {
-	JsonNode	*node;
-	const gchar	*field;
+	JsonNode *node = json_api_path_resolve (parent, path);
 
-	if (!parent || !mapping)
-		return FALSE;
-
-	node = json_api_get_node (parent, mapping);
 	if (!node)
 		return FALSE;
 
-	field = strrchr (mapping, '/');
-	if (!field)
-		field = mapping;
-	else
-		field++;
-
-	return json_get_bool (node, field);
+	return json_node_get_boolean (node);
 }
 
 GList *
@@ -124,21 +145,24 @@ json_api_get_items (const gchar *json, const gchar *root, jsonApiMapping *mappin
 		JsonArray	*array = json_node_get_array (json_get_node (json_parser_get_root (parser), root));
 		GList		*elements = json_array_get_elements (array);
 		GList		*iter = elements;
+		jsonApiProgram	program;
 
 		debug (DEBUG_PARSING, "JSON API: found items root node \"%s\"", root);
-                
+
+		json_api_program_compile (&program, mapping);
+
 		while (iter) {
 			JsonNode *node = (JsonNode *)iter->data;
 			itemPtr item = item_new ();
 
 			/* Parse default feeds */
-			item_set_id	(item, json_api_get_string (node, mapping->id));
-			item_set_title	(item, json_api_get_string (node, mapping->title));
-			item_set_source	(item, json_api_get_string (node, mapping->link));
+			item_set_id	(item, json_api_get_string (node, &program.id));
+			item_set_title	(item, json_api_get_string (node, &program.title));
+			item_set_source	(item, json_api_get_string (node, &program.link));
 
-			item->time       = json_api_get_int (node, mapping->updated);
-			item->readStatus = json_api_get_bool (node, mapping->read);
-			item->flagStatus = json_api_get_bool (node, mapping->flag);
+			item->time       = json_api_get_int (node, &program.updated);
+			item->readStatus = json_api_get_bool (node, &program.read);
+			item->flagStatus = json_api_get_bool (node, &program.flag);
 
 			if (mapping->negateRead)
 				item->readStatus = !item->readStatus;
@@ -147,7 +171,7 @@ json_api_get_items (const gchar *json, const gchar *root, jsonApiMapping *mappin
 			const gchar *content; 
 			gchar *xhtml;
 
-			content = json_api_get_string (node, mapping->description);
+			content = json_api_get_string (node, &program.description);
 			if (mapping->xhtml) {
 				xhtml = xhtml_extract_from_string (content, NULL);
 				item_set_description (item, xhtml);
@@ -157,11 +181,11 @@ json_api_get_items (const gchar *json, const gchar *root, jsonApiMapping *mappin
 			}
 
 			/* Optional meta data */
-			const gchar *tmp = json_api_get_string (node, mapping->author);
+			const gchar *tmp = json_api_get_string (node, &program.author);
 			if (tmp)
 				item->metadata = metadata_list_append (item->metadata, "author", tmp);
 	
-			items = g_list_append (items, (gpointer)item);
+			items = g_list_prepend (items, (gpointer)item);
 
 			/* Allow optional item callback to process stuff */
 			if (callback)
@@ -170,11 +194,13 @@ json_api_get_items (const gchar *json, const gchar *root, jsonApiMapping *mappin
 			iter = g_list_next (iter);
 		}
 
+		json_api_program_free (&program);
 		g_list_free (elements);
-		g_object_unref (parser);
 	} else {
 		debug (DEBUG_PARSING, "Could not parse JSON \"%s\"", json);
 	}
 
-	return items;
+	g_object_unref (parser);
+
+	return g_list_reverse (items);
 }
@@ -37,50 +37,14 @@
 #include "db.h"
 #include "item_state.h"
 
-static itemPtr
-theoldreader_source_load_item_from_sourceid (Node *node, gchar *sourceId, GHashTable *cache)
-{
-	gpointer    ret = g_hash_table_lookup (cache, sourceId);
-	itemSetPtr  itemset;
-	int         num = g_hash_table_size (cache);
-	GList       *iter;
-	itemPtr     item = NULL;
-
-	if (ret)
-		return item_load (GPOINTER_TO_UINT (ret));
-
-	/* skip the top 'num' entries */
-	itemset = node_get_itemset (node);
-	iter = itemset->ids;
-	while (num--) iter = g_list_next (iter);
-
-	for (; iter; iter = g_list_next (iter)) {
-		item = item_load (GPOINTER_TO_UINT (iter->data));
-		if (item) {
-			if (item->sourceId) {
-				/* save to cache */
-				g_hash_table_insert (cache, g_strdup(item->sourceId), (gpointer) item->id);
-				if (g_str_equal (item->sourceId, sourceId)) {
-					itemset_free (itemset);
-					return item;
-				}
-			}
-			item_unload (item);
-		}
-	}
-
-	g_warning ("TheOldReader: Could not find item for %s!", sourceId);
-	itemset_free (itemset);
-	return NULL;
-}
-
 static void
-theoldreader_source_item_retrieve_status (const xmlNodePtr entry, subscriptionPtr subscription, GHashTable *cache)
+theoldreader_source_item_retrieve_status (const xmlNodePtr entry, subscriptionPtr subscription, GHashTable *states)
 {
 	xmlNodePtr      xml;
 	Node		*node = subscription->node;
 	xmlChar         *id = NULL;
 	gboolean        read = FALSE;
+	dbSourceState	*state;
 
 	xml = entry->children;
 	g_assert (xml);
@@ -111,15 +75,17 @@ theoldreader_source_item_retrieve_status (const xmlNodePtr entry, subscriptionPt
 		return;
 	}
 
-	itemPtr item = theoldreader_source_load_item_from_sourceid (node, (gchar *)id, cache);
-	if (item && item->sourceId) {
-		if (g_str_equal (item->sourceId, id) && !google_reader_api_edit_is_in_queue(node->source, (gchar *)id)) {
-			if (item->readStatus != read)
-				item_read_state_changed (item, read);
+	/* Only items whose state really differs are loaded */
+	state = g_hash_table_lookup (states, id);
+	if (!state) {
+		g_warning ("TheOldReader: Could not find item for %s!", id);
+	} else if (state->read != read && !google_reader_api_edit_is_in_queue (node->source, (gchar *)id)) {
+		itemPtr item = item_load (state->itemId);
+		if (item) {
+			item_read_state_changed (item, read);
+			item_unload (item);
 		}
 	}
-	if (item)
-		item_unload (item);
 	xmlFree (id);
 }
 
@@ -151,7 +117,7 @@ theoldreader_feed_subscription_process_update_result (subscriptionPtr subscripti
 	if (doc) {
 		xmlNodePtr root = xmlDocGetRootElement (doc);
 		xmlNodePtr entry = root->children ;
-		g_autoptr(GHashTable) cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+		g_autoptr(GHashTable) states = db_itemset_get_source_states (subscription->node->id);
 
 		while (entry) {
 			if (!g_str_equal (entry->name, "entry")) {
@@ -159,7 +125,7 @@ theoldreader_feed_subscription_process_update_result (subscriptionPtr subscripti
 				continue; /* not an entry */
 			}
 
-			theoldreader_source_item_retrieve_status (entry, subscription, cache);
+			theoldreader_source_item_retrieve_status (entry, subscription, states);
 			entry = entry->next;
 		}
 
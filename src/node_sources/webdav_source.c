@@ -71,6 +71,15 @@
  * dirtyFeeds  maps node-id (gchar*) -> DirtyEntry* (two lazy-upload timers).
  * feedMtimes  maps node-id (gchar*) -> gint64*     (last feed.json upload time).
  * stateMtimes maps node-id (gchar*) -> gint64*     (last state.json upload time).
+ * docStates   maps node-id (gchar*) -> WebDAVDocState* (ETags and upload revisions).
+ * indexEtag   string, ETag of index.json (NULL = unknown)
+ * indexDigest string, SHA1 of the last uploaded index.json
+ *
+ * Uploads are skipped when a document did not change since its last
+ * upload: node.json by node and item set revision and then by content
+ * digest, state.json by comparing the per item state against the state
+ * last uploaded. node.json is always uploaded as a whole, per item
+ * deltas exist for state.json only.
  */
 
 /*  Per-node lazy-upload timers                                         */
@@ -93,6 +102,55 @@ dirty_entry_get_or_create (Node *root, const gchar *node_id)
 	return de;
 }
 
+static void
+webdav_doc_state_free (gpointer data)
+{
+	WebDAVDocState *ds = (WebDAVDocState *)data;
+
+	g_free (ds->feedEtag);
+	g_free (ds->stateEtag);
+	g_free (ds->feedDigest);
+	g_free (ds->feedRevision);
+	if (ds->itemStates)
+		g_hash_table_destroy (ds->itemStates);
+	g_free (ds);
+}
+
+WebDAVDocState *
+webdav_doc_state (Node *root, const gchar *remote_id)
+{
+	GHashTable *docStates = (GHashTable *)g_object_get_data (G_OBJECT (root), "docStates");
+
+	WebDAVDocState *ds = g_hash_table_lookup (docStates, remote_id);
+	if (!ds) {
+		ds = g_new0 (WebDAVDocState, 1);
+		g_hash_table_insert (docStates, g_strdup (remote_id), ds);
+	}
+	return ds;
+}
+
+void
+webdav_json_append_string (GString *out, const gchar *str)
+{
+	g_string_append_c (out, '"');
+	for (const gchar *p = str; p && *p; p++) {
+		switch (*p) {
+			case '"':  g_string_append (out, "\\\""); break;
+			case '\\': g_string_append (out, "\\\\"); break;
+			case '\n': g_string_append (out, "\\n"); break;
+			case '\r': g_string_append (out, "\\r"); break;
+			case '\t': g_string_append (out, "\\t"); break;
+			default:
+				if ((guchar)*p < 0x20)
+					g_string_append_printf (out, "\\u%04x", (guchar)*p);
+				else
+					g_string_append_c (out, *p);
+				break;
+		}
+	}
+	g_string_append_c (out, '"');
+}
+
 const gchar *
 webdav_feed_remote_id (Node *node)
 {
@@ -363,6 +421,10 @@ webdav_source_new (Node *root)
 				g_hash_table_new_full (g_str_hash, g_str_equal,
 	                                               g_free, g_free),
 				(GDestroyNotify)g_hash_table_destroy);
+	g_object_set_data_full (G_OBJECT (root), "docStates",
+				g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                               g_free, webdav_doc_state_free),
+				(GDestroyNotify)g_hash_table_destroy);
 
 	debug (DEBUG_UPDATE, "webdav_source_import: collection URL = %s", collection_url);
 
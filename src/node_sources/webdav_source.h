@@ -48,6 +48,31 @@
 /** Metadata key that stores the stable remote feed id for WebDAV sync. */
 #define WEBDAV_REMOTE_FEED_ID_METADATA "feed-id"
 
+/**
+ * Per-feed sync state of the remote documents, keyed by remote feed id.
+ *
+ * ETags are taken from the last GET or PUT of a document and passed as
+ * If-Match precondition on the next upload, so that concurrent changes
+ * of another client are merged first instead of being overwritten.
+ */
+typedef struct {
+	gchar      *feedEtag;       /**< ETag of node.json (NULL = unknown) */
+	gchar      *stateEtag;      /**< ETag of state.json (NULL = unknown) */
+	gchar      *feedDigest;     /**< SHA1 of the last uploaded node.json */
+	gchar      *feedRevision;   /**< node and item set revision of the last uploaded node.json */
+	GHashTable *itemStates;     /**< sourceId -> state bits last uploaded */
+	gboolean    feedConflict;   /**< node.json upload was rejected, merge first */
+	gboolean    stateConflict;  /**< state.json upload was rejected, merge first */
+} WebDAVDocState;
+
+WebDAVDocState * webdav_doc_state (Node *root, const gchar *remote_id);
+
+/**
+ * Appends a string as quoted and escaped JSON string to a GString.
+ * Used to write the sync documents without building a JSON tree.
+ */
+void webdav_json_append_string (GString *out, const gchar *str);
+
 const gchar *webdav_feed_remote_id (Node *node);
 void webdav_feed_set_remote_id (Node *node, const gchar *remote_id);
 gchar * webdav_feed_json_url (Node *root, const gchar *node_id);
@@ -22,6 +22,7 @@
 
 #include <json-glib/json-glib.h>
 
+#include "db.h"
 #include "debug.h"
 #include "feedlist.h"
 #include "item.h"
@@ -88,7 +89,7 @@ typedef struct {
 	GHashTable *remote_feed_ids;
 } InitialImportUploadCtx;
 
-static void webdav_request_put_index (Node *root, const gchar *json, gpointer callback_data);
+static void webdav_request_put_index (Node *root, const gchar *json, gchar *digest);
 
 static void
 index_entry_free (IndexEntry *e)
@@ -288,8 +289,9 @@ webdav_node_from_feed_json (const gchar *json_str, Node *parent, const gchar *re
 }
 
 typedef struct {
-	JsonBuilder     *builder;
+	GString         *out;
 	Node		*root;
+	gboolean	first;
 } IndexBuildCtx;
 
 static void
@@ -303,17 +305,20 @@ build_index_entry (IndexBuildCtx *ctx, Node *node, const gchar *parent_id)
 	if (!IS_FOLDER (node) && !IS_FEED (node))
 		return;
 
-	json_builder_begin_object (ctx->builder);
-	json_builder_set_member_name (ctx->builder, "type");
-	json_builder_add_string_value (ctx->builder, IS_FOLDER (node) ? "folder" : "feed");
-	json_builder_set_member_name (ctx->builder, "id");
-	json_builder_add_string_value (ctx->builder, IS_FEED (node) ? webdav_feed_remote_id (node) : node->id);
+	if (!ctx->first)
+		g_string_append_c (ctx->out, ',');
+	ctx->first = FALSE;
+
+	g_string_append (ctx->out, "{\"type\":");
+	webdav_json_append_string (ctx->out, IS_FOLDER (node) ? "folder" : "feed");
+	g_string_append (ctx->out, ",\"id\":");
+	webdav_json_append_string (ctx->out, IS_FEED (node) ? webdav_feed_remote_id (node) : node->id);
 	if (parent_id) {
-		json_builder_set_member_name (ctx->builder, "parent");
-		json_builder_add_string_value (ctx->builder, parent_id);
+		g_string_append (ctx->out, ",\"parent\":");
+		webdav_json_append_string (ctx->out, parent_id);
 	}
-	json_builder_set_member_name (ctx->builder, "title");
-	json_builder_add_string_value (ctx->builder, node_get_title (node));
+	g_string_append (ctx->out, ",\"title\":");
+	webdav_json_append_string (ctx->out, node_get_title (node));
 
 	if (IS_FEED (node) && node->subscription) {
 		const gchar *remote_id = webdav_feed_remote_id (node);
@@ -326,15 +331,13 @@ build_index_entry (IndexBuildCtx *ctx, Node *node, const gchar *parent_id)
 		if (sm)
 			state_mtime = *sm;
 
-		json_builder_set_member_name (ctx->builder, "source");
-		json_builder_add_string_value (ctx->builder, subscription_get_source (node->subscription));
+		g_string_append (ctx->out, ",\"source\":");
+		webdav_json_append_string (ctx->out, subscription_get_source (node->subscription));
 		// FIXME: also handle original source
-		json_builder_set_member_name (ctx->builder, "feed_mtime");
-		json_builder_add_int_value (ctx->builder, feed_mtime);
-		json_builder_set_member_name (ctx->builder, "state_mtime");
-		json_builder_add_int_value (ctx->builder, state_mtime);
+		g_string_append_printf (ctx->out, ",\"feed_mtime\":%" G_GINT64_FORMAT ",\"state_mtime\":%" G_GINT64_FORMAT,
+		                        feed_mtime, state_mtime);
 	}
-	json_builder_end_object (ctx->builder);
+	g_string_append_c (ctx->out, '}');
 
 	if (IS_FOLDER (node)) {
 		for (GSList *iter = node->children; iter; iter = g_slist_next (iter))
@@ -347,21 +350,29 @@ webdav_source_feed_list_upload (Node *root)
 {
 	g_assert (root->source->root == root);
 
-	IndexBuildCtx ctx = { json_builder_new (), root };
+	/* Only one index upload at a time, as each one needs the
+	   ETag of the previous one as precondition */
+	if (g_object_get_data (G_OBJECT (root), "indexBusy")) {
+		g_object_set_data (G_OBJECT (root), "indexAgain", GINT_TO_POINTER (TRUE));
+		return;
+	}
+
+	IndexBuildCtx ctx = { g_string_sized_new (1024), root, TRUE };
 
-	json_builder_begin_object (ctx.builder);
-	json_builder_set_member_name (ctx.builder, "nodes");
-	json_builder_begin_array (ctx.builder);
+	g_string_append (ctx.out, "{\"nodes\":[");
 	for (GSList *iter = root->children; iter; iter = g_slist_next (iter))
 		build_index_entry (&ctx, (Node *)iter->data, NULL);
-	json_builder_end_array (ctx.builder);
-	json_builder_end_object (ctx.builder);
+	g_string_append (ctx.out, "]}");
 
-	g_autofree gchar *json = json_dump (ctx.builder);
-	g_object_unref (ctx.builder);
+	gchar *digest = g_compute_checksum_for_string (G_CHECKSUM_SHA1, ctx.out->str, ctx.out->len);
+	if (g_strcmp0 (digest, g_object_get_data (G_OBJECT (root), "indexDigest")) == 0) {
+		debug (DEBUG_UPDATE, "webdav_source_feed_list_upload: index.json unchanged, skipping upload");
+		g_free (digest);
+	} else {
+		webdav_request_put_index (root, ctx.out->str, digest);
+	}
 
-	if (json)
-		webdav_request_put_index (root, json, NULL);
+	g_string_free (ctx.out, TRUE);
 }
 
 static Node *
@@ -564,6 +575,34 @@ webdav_merge_op_complete_one (WebDAVMergeOp *op)
 		webdav_merge_op_finalize (op);
 }
 
+/* Remember the version of a fetched node.json or state.json, so that
+   the next upload is skipped only if it matches the remote document.
+   After a rejected upload the local changes are uploaded again now. */
+static void
+webdav_merge_remember_document (WebDAVMergeOp *op, const gchar *feed_id, Node *node, UpdateResult *result, gboolean state, gboolean stale)
+{
+	WebDAVDocState *ds = webdav_doc_state (op->root, feed_id);
+	const gchar *etag = (result->httpstatus == 200) ? update_state_get_etag (result->updateState) : NULL;
+
+	if (state) {
+		g_free (ds->stateEtag);
+		ds->stateEtag = g_strdup (etag);
+		g_clear_pointer (&ds->itemStates, g_hash_table_destroy);
+		if (node && (ds->stateConflict || stale))
+			webdav_source_mark_items_dirty (node);
+		ds->stateConflict = FALSE;
+	} else {
+		g_free (ds->feedEtag);
+		ds->feedEtag = g_strdup (etag);
+		g_clear_pointer (&ds->feedRevision, g_free);
+		g_free (ds->feedDigest);
+		ds->feedDigest = (result->httpstatus == 200 && result->data) ? g_compute_checksum_for_string (G_CHECKSUM_SHA1, result->data, result->size) : NULL;
+		if (node && ds->feedConflict)
+			webdav_source_mark_feed_dirty (node);
+		ds->feedConflict = FALSE;
+	}
+}
+
 static gboolean
 webdav_async_merge_feed_result (UpdateJob *job)
 {
@@ -577,7 +616,8 @@ webdav_async_merge_feed_result (UpdateJob *job)
 
 	if (result->httpstatus == 200 && result->data && result->size > 0) {
 		Node *target_parent = webdav_merge_op_resolve_parent (op, ctx->parent_id);
-		if (webdav_node_from_feed_json (result->data, target_parent, ctx->feed_id)) {
+		Node *node = webdav_node_from_feed_json (result->data, target_parent, ctx->feed_id);
+		if (node) {
 			gint64 *ts = g_new (gint64, 1);
 			*ts = ctx->remote_mtime;
 			g_hash_table_insert (
@@ -585,10 +625,13 @@ webdav_async_merge_feed_result (UpdateJob *job)
 				g_strdup (ctx->feed_id),
 				ts
 			);
+			webdav_merge_remember_document (op, ctx->feed_id, node, result, FALSE, FALSE);
 		} else {
 			op->any_error = TRUE;
 		}
-	} else if (result->httpstatus != 304 && result->httpstatus != 404) {
+	} else if (result->httpstatus == 404) {
+		webdav_merge_remember_document (op, ctx->feed_id, webdav_find_feed_by_remote_id (op->root, ctx->feed_id), result, FALSE, FALSE);
+	} else if (result->httpstatus != 304) {
 		op->any_error = TRUE;
 	}
 
@@ -617,7 +660,11 @@ webdav_async_merge_state_result (UpdateJob *job)
 			JsonParser *parser;
 			JsonNode *jroot;
 			JsonObject *obj;
-			itemSetPtr itemset;
+			GHashTable *states;
+			GHashTableIter siter;
+			gpointer src_id;
+			dbSourceState *local;
+			gboolean stale = FALSE;
 			GError *err = NULL;
 
 			parser = json_parser_new ();
@@ -625,33 +672,41 @@ webdav_async_merge_state_result (UpdateJob *job)
 				jroot = json_parser_get_root (parser);
 				if (JSON_NODE_HOLDS_OBJECT (jroot)) {
 					obj = json_node_get_object (jroot);
-					itemset = node_get_itemset (node);
-					if (itemset) {
-						for (GList *iter = itemset->ids; iter; iter = g_list_next (iter)) {
-							gulong item_id = GPOINTER_TO_UINT (iter->data);
-							LifereaItem *item = item_load (item_id);
+					/* Only match remote against local state, load
+					   just the items that actually change. When the
+					   remote state lacks some local state the union
+					   is to be uploaded. */
+					states = db_itemset_get_source_states (node->id);
+					g_hash_table_iter_init (&siter, states);
+					while (g_hash_table_iter_next (&siter, &src_id, (gpointer *)&local)) {
+						JsonObject *state = NULL;
+						gboolean read = FALSE, flagged = FALSE;
+
+						if (json_object_has_member (obj, src_id))
+							state = json_object_get_object_member (obj, src_id);
+						if (state) {
+							read = json_object_has_member (state, "read") &&
+							       json_object_get_boolean_member (state, "read");
+							flagged = json_object_has_member (state, "flagged") &&
+							          json_object_get_boolean_member (state, "flagged");
+						}
+
+						if ((local->read && !read) || (local->flagged && !flagged))
+							stale = TRUE;
+
+						if ((read && !local->read) || (flagged && !local->flagged)) {
+							LifereaItem *item = item_load (local->itemId);
 							if (!item)
 								continue;
 
-							const gchar *src_id = item_get_id (item);
-							if (src_id && *src_id && json_object_has_member (obj, src_id)) {
-								JsonObject *state = json_object_get_object_member (obj, src_id);
-								if (state) {
-									if (!item->readStatus &&
-									    json_object_has_member (state, "read") &&
-									    json_object_get_boolean_member (state, "read"))
-										item_set_read_state (item, TRUE);
-
-									if (!item->flagStatus &&
-									    json_object_has_member (state, "flagged") &&
-									    json_object_get_boolean_member (state, "flagged"))
-										item_set_flag_state (item, TRUE);
-								}
-							}
+							if (read && !local->read)
+								item_set_read_state (item, TRUE);
+							if (flagged && !local->flagged)
+								item_set_flag_state (item, TRUE);
 							g_object_unref (item);
 						}
-						itemset_free (itemset);
 					}
+					g_hash_table_destroy (states);
 
 					gint64 *ts = g_new (gint64, 1);
 					*ts = ctx->remote_mtime;
@@ -660,6 +715,7 @@ webdav_async_merge_state_result (UpdateJob *job)
 						g_strdup (ctx->feed_id),
 						ts
 					);
+					webdav_merge_remember_document (op, ctx->feed_id, node, result, TRUE, stale);
 				} else {
 					op->any_error = TRUE;
 				}
@@ -670,7 +726,9 @@ webdav_async_merge_state_result (UpdateJob *job)
 			}
 			g_object_unref (parser);
 		}
-	} else if (result->httpstatus != 304 && result->httpstatus != 404) {
+	} else if (result->httpstatus == 404) {
+		webdav_merge_remember_document (op, ctx->feed_id, webdav_find_feed_by_remote_id (op->root, ctx->feed_id), result, TRUE, FALSE);
+	} else if (result->httpstatus != 304) {
 		op->any_error = TRUE;
 	}
 
@@ -681,21 +739,6 @@ webdav_async_merge_state_result (UpdateJob *job)
 	return TRUE;
 }
 
-static gboolean
-webdav_update_result_wrapper (UpdateJob *job)
-{
-	UpdateResult *result = job->result;
-	gpointer user_data = job->user_data;
-	subscriptionPtr subscription = (subscriptionPtr)user_data;
-	if (!subscription)
-		return TRUE;
-
-	/* Call the subscription's process_update_result callback */
-	subscription->type->process_update_result (subscription, result, job->flags);
-
-	return TRUE;
-}
-
 /**
  * Bootstrap index fetch callback.
  * Parse index and import data then transition to ACTIVE.
@@ -751,19 +794,89 @@ webdav_source_feed_list_update_state_mtime (Node *root, const gchar *remote_id)
 	);
 }
 
+typedef struct {
+	Node	*root;
+	gchar	*digest;
+} IndexUploadCtx;
+
+/* Also run for jobs that were cancelled or never called back, so
+   the busy flag of this upload does not block all later ones */
+static void
+webdav_index_upload_ctx_free (gpointer data)
+{
+	IndexUploadCtx *ctx = (IndexUploadCtx *)data;
+
+	if (ctx->root) {
+		if (g_object_get_data (G_OBJECT (ctx->root), "indexBusy") == ctx)
+			g_object_set_data (G_OBJECT (ctx->root), "indexBusy", NULL);
+		g_object_remove_weak_pointer (G_OBJECT (ctx->root), (gpointer *)&ctx->root);
+	}
+
+	g_free (ctx->digest);
+	g_free (ctx);
+}
+
+static gboolean
+webdav_put_index_result (UpdateJob *job)
+{
+	UpdateResult *result = job->result;
+	IndexUploadCtx *ctx = (IndexUploadCtx *)job->user_data;
+	Node *root = ctx->root;
+
+	if (!root)
+		return TRUE;
+
+	g_object_set_data (G_OBJECT (root), "indexBusy", NULL);
+
+	if (result->httpstatus >= 200 && result->httpstatus < 300) {
+		g_object_set_data_full (G_OBJECT (root), "indexDigest", g_steal_pointer (&ctx->digest), g_free);
+		g_object_set_data_full (G_OBJECT (root), "indexEtag",
+		                        g_strdup (update_state_get_etag (result->updateState)), g_free);
+	} else if (result->httpstatus == 412) {
+		/* Another client changed the feed list, merge it first,
+		   the merge uploads the index again when done */
+		debug (DEBUG_UPDATE, "webdav_put_index_result: index.json changed remotely, merging first");
+		g_object_set_data (G_OBJECT (root), "indexEtag", NULL);
+		g_object_set_data (G_OBJECT (root), "indexDigest", NULL);
+		g_object_set_data (G_OBJECT (root), "indexAgain", NULL);
+		subscription_update (root->subscription, 0);
+		return TRUE;
+	} else {
+		debug (DEBUG_UPDATE, "webdav_put_index_result: upload failed (HTTP %d)", result->httpstatus);
+	}
+
+	if (g_object_get_data (G_OBJECT (root), "indexAgain")) {
+		g_object_set_data (G_OBJECT (root), "indexAgain", NULL);
+		webdav_source_feed_list_upload (root);
+	}
+
+	return TRUE;
+}
+
 static void
-webdav_request_put_index (Node *root, const gchar *json, gpointer callback_data)
+webdav_request_put_index (Node *root, const gchar *json, gchar *digest)
 {
 	UpdateRequest *request;
+	UpdateJob *job;
+	IndexUploadCtx *ctx;
 	g_autofree gchar *url = NULL;
 
 	url = webdav_index_url (root);
 	request = update_request_new ("PUT", url, NULL, NULL);
 	update_request_set_postdata (request, json, "application/json");
+	update_request_set_if_match (request, g_object_get_data (G_OBJECT (root), "indexEtag"));
 	webdav_request_set_basic_auth (request, root);
 
+	ctx = g_new0 (IndexUploadCtx, 1);
+	ctx->root = root;
+	ctx->digest = digest;
+	g_object_add_weak_pointer (G_OBJECT (root), (gpointer *)&ctx->root);
+
+	g_object_set_data (G_OBJECT (root), "indexBusy", ctx);
+
 	debug (DEBUG_UPDATE, "webdav_request_put_index: queued PUT %s (%zu bytes)", url, json ? strlen (json) : 0);
-	(void)update_job_new (root, request, webdav_update_result_wrapper, callback_data, 0);
+	job = update_job_new (root, request, webdav_put_index_result, ctx, 0);
+	job->destroy = webdav_index_upload_ctx_free;
 }
 
 gboolean
@@ -798,6 +911,12 @@ webdav_subscription_process_update_result (subscriptionPtr subscription, const U
 		return;
 	}
 
+	/* precondition for the next index.json upload */
+	g_object_set_data_full (G_OBJECT (subscription->node), "indexEtag",
+	                        g_strdup (update_state_get_etag (result->updateState)), g_free);
+	g_object_set_data_full (G_OBJECT (subscription->node), "indexDigest",
+	                        g_compute_checksum_for_string (G_CHECKSUM_SHA1, result->data, result->size), g_free);
+
 	index = webdav_parse_index_json (result->data);
 	if (!index) {
 		subscription->node->available = FALSE;
@@ -850,7 +969,8 @@ webdav_subscription_process_update_result (subscriptionPtr subscription, const U
 			if (stored)
 				local_mtime = *stored;
 
-			if (e->feed_mtime <= 0 || e->feed_mtime > local_mtime) {
+			if (e->feed_mtime <= 0 || e->feed_mtime > local_mtime ||
+			    webdav_doc_state (op->root, e->node_id)->feedConflict) {
 				WebDAVFeedFetchCtx *feed_ctx = g_new0 (WebDAVFeedFetchCtx, 1);
 				feed_ctx->op = op;
 				feed_ctx->feed_id = g_strdup (e->node_id);
@@ -869,7 +989,8 @@ webdav_subscription_process_update_result (subscriptionPtr subscription, const U
 			if (stored)
 				local_mtime = *stored;
 
-			if (e->state_mtime <= 0 || e->state_mtime > local_mtime) {
+			if (e->state_mtime <= 0 || e->state_mtime > local_mtime ||
+			    webdav_doc_state (op->root, e->node_id)->stateConflict) {
 				WebDAVStateFetchCtx *state_ctx = g_new0 (WebDAVStateFetchCtx, 1);
 				state_ctx->op = op;
 				state_ctx->feed_id = g_strdup (e->node_id);
@@ -20,7 +20,11 @@
 
 #include "webdav_source_flows.h"
 
+#include <string.h>
+
+#include "db.h"
 #include "debug.h"
+#include "subscription.h"
 #include "update.h"
 #include "node_providers/feed.h"
 #include "webdav_source.h"
@@ -41,39 +45,24 @@
  *     "items": [ ...item_to_json() per item... ]
  *   }
  *
- * This replaces the previous per-item file approach.  Items are read once
- * per upload (daily cadence) so the O(n) cost is acceptable.
+ * The serialized node and items are written to the output as they are,
+ * without parsing them into a JSON tree again.
  */
-static gchar *
+static GString *
 webdav_build_feed_json (Node *node)
 {
-	JsonBuilder *b = json_builder_new ();
-	json_builder_begin_object (b);
+	GString *out = g_string_sized_new (4096);
 
-	/* Embed node_to_json() output as a nested "node" object */
-	json_builder_set_member_name (b, "node");
+	g_string_append (out, "{\"node\":");
 	g_autofree gchar *node_json = node_to_json (node);
-	if (node_json) {
-		JsonParser *np  = json_parser_new ();
-		GError     *err = NULL;
-		if (json_parser_load_from_data (np, node_json, -1, &err)) {
-			json_builder_add_value (b, json_node_copy (json_parser_get_root (np)));
-		} else {
-			g_warning ("webdav: node_to_json parse error: %s", err->message);
-			g_error_free (err);
-			json_builder_add_null_value (b);
-		}
-		g_object_unref (np);
-	} else {
-		json_builder_add_null_value (b);
-	}
+	g_string_append (out, node_json ? node_json : "null");
 
-	/* Embed all items as a JSON array */
-	json_builder_set_member_name (b, "items");
-	json_builder_begin_array (b);
+	g_string_append (out, ",\"items\":[");
 
 	itemSetPtr itemset = node_get_itemset (node);
 	if (itemset) {
+		gboolean first = TRUE;
+
 		for (GList *iter = itemset->ids; iter; iter = g_list_next (iter)) {
 			gulong       item_id  = GPOINTER_TO_UINT (iter->data);
 			LifereaItem *item     = item_load (item_id);
@@ -82,75 +71,130 @@ webdav_build_feed_json (Node *node)
 
 			g_autofree gchar *item_json = item_to_json (item);
 			if (item_json) {
-				JsonParser *ip  = json_parser_new ();
-				GError     *err = NULL;
-				if (json_parser_load_from_data (ip, item_json, -1, &err)) {
-					json_builder_add_value (b, json_node_copy (json_parser_get_root (ip)));
-				} else {
-					g_warning ("webdav: item_to_json parse error: %s", err->message);
-					g_error_free (err);
-				}
-				g_object_unref (ip);
+				if (!first)
+					g_string_append_c (out, ',');
+				g_string_append (out, item_json);
+				first = FALSE;
 			}
 			g_object_unref (item);
 		}
 		itemset_free (itemset);
 	}
 
-	json_builder_end_array (b);
-	json_builder_end_object (b);
+	g_string_append (out, "]}");
+	return out;
+}
+
+/**
+ * Build a marker that changes whenever the node.json of a node would
+ * change, without loading any item.
+ */
+static gchar *
+webdav_feed_revision (Node *node)
+{
+	g_autofree gchar *node_json = node_to_json (node);
+	g_autofree gchar *items = db_itemset_get_revision (node->id);
+	g_autofree gchar *digest = g_compute_checksum_for_string (G_CHECKSUM_SHA1, node_json ? node_json : "null", -1);
 
-	gchar *result = json_dump (b);
-	g_object_unref (b);
-	return result;
+	return g_strdup_printf ("%s/%s", digest, items ? items : "");
 }
 
 /* ------------------------------------------------------------------ */
 /*  Build state.json (compact read/flagged state for all items)         */
 /* ------------------------------------------------------------------ */
 
+#define WEBDAV_ITEM_STATE_KNOWN		(1<<0)
+#define WEBDAV_ITEM_STATE_READ		(1<<1)
+#define WEBDAV_ITEM_STATE_FLAGGED	(1<<2)
+
+/**
+ * Collect the current per item state of a node from the DB without
+ * loading any item.
+ *
+ * Returns: sourceId -> state bits, to be free'd with g_hash_table_destroy()
+ */
+static GHashTable *
+webdav_collect_item_states (Node *node)
+{
+	GHashTable	*states = db_itemset_get_source_states (node->id);
+	GHashTable	*bits = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	GHashTableIter	iter;
+	gpointer	src_id;
+	dbSourceState	*state;
+
+	g_hash_table_iter_init (&iter, states);
+	while (g_hash_table_iter_next (&iter, &src_id, (gpointer *)&state)) {
+		if (!*(gchar *)src_id)
+			continue;
+
+		g_hash_table_insert (bits, g_strdup (src_id), GUINT_TO_POINTER (
+			WEBDAV_ITEM_STATE_KNOWN |
+			(state->read ? WEBDAV_ITEM_STATE_READ : 0) |
+			(state->flagged ? WEBDAV_ITEM_STATE_FLAGGED : 0)));
+	}
+	g_hash_table_destroy (states);
+
+	return bits;
+}
+
+/**
+ * Count the items whose state differs from the state last uploaded.
+ */
+static guint
+webdav_count_changed_item_states (GHashTable *current, GHashTable *uploaded)
+{
+	GHashTableIter	iter;
+	gpointer	src_id, bits, old;
+	guint		changed = 0, kept = 0;
+
+	/* never uploaded: all changed, even for an empty state */
+	if (!uploaded)
+		return g_hash_table_size (current) + 1;
+
+	g_hash_table_iter_init (&iter, current);
+	while (g_hash_table_iter_next (&iter, &src_id, &bits)) {
+		old = g_hash_table_lookup (uploaded, src_id);
+		if (old)
+			kept++;
+		if (old != bits)
+			changed++;
+	}
+
+	/* plus the items removed since the last upload */
+	return changed + g_hash_table_size (uploaded) - kept;
+}
+
 /**
  * Build a JSON string mapping each item's sourceId to its read/flagged state.
  *
  * Format:
  *   { "<sourceId>": { "read": true, "flagged": false }, ... }
  *
- * This file is written on every item-state change (O(n) items, small output).
+ * Items are written sorted by sourceId, so the same state always
+ * results in the same document.
  * Merge strategy on import is union: a bit can only be set, never cleared.
  */
-static gchar *
-webdav_build_state_json (Node *node)
+static GString *
+webdav_build_state_json (GHashTable *states)
 {
-	JsonBuilder *b = json_builder_new ();
-	json_builder_begin_object (b);
-
-	itemSetPtr itemset = node_get_itemset (node);
-	if (itemset) {
-		for (GList *iter = itemset->ids; iter; iter = g_list_next (iter)) {
-			gulong       item_id = GPOINTER_TO_UINT (iter->data);
-			LifereaItem *item    = item_load (item_id);
-			if (!item)
-				continue;
-
-			const gchar *src_id = item_get_id (item);
-			if (src_id && *src_id) {
-				json_builder_set_member_name (b, src_id);
-				json_builder_begin_object (b);
-				json_builder_set_member_name (b, "read");
-				json_builder_add_boolean_value (b, item->readStatus);
-				json_builder_set_member_name (b, "flagged");
-				json_builder_add_boolean_value (b, item->flagStatus);
-				json_builder_end_object (b);
-			}
-			g_object_unref (item);
-		}
-		itemset_free (itemset);
+	GString *out = g_string_sized_new (64 * g_hash_table_size (states) + 2);
+	GList   *keys = g_list_sort (g_hash_table_get_keys (states), (GCompareFunc)strcmp);
+
+	g_string_append_c (out, '{');
+	for (GList *iter = keys; iter; iter = g_list_next (iter)) {
+		guint bits = GPOINTER_TO_UINT (g_hash_table_lookup (states, iter->data));
+
+		if (iter != keys)
+			g_string_append_c (out, ',');
+		webdav_json_append_string (out, (const gchar *)iter->data);
+		g_string_append_printf (out, ":{\"read\":%s,\"flagged\":%s}",
+		                        (bits & WEBDAV_ITEM_STATE_READ) ? "true" : "false",
+		                        (bits & WEBDAV_ITEM_STATE_FLAGGED) ? "true" : "false");
 	}
+	g_string_append_c (out, '}');
 
-	json_builder_end_object (b);
-	gchar *result = json_dump (b);
-	g_object_unref (b);
-	return result;
+	g_list_free (keys);
+	return out;
 }
 
 /* feed upload flow */
@@ -170,20 +214,126 @@ typedef struct {
         gboolean feed_dirty;
         gboolean state_dirty;
         StepUploadFeed step;
+        gchar *feed_digest;             /* digest of the node.json being uploaded */
+        gchar *feed_revision;           /* revision of the node.json being uploaded */
+        GHashTable *item_states;        /* item states of the state.json being uploaded */
 } FlowUploadFeed;
 
+/* An upload was rejected because another client changed the document
+   since we last saw it. Trigger a merge of the remote changes, the
+   merge will upload the local changes again afterwards. */
+static void
+webdav_source_flow_upload_conflict (FlowUploadFeed *flow, gboolean state)
+{
+        WebDAVDocState *ds = webdav_doc_state (flow->root, flow->remote_id);
+
+        debug (DEBUG_UPDATE, "webdav_source_flow_upload_feed: %s of '%s' changed remotely, merging first", state?"state.json":"node.json", flow->node_id);
+
+        /* forget what we uploaded, as the remote document is different now */
+        if (state) {
+                g_clear_pointer (&ds->stateEtag, g_free);
+                g_clear_pointer (&ds->itemStates, g_hash_table_destroy);
+                ds->stateConflict = TRUE;
+        } else {
+                g_clear_pointer (&ds->feedEtag, g_free);
+                g_clear_pointer (&ds->feedDigest, g_free);
+                g_clear_pointer (&ds->feedRevision, g_free);
+                ds->feedConflict = TRUE;
+        }
+
+        subscription_update (flow->root->subscription, 0);
+}
+
+/* Prepares the PUT of node.json, returns FALSE if it did not change */
+static gboolean
+webdav_source_flow_prepare_put_node (FlowUploadFeed *flow, UpdateJob *job, Node *node)
+{
+        WebDAVDocState *ds = webdav_doc_state (flow->root, flow->remote_id);
+        g_autoptr(GString) json = NULL;
+        g_autofree gchar *url = NULL;
+
+        flow->feed_dirty = FALSE;
+
+        /* Nothing changed since the last upload: skip serializing the items */
+        g_free (flow->feed_revision);
+        flow->feed_revision = webdav_feed_revision (node);
+        if (ds->feedDigest && g_strcmp0 (flow->feed_revision, ds->feedRevision) == 0) {
+                debug (DEBUG_UPDATE, "webdav_source_flow_upload_feed: node.json of '%s' not modified, skipping upload", flow->node_id);
+                node->syncState &= ~NODE_SYNC_STATE_DIRTY_FEED;
+                node->syncState &= ~NODE_SYNC_STATE_INITIAL_IMPORT;
+                return FALSE;
+        }
+
+        json = webdav_build_feed_json (node);
+        g_free (flow->feed_digest);
+        flow->feed_digest = g_compute_checksum_for_string (G_CHECKSUM_SHA1, json->str, json->len);
+        if (g_strcmp0 (flow->feed_digest, ds->feedDigest) == 0) {
+                debug (DEBUG_UPDATE, "webdav_source_flow_upload_feed: node.json of '%s' unchanged, skipping upload", flow->node_id);
+                g_free (ds->feedRevision);
+                ds->feedRevision = g_steal_pointer (&flow->feed_revision);
+                node->syncState &= ~NODE_SYNC_STATE_DIRTY_FEED;
+                node->syncState &= ~NODE_SYNC_STATE_INITIAL_IMPORT;
+                return FALSE;
+        }
+
+        url = webdav_feed_json_url (flow->root, flow->remote_id);
+        update_request_set_method (job->request, "PUT");
+        update_request_set_source (job->request, url);
+        update_request_set_postdata (job->request, json->str, "application/json");
+        update_request_set_if_match (job->request, ds->feedEtag);
+
+        debug (DEBUG_UPDATE, "webdav_source_flow_upload_feed: PUT node.json of '%s' (%" G_GSIZE_FORMAT " bytes)", flow->node_id, json->len);
+        return TRUE;
+}
+
+/* Prepares the PUT of state.json, returns FALSE if no item state changed */
+static gboolean
+webdav_source_flow_prepare_put_state (FlowUploadFeed *flow, UpdateJob *job, Node *node)
+{
+        WebDAVDocState *ds = webdav_doc_state (flow->root, flow->remote_id);
+        g_autoptr(GString) json = NULL;
+        g_autofree gchar *url = NULL;
+        guint changed;
+
+        flow->state_dirty = FALSE;
+
+        if (flow->item_states)
+                g_hash_table_destroy (flow->item_states);
+        flow->item_states = webdav_collect_item_states (node);
+
+        changed = webdav_count_changed_item_states (flow->item_states, ds->itemStates);
+        if (!changed) {
+                debug (DEBUG_UPDATE, "webdav_source_flow_upload_feed: state of '%s' unchanged, skipping upload", flow->node_id);
+                node->syncState &= ~NODE_SYNC_STATE_DIRTY_ITEMS;
+                return FALSE;
+        }
+
+        json = webdav_build_state_json (flow->item_states);
+        url = webdav_state_json_url (flow->root, flow->remote_id);
+        update_request_set_method (job->request, "PUT");
+        update_request_set_source (job->request, url);
+        update_request_set_postdata (job->request, json->str, "application/json");
+        update_request_set_if_match (job->request, ds->stateEtag);
+
+        debug (DEBUG_UPDATE, "webdav_source_flow_upload_feed: PUT state.json of '%s' (%u changed items, %" G_GSIZE_FORMAT " bytes)", flow->node_id, changed, json->len);
+        return TRUE;
+}
+
 static gboolean
 webdav_source_flow_upload_feed_step (UpdateJob *job)
 {
         UpdateResult    *result = job->result;
         FlowUploadFeed  *flow = (FlowUploadFeed *) job->user_data;
         Node            *node = node_from_id (flow->node_id);
+        WebDAVDocState  *ds;
 
 	debug (DEBUG_UPDATE, "webdav_source_flow_upload_feed: step=%d feed=%d state=%d for node '%s' (%s)", flow->step, flow->feed_dirty, flow->state_dirty, flow->node_id, node?node->title:"NULL");
 
         if (!node)
                 return TRUE;
 
+        ds = webdav_doc_state (flow->root, flow->remote_id);
+
         /* result processing */
         if (result && result->httpstatus == 401) {
                 node_source_set_auth_failed (flow->root, job->flags & UPDATE_REQUEST_PRIORITY_HIGH);
@@ -201,6 +351,13 @@ webdav_source_flow_upload_feed_step (UpdateJob *job)
                                 return TRUE;
                         }
                         break;
+                case UPLOAD_FEED_PUT_NODE:
+                case UPLOAD_FEED_PUT_STATE:
+                        if (result->httpstatus == 412) {
+                                webdav_source_flow_upload_conflict (flow, flow->step == UPLOAD_FEED_PUT_STATE);
+                                break;
+                        }
+                        /* fall through */
                 default:
                         if (!(result->httpstatus >= 200 && result->httpstatus < 400)) {
                                 // FIXME: provide better error for user
@@ -208,71 +365,59 @@ webdav_source_flow_upload_feed_step (UpdateJob *job)
                                 flow->root->subscription->error = FETCH_ERROR_NET;
                                 return TRUE;
                         }
-                        break;
-        }
-        
-        /* state machine */
-        switch (flow->step) {
-                case UPLOAD_FEED_START:
-                        /* Initially there is no result, skip to next step */
-                        flow->step = UPLOAD_FEED_MKCOL;
-                        break;
-                default:
-                        if (flow->feed_dirty)
-                                flow->step = UPLOAD_FEED_PUT_NODE;
-                        else if (flow->state_dirty)
-                                flow->step = UPLOAD_FEED_PUT_STATE;
-                        else
-                                flow->step = UPLOAD_FEED_FINISH;
-                        break;
-        }
 
-        /* request preparation */
-        switch (flow->step) {
-                case UPLOAD_FEED_START:
-                case UPLOAD_FEED_MKCOL: {
-                        g_autofree gchar *url = webdav_feed_dir_url (flow->root, flow->remote_id);
-
-                        g_assert (!job->request);
-                        job->request = update_request_new ("MKCOL", url, NULL, NULL);
-                        webdav_request_set_basic_auth (job->request, flow->root);
+                        /* Remember what was uploaded. Without an ETag in the
+                           response the next upload will be unconditional. */
+                        if (flow->step == UPLOAD_FEED_PUT_NODE) {
+                                g_free (ds->feedEtag);
+                                ds->feedEtag = g_strdup (update_state_get_etag (result->updateState));
+                                g_free (ds->feedDigest);
+                                ds->feedDigest = g_steal_pointer (&flow->feed_digest);
+                                g_free (ds->feedRevision);
+                                ds->feedRevision = g_steal_pointer (&flow->feed_revision);
+
+                                node->syncState &= ~NODE_SYNC_STATE_DIRTY_FEED;
+                                node->syncState &= ~NODE_SYNC_STATE_INITIAL_IMPORT;
+                                webdav_source_feed_list_update_feed_mtime (flow->root, flow->remote_id);
+                        } else if (flow->step == UPLOAD_FEED_PUT_STATE) {
+                                g_free (ds->stateEtag);
+                                ds->stateEtag = g_strdup (update_state_get_etag (result->updateState));
+                                if (ds->itemStates)
+                                        g_hash_table_destroy (ds->itemStates);
+                                ds->itemStates = g_steal_pointer (&flow->item_states);
+
+                                node->syncState &= ~NODE_SYNC_STATE_DIRTY_ITEMS;
+                                webdav_source_feed_list_update_state_mtime (flow->root, flow->remote_id);
+                        }
                         break;
-                }
-                case UPLOAD_FEED_PUT_NODE: {
-                        g_autofree gchar *json = webdav_build_feed_json (node);
-	                g_autofree gchar *url = webdav_feed_json_url (flow->root, flow->remote_id);
+        }
 
-                        update_request_set_method (job->request, "PUT");
-                        update_request_set_source (job->request, url);
-        	        update_request_set_postdata (job->request, json, "application/json");
-                        
-                        flow->feed_dirty = FALSE;
-                        // FIXME: only do this on success
-                        node->syncState &= ~NODE_SYNC_STATE_DIRTY_FEED;
-                        node->syncState &= ~NODE_SYNC_STATE_INITIAL_IMPORT;
-
-                        webdav_source_feed_list_update_feed_mtime (flow->root, flow->remote_id);
-                        break;
-                }
-                case UPLOAD_FEED_PUT_STATE: {
-                        g_autofree gchar *json = webdav_build_state_json (node);
-	                g_autofree gchar *url = webdav_state_json_url (flow->root, flow->remote_id);
+        /* state machine and request preparation */
+        if (flow->step == UPLOAD_FEED_START) {
+                /* Initially there is no result, skip to next step */
+                g_autofree gchar *url = webdav_feed_dir_url (flow->root, flow->remote_id);
 
-                        update_request_set_method (job->request, "PUT");
-                        update_request_set_source (job->request, url);
-        	        update_request_set_postdata (job->request, json, "application/json");
-                        
-                        flow->state_dirty = FALSE;
-                        // FIXME: only do this on success
-                        node->syncState &= ~NODE_SYNC_STATE_DIRTY_ITEMS;
+                flow->step = UPLOAD_FEED_MKCOL;
+                g_assert (!job->request);
+                job->request = update_request_new ("MKCOL", url, NULL, NULL);
+                webdav_request_set_basic_auth (job->request, flow->root);
+                return FALSE;
+        }
 
-                        webdav_source_feed_list_update_state_mtime (flow->root, flow->remote_id);
-                        break;
-                }
-                case UPLOAD_FEED_FINISH: {
+        /* documents that did not change since their last upload are skipped */
+        while (TRUE) {
+                if (flow->feed_dirty) {
+                        flow->step = UPLOAD_FEED_PUT_NODE;
+                        if (webdav_source_flow_prepare_put_node (flow, job, node))
+                                break;
+                } else if (flow->state_dirty) {
+                        flow->step = UPLOAD_FEED_PUT_STATE;
+                        if (webdav_source_flow_prepare_put_state (flow, job, node))
+                                break;
+                } else {
+                        flow->step = UPLOAD_FEED_FINISH;
                         webdav_source_feed_list_upload (flow->root);
                         return TRUE;
-                        break;
                 }
         }
 
@@ -284,6 +429,10 @@ webdav_source_flow_upload_feed_free (gpointer data)
 {
         FlowUploadFeed *flow = (FlowUploadFeed *)data;
 
+        if (flow->item_states)
+                g_hash_table_destroy (flow->item_states);
+        g_free (flow->feed_digest);
+        g_free (flow->feed_revision);
         g_free (flow->node_id);
         g_free (flow->remote_id);
         g_free (flow);
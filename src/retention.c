@@ -0,0 +1,233 @@
+/**
+ * @file retention.c  age and count based item retention
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "retention.h"
+
+#include <json-glib/json-glib.h>
+
+#include "conf.h"
+#include "db.h"
+#include "debug.h"
+#include "feedlist.h"
+#include "itemlist.h"
+#include "node_provider.h"
+#include "subscription.h"
+
+/* The cache limit of a subscription is only applied when merging
+   downloaded items, so feeds that stopped updating keep their items
+   forever. Retention applies the cache limit and maximum ages for
+   read and unread items in low priority timeouts instead.
+
+   The ages are defined per node in the feed list (retainUnread and
+   retainRead, see export.c). Nodes without a setting inherit it from
+   their folders and finally from the preferences. Flagged items and
+   the selected item are never removed.
+
+   Each round checks all subscriptions once, each slice removes
+   batches of items until its time budget is used up. */
+
+#define RETENTION_START_DELAY	120		/* seconds after startup */
+#define RETENTION_PAUSE		500		/* ms between slices */
+#define RETENTION_BUDGET	(20 * 1000)	/* µs per slice */
+#define RETENTION_BATCH		200		/* items removed per statement */
+#define RETENTION_INTERVAL	(60 * 60)	/* seconds between rounds */
+#define ONE_DAY			(24 * 60 * 60)
+
+static struct {
+	GQueue		*nodes;		/* ids of the subscriptions still to check */
+	guint		total;		/* subscriptions of the current round */
+	guint		timer;
+	retentionStats	stats;
+} retention;
+
+static gint
+retention_get_default (const gchar *key)
+{
+	gint	days = 0;
+
+	conf_get_int_value (key, &days);
+
+	return MAX (0, days);
+}
+
+void
+retention_get_policy (Node *node, gint *unreadDays, gint *readDays)
+{
+	Node	*iter;
+
+	*unreadDays = 0;
+	for (iter = node; iter && !*unreadDays; iter = iter->parent)
+		*unreadDays = iter->retainUnread;
+	if (!*unreadDays)
+		*unreadDays = retention_get_default (DEFAULT_RETAIN_UNREAD);
+
+	*readDays = 0;
+	for (iter = node; iter && !*readDays; iter = iter->parent)
+		*readDays = iter->retainRead;
+	if (!*readDays)
+		*readDays = retention_get_default (DEFAULT_RETAIN_READ);
+
+	/* -1 stops the inheritance, but means no limit too */
+	*unreadDays = MAX (0, *unreadDays);
+	*readDays = MAX (0, *readDays);
+}
+
+void
+retention_get_expiry (Node *node, gint64 *unreadBefore, gint64 *readBefore)
+{
+	gint64	now = g_get_real_time () / G_USEC_PER_SEC;
+	gint	unreadDays, readDays;
+
+	retention_get_policy (node, &unreadDays, &readDays);
+
+	*unreadBefore = unreadDays?(now - (gint64)unreadDays * ONE_DAY):0;
+	*readBefore = readDays?(now - (gint64)readDays * ONE_DAY):0;
+}
+
+/* Removes the next batch of items of a node. Returns TRUE if there might be more. */
+static gboolean
+retention_apply (Node *node)
+{
+	gint64	unreadBefore, readBefore;
+	guint	removed, max, count;
+
+	retention_get_expiry (node, &unreadBefore, &readBefore);
+
+	if (unreadBefore || readBefore) {
+		removed = itemlist_expire_items (node->id, unreadBefore, readBefore,
+		                                 RETENTION_BATCH, &retention.stats.bytes);
+		retention.stats.expired += removed;
+		if (removed == RETENTION_BATCH)
+			return TRUE;
+	}
+
+	max = subscription_get_max_item_count (node->subscription);
+	count = db_itemset_get_item_count (node->id);
+	if (count > max) {
+		removed = itemlist_prune_items (node->id, MIN (count - max, RETENTION_BATCH), &retention.stats.bytes);
+		retention.stats.pruned += removed;
+		if (removed == RETENTION_BATCH)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+retention_collect (Node *node)
+{
+	if (IS_FEED (node) && node->subscription)
+		g_queue_push_tail (retention.nodes, g_strdup (node->id));
+}
+
+static gboolean retention_start_round (gpointer user_data);
+
+static gboolean
+retention_slice (gpointer user_data)
+{
+	gint64	start = g_get_monotonic_time ();
+
+	while (!g_queue_is_empty (retention.nodes) &&
+	       g_get_monotonic_time () - start < RETENTION_BUDGET) {
+		gchar	*id = g_queue_peek_head (retention.nodes);
+		Node	*node = node_from_id (id);
+
+		if (!node || !retention_apply (node)) {
+			g_free (g_queue_pop_head (retention.nodes));
+			retention.stats.nodes++;
+		}
+	}
+
+	retention.stats.time += g_get_monotonic_time () - start;
+
+	if (!g_queue_is_empty (retention.nodes))
+		return G_SOURCE_CONTINUE;
+
+	retention.stats.rounds++;
+	debug (DEBUG_DB, "retention: round finished, %u items expired, %u pruned (%" G_GUINT64_FORMAT " bytes) in %.1fms",
+	       retention.stats.expired, retention.stats.pruned, retention.stats.bytes, retention.stats.time / 1000.0);
+
+	retention.timer = g_timeout_add_seconds_full (G_PRIORITY_LOW, RETENTION_INTERVAL, retention_start_round, NULL, NULL);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+retention_start_round (gpointer user_data)
+{
+	feedlist_recurse (retention_collect);
+	retention.total = g_queue_get_length (retention.nodes);
+
+	debug (DEBUG_DB, "retention: checking %u subscriptions", retention.total);
+
+	retention.timer = g_timeout_add_full (G_PRIORITY_LOW, RETENTION_PAUSE, retention_slice, NULL, NULL);
+
+	return G_SOURCE_REMOVE;
+}
+
+void
+retention_init (void)
+{
+	retention.nodes = g_queue_new ();
+	retention.timer = g_timeout_add_seconds_full (G_PRIORITY_LOW, RETENTION_START_DELAY, retention_start_round, NULL, NULL);
+}
+
+void
+retention_deinit (void)
+{
+	if (retention.timer) {
+		g_source_remove (retention.timer);
+		retention.timer = 0;
+	}
+
+	if (retention.nodes) {
+		g_queue_free_full (retention.nodes, g_free);
+		retention.nodes = NULL;
+	}
+}
+
+void
+retention_to_json (gpointer builder)
+{
+	JsonBuilder	*b = JSON_BUILDER (builder);
+	guint		pending = retention.nodes?g_queue_get_length (retention.nodes):0;
+
+	json_builder_set_member_name (b, "retention");
+	json_builder_begin_object (b);
+	json_builder_set_member_name (b, "unreadDays");
+	json_builder_add_int_value (b, retention_get_default (DEFAULT_RETAIN_UNREAD));
+	json_builder_set_member_name (b, "readDays");
+	json_builder_add_int_value (b, retention_get_default (DEFAULT_RETAIN_READ));
+	json_builder_set_member_name (b, "progress");
+	json_builder_add_int_value (b, (pending && retention.total)?(100 * (retention.total - pending) / retention.total):100);
+	json_builder_set_member_name (b, "rounds");
+	json_builder_add_int_value (b, retention.stats.rounds);
+	json_builder_set_member_name (b, "nodes");
+	json_builder_add_int_value (b, retention.stats.nodes);
+	json_builder_set_member_name (b, "expired");
+	json_builder_add_int_value (b, retention.stats.expired);
+	json_builder_set_member_name (b, "pruned");
+	json_builder_add_int_value (b, retention.stats.pruned);
+	json_builder_set_member_name (b, "bytes");
+	json_builder_add_int_value (b, retention.stats.bytes);
+	json_builder_set_member_name (b, "time");
+	json_builder_add_int_value (b, retention.stats.time / 1000);
+	json_builder_end_object (b);
+}
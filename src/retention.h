@@ -0,0 +1,83 @@
+/**
+ * @file retention.h  age and count based item retention
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _RETENTION_H
+#define _RETENTION_H
+
+#include <glib.h>
+
+#include "node.h"
+
+typedef struct retentionStats {
+	guint	rounds;		/*<< rounds over all subscriptions finished */
+	guint	nodes;		/*<< subscriptions checked */
+	guint	expired;	/*<< items removed for their age */
+	guint	pruned;		/*<< items removed for the cache limit */
+	guint64	bytes;		/*<< approximate size of the removed items */
+	gint64	time;		/*<< total time spent [µs] */
+} retentionStats;
+
+/**
+ * retention_get_policy: (skip)
+ * @node:		the node
+ * @unreadDays:		(out): max. age of unread items, 0 for no limit
+ * @readDays:		(out): max. age of read items, 0 for no limit
+ *
+ * Determines the effective retention of a node. Unset values
+ * are inherited from the parent folders and finally from the
+ * global preferences.
+ */
+void retention_get_policy (Node *node, gint *unreadDays, gint *readDays);
+
+/**
+ * retention_get_expiry: (skip)
+ * @node:		the node
+ * @unreadBefore:	(out): unread items dated before are expired, 0 for none
+ * @readBefore:		(out): read items dated before are expired, 0 for none
+ *
+ * Converts the effective retention of a node into item dates
+ * [s since epoch].
+ */
+void retention_get_expiry (Node *node, gint64 *unreadBefore, gint64 *readBefore);
+
+/**
+ * retention_init: (skip)
+ *
+ * Starts applying the retention policies in idle time.
+ * To be called once the feed list is loaded.
+ */
+void retention_init (void);
+
+/**
+ * retention_deinit: (skip)
+ *
+ * Stops applying the retention policies.
+ */
+void retention_deinit (void);
+
+/**
+ * retention_to_json: (skip)
+ * @b:		a JsonBuilder to append to
+ *
+ * Adds a "retention" member with progress and statistics.
+ */
+void retention_to_json (gpointer b);
+
+#endif
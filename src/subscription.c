@@ -28,12 +28,14 @@
 #include "conf.h"
 #include "db.h"
 #include "debug.h"
+#include "enrichment.h"
 #include "feedlist.h"
 #include "itemlist.h"
 #include "metadata.h"
 #include "node_source.h"
 #include "net.h"
 #include "subscription_icon.h"
+#include "update_ramp.h"
 #include "xml.h"
 #include "ui/auth_dialog.h"
 #include "ui/liferea_shell.h"
@@ -251,6 +253,8 @@ subscription_process_update_result (UpdateJob *job)
 
 	debug (DEBUG_UPDATE, "subscription: |%s| process update result (HTTP status %d)", subscription->source, result->httpstatus);
 
+	feedlist_node_update_started (node);
+
 	/* 1. preprocessing */
 
 	g_assert (subscription->updateJob);
@@ -318,6 +322,8 @@ subscription_process_update_result (UpdateJob *job)
 		feedlist_node_was_updated (node);
 	}
 
+	feedlist_node_update_finished (node);
+
 	return TRUE;
 }
 
@@ -378,6 +384,12 @@ subscription_auto_update (subscriptionPtr subscription, updateFlags flags)
 		return;
 	}
 
+	/* Updates waiting in the startup or import ramp are started by the ramp */
+	if (subscription->node && update_ramp_is_pending (subscription->node)) {
+		debug (DEBUG_UPDATE, "subscription: |%s| skipping update: waiting in update ramp", subscription->source);
+		return;
+	}
+
 	now = g_get_real_time();
 
 	if (subscription->updateState->lastPoll + (guint64)interval * (guint64)(60 * G_USEC_PER_SEC) <= now) {
@@ -415,7 +427,7 @@ subscription_set_update_interval (subscriptionPtr subscription, gint interval)
 				   interval... */
 	}
 	subscription->updateInterval = interval;
-	feedlist_schedule_save ();
+	feedlist_schedule_save_node (subscription->node);
 }
 
 guint
@@ -465,7 +477,7 @@ subscription_set_orig_source (subscriptionPtr subscription, const gchar *source)
 {
 	g_free (subscription->origSource);
 	subscription->origSource = g_strchomp (g_strdup (source));
-	feedlist_schedule_save ();
+	feedlist_schedule_save_node (subscription->node);
 }
 
 void
@@ -473,7 +485,7 @@ subscription_set_source (subscriptionPtr subscription, const gchar *source)
 {
 	g_free (subscription->source);
 	subscription->source = g_strchomp (g_strdup (source));
-	feedlist_schedule_save ();
+	feedlist_schedule_save_node (subscription->node);
 
 	update_state_set_cookies (subscription->updateState, NULL);
 
@@ -503,7 +515,11 @@ subscription_set_homepage (subscriptionPtr subscription, const gchar *newHtmlUrl
 			g_free (source);
 		}
 
-		metadata_list_set (&subscription->metadata, "homepage", htmlUrl);
+		/* The homepage is exported as "htmlUrl" */
+		if (g_strcmp0 (htmlUrl, subscription_get_homepage (subscription))) {
+			metadata_list_set (&subscription->metadata, "homepage", htmlUrl);
+			feedlist_schedule_save_node (subscription->node);
+		}
 		g_free (htmlUrl);
 	}
 }
@@ -513,7 +529,7 @@ subscription_set_filter (subscriptionPtr subscription, const gchar *filter)
 {
 	g_free (subscription->filtercmd);
 	subscription->filtercmd = g_strdup (filter);
-	feedlist_schedule_save ();
+	feedlist_schedule_save_node (subscription->node);
 }
 
 void
@@ -682,97 +698,10 @@ subscription_export (subscriptionPtr subscription, xmlNodePtr xml, gboolean trus
 
 // content scraping
 
-static gboolean
-subscription_html5_enrich_item_cb (UpdateJob *job)
-{
-	UpdateResult *result = job->result;
-	gpointer userdata = job->user_data;
-	itemPtr item;
-	gchar	*article;
-
-	if (!result->data || result->httpstatus >= 400)
-		return TRUE;
-
-	item = item_load (GPOINTER_TO_UINT (userdata));
-	if (!item)
-		return TRUE;
-
-	article = xhtml_extract_from_string (result->data, result->source);
-	if (article) {
-		// Enable AMP images by replacing <amg-img> by <img>
-		gchar **tmp_split = g_strsplit(article, "<amp-img", 0);
-		gchar *tmp = g_strjoinv("<img", tmp_split);
-		g_strfreev (tmp_split);
-		g_free (article);
-		article = tmp;
-
-		metadata_list_set (&(item->metadata), "richContent", article);
-		db_item_update (item);
-		g_free (article);
-	}
-	item_unload (item);
-
-	return TRUE;
-}
-
-static gboolean
-subscription_text_enrich_item_cb (UpdateJob *job)
-{
-	UpdateResult *result = job->result;
-	gpointer user_data = job->user_data;
-        if (!result->data || result->size <= 0) {
-                debug (DEBUG_UPDATE, "text fetch failed: %s", result->source);
-		return TRUE;
-        }
-
-        itemPtr item = item_load (GPOINTER_TO_UINT (user_data));
-        if (!item)
-		return TRUE;
-
-        g_autoptr(GString) description = g_string_new ("<pre>");
-        g_string_append_len (description, result->data, result->size);
-        g_string_append (description, "</pre>");
-	metadata_list_set (&(item->metadata), "richContent", description->str);
-        db_item_update (item);
-
-        item_unload (item);
-
-		return TRUE;
-}
-
-
-/**
- * Checks content of an items source and tries to crawl content
- */
 void
 subscription_enrich_item (subscriptionPtr subscription, itemPtr item)
 {
-	UpdateRequest *request;
-
-	if (!item->source) {
-		debug (DEBUG_PARSING, "Cannot enrich item %s because it has no source!", item->title);
-		return;
-	}
-
-	// Don't enrich twice
-	if (NULL != metadata_list_get (item->metadata, "richContent")) {
-		debug (DEBUG_PARSING, "Skipping already enriched item %s", item->title);
-		return;
-	}
-
-	// Fetch item->link document and try to parse it as XHTML
-	debug (DEBUG_PARSING, "Fetching content for %ld %s : %s", item->id, item->title, item->source);
-	request = update_request_new (
-		"GET",
-		item->source,
-		NULL,	// updateState
-		subscription->updateOptions	// Pass options of parent feed (e.g. password, proxy...)
-	);
-
-	if (strstr ("gopher://", item->source) != NULL)
-		update_job_new (subscription, request, subscription_text_enrich_item_cb, GUINT_TO_POINTER (item->id), UPDATE_REQUEST_NO_FEED);
-	else
-		update_job_new (subscription, request, subscription_html5_enrich_item_cb, GUINT_TO_POINTER (item->id), UPDATE_REQUEST_NO_FEED);
+	enrichment_add (subscription, item);
 }
 
 guint
@@ -23,6 +23,7 @@
 #include <string.h>
 
 #include "common.h"
+#include "db.h"
 #include "debug.h"
 #include "favicon.h"
 #include "feedlist.h"
@@ -31,6 +32,40 @@
 #include "update.h"
 
 #define ICON_DOWNLOAD_MAX_URLS	10
+#define ICON_NEGATIVE_TTL	(7 * 24 * 60 * 60)	/* seconds to not retry a host without icon */
+#define ICON_SHARE_TTL		(24 * 60 * 60)		/* seconds to share an icon without revalidation */
+#define ICON_RUNNING_TIMEOUT	(10 * 60)		/* seconds after which a discovery is considered lost */
+
+/* Subscriptions of the same website usually share one favicon. So
+   discovery results are kept per website host (or per icon URL for
+   feeds announcing their own icon) and are shared by all subscriptions
+   with the same key. Only one discovery runs per key, later requests
+   wait for it. Known icons are revalidated with a conditional request
+   and hosts without an icon are not asked again for some time. */
+
+typedef struct iconHost {
+	gchar		*key;		/**< website host or feed icon URL */
+	gchar		*iconUrl;	/**< URL the icon was downloaded from */
+	gchar		*nodeId;	/**< node whose favicon file holds the icon */
+	gchar		*blogroll;	/**< blogroll link if found */
+	gchar		*etag;		/**< ETag of the icon download */
+	gchar		*lastModified;	/**< Last-Modified of the icon download */
+	gint64		checked;	/**< time of last discovery or revalidation (seconds) */
+	gboolean	failed;		/**< TRUE if no icon was found */
+	gboolean	running;	/**< TRUE while a discovery is running */
+	gint64		started;	/**< start of the running discovery (seconds) */
+	GSList		*waiting;	/**< ids of nodes waiting for the running discovery */
+} *iconHostPtr;
+
+static GHashTable *hosts = NULL;
+
+static struct {
+	guint	discoveries;	/**< discoveries started */
+	guint	downloads;	/**< HTTP requests issued */
+	guint	revalidated;	/**< icons confirmed by HTTP 304 */
+	guint	shared;		/**< updates served by another subscription's icon */
+	guint	negative;	/**< updates skipped for hosts without icon */
+} stats;
 
 typedef struct iconDownloadCtxt {
 	gchar		        *id;		/**< icon cache id (=node id) */
@@ -38,8 +73,85 @@ typedef struct iconDownloadCtxt {
 	GSList			*urls;		/**< ordered list of URLs to try */
 	GSList			*doneUrls;	/**< list of URLs we did already try, used for lookup to avoid loops */
 	updateOptionsPtr	options;	/**< download options */
+	iconHostPtr		host;		/**< shared discovery result (or NULL) */
+	gboolean		conditional;	/**< TRUE if the next request revalidates the known icon */
 } *iconDownloadCtxtPtr;
 
+static void
+subscription_icon_host_free (gpointer data)
+{
+	iconHostPtr host = (iconHostPtr)data;
+
+	g_free (host->key);
+	g_free (host->iconUrl);
+	g_free (host->nodeId);
+	g_free (host->blogroll);
+	g_free (host->etag);
+	g_free (host->lastModified);
+	g_slist_free_full (host->waiting, g_free);
+	g_free (host);
+}
+
+static void
+subscription_icon_host_load_cb (const gchar *key, const gchar *iconUrl, const gchar *nodeId, const gchar *blogroll,
+                                const gchar *etag, const gchar *lastModified, gint64 checked, gboolean failed,
+                                gpointer user_data)
+{
+	iconHostPtr host = g_new0 (struct iconHost, 1);
+
+	host->key = g_strdup (key);
+	host->iconUrl = g_strdup (iconUrl);
+	host->nodeId = g_strdup (nodeId);
+	host->blogroll = g_strdup (blogroll);
+	host->etag = g_strdup (etag);
+	host->lastModified = g_strdup (lastModified);
+	host->checked = checked;
+	host->failed = failed;
+
+	g_hash_table_insert (hosts, host->key, host);
+}
+
+static iconHostPtr
+subscription_icon_host_get (const gchar *key)
+{
+	iconHostPtr host;
+
+	if (!hosts) {
+		hosts = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, subscription_icon_host_free);
+		db_favicon_hosts_load (subscription_icon_host_load_cb, NULL);
+		debug (DEBUG_UPDATE, "loaded %u favicon discovery results", g_hash_table_size (hosts));
+	}
+
+	host = g_hash_table_lookup (hosts, key);
+	if (!host) {
+		host = g_new0 (struct iconHost, 1);
+		host->key = g_strdup (key);
+		g_hash_table_insert (hosts, host->key, host);
+	}
+
+	return host;
+}
+
+/* Returns the key under which the icon of the subscription is shared */
+static gchar *
+subscription_icon_get_key (subscriptionPtr subscription)
+{
+	const gchar	*icon = metadata_list_get (subscription->metadata, "icon");
+	const gchar	*url = node_get_base_url (subscription->node);
+	gchar		*key = NULL;
+
+	if (icon)
+		return g_strstrip (g_strdup (icon));
+
+	if (url) {
+		g_autoptr(GUri) uri = g_uri_parse (url, G_URI_FLAGS_PARSE_RELAXED, NULL);
+		if (uri && g_uri_get_host (uri))
+			key = g_ascii_strdown (g_uri_get_host (uri), -1);
+	}
+
+	return key;
+}
+
 static iconDownloadCtxtPtr
 subscription_icon_download_ctxt_new ()
 {
@@ -59,40 +171,79 @@ subscription_icon_download_ctxt_free (iconDownloadCtxtPtr ctxt)
 	g_slist_free_full (ctxt->doneUrls, g_free);
 
 	update_options_free (ctxt->options);
+	g_free (ctxt);
 }
 
 static void
-subscription_icon_download_end (iconDownloadCtxtPtr ctxt)
+subscription_icon_downloaded (Node *node)
 {
-	const gchar *blogroll = ctxt->blogroll;
+	node_load_icon (node);
+	feedlist_node_was_updated (node);
+}
 
-	Node *node = node_from_id (ctxt->id);
+/* Applies a discovery result to the subscription of the given node.
+   The icon is taken from the favicon cache file of iconNodeId. */
+static void
+subscription_icon_apply (const gchar *id, const gchar *iconNodeId, const gchar *blogroll)
+{
+	Node *node = node_from_id (id);
+
+	/* The node might have been removed meanwhile */
 	if (!node)
 		return;
 
-	if (ctxt->blogroll)
-		debug (DEBUG_UPDATE, "Discovered blogroll: %s", blogroll);
+	if (iconNodeId && favicon_copy (iconNodeId, id))
+		subscription_icon_downloaded (node);
 
 	// Even if we do not have a new blogroll, we should still update the old one
 	if (!blogroll)
 		blogroll = metadata_list_get (node->subscription->metadata, "blogroll");
 	if (blogroll)
 		subscription_set_blogroll (node->subscription, blogroll);
-
-	subscription_icon_download_ctxt_free (ctxt);
 }
 
-static void subscription_icon_download_next (iconDownloadCtxtPtr ctxt);
-
 static void
-subscription_icon_downloaded (const gchar *id)
+subscription_icon_download_end (iconDownloadCtxtPtr ctxt, gboolean success)
 {
-	Node *node = node_from_id (id);
+	iconHostPtr	host = ctxt->host;
+	const gchar	*iconNodeId = success?ctxt->id:NULL;
+	const gchar	*blogroll = ctxt->blogroll;
+	GSList		*ids = NULL;
 
-	node_load_icon (node);
-	feedlist_node_was_updated (node);
+	if (ctxt->blogroll)
+		debug (DEBUG_UPDATE, "Discovered blogroll: %s", blogroll);
+
+	if (host) {
+		host->running = FALSE;
+		host->failed = !success;
+		host->checked = g_get_real_time () / G_USEC_PER_SEC;
+		if (ctxt->blogroll) {
+			g_free (host->blogroll);
+			host->blogroll = g_strdup (ctxt->blogroll);
+		}
+		if (success)
+			iconNodeId = host->nodeId;
+		blogroll = host->blogroll;
+
+		db_favicon_host_save (host->key, host->iconUrl, host->nodeId, host->blogroll,
+		                      host->etag, host->lastModified, host->checked, host->failed);
+
+		ids = g_steal_pointer (&host->waiting);
+	}
+	ids = g_slist_prepend (ids, g_strdup (ctxt->id));
+
+	for (GSList *iter = ids; iter; iter = g_slist_next (iter))
+		subscription_icon_apply (iter->data, iconNodeId, blogroll);
+	g_slist_free_full (ids, g_free);
+
+	debug (DEBUG_UPDATE, "favicon discovery: %u discoveries, %u downloads, %u revalidated, %u shared, %u skipped",
+	       stats.discoveries, stats.downloads, stats.revalidated, stats.shared, stats.negative);
+
+	subscription_icon_download_ctxt_free (ctxt);
 }
 
+static void subscription_icon_download_next (iconDownloadCtxtPtr ctxt);
+
 static void
 subscription_icon_download_data_cb (const UpdateResult * const result, gpointer user_data, updateFlags flags)
 {
@@ -115,8 +266,19 @@ subscription_icon_download_data_cb (const UpdateResult * const result, gpointer
 	if (!success) {
 		subscription_icon_download_next (ctxt);
 	} else {
-		subscription_icon_downloaded (ctxt->id);
-		subscription_icon_download_end (ctxt);
+		if (ctxt->host) {
+			iconHostPtr host = ctxt->host;
+
+			g_free (host->iconUrl);
+			g_free (host->nodeId);
+			g_free (host->etag);
+			g_free (host->lastModified);
+			host->iconUrl = g_strdup (result->source);
+			host->nodeId = g_strdup (ctxt->id);
+			host->etag = g_strdup (update_state_get_etag (result->updateState));
+			host->lastModified = g_strdup (update_state_get_lastmodified (result->updateState));
+		}
+		subscription_icon_download_end (ctxt, TRUE);
 	}
 }
 
@@ -141,8 +303,17 @@ subscription_icon_download_html_cb (const UpdateResult * const result, gpointer
 			   And we have "<url>/favicon.ico" quite early in the
 			   original list. Our new list however is sorted by
 			   icon size for highest quality first. */
-			g_slist_free (g_steal_pointer (&(ctxt->urls)));
-			ctxt->urls = links;
+			g_slist_free_full (g_steal_pointer (&(ctxt->urls)), g_free);
+
+			/* Do not try URLs again that already failed */
+			for (GSList *iter = links; iter; iter = g_slist_next (iter)) {
+				if (g_slist_find_custom (ctxt->doneUrls, iter->data, (GCompareFunc)g_strcmp0))
+					g_free (iter->data);
+				else
+					ctxt->urls = g_slist_prepend (ctxt->urls, iter->data);
+			}
+			g_slist_free (links);
+			ctxt->urls = g_slist_reverse (ctxt->urls);
 			success = TRUE;
 		}
 	}
@@ -162,6 +333,15 @@ subscription_icon_handle_response (UpdateJob *job)
 	UpdateResult *result = job->result;
 	gpointer user_data = job->user_data;
 	updateFlags flags = job->flags;
+	iconDownloadCtxtPtr ctxt = (iconDownloadCtxtPtr)user_data;
+
+	/* The known icon of the host is still valid */
+	if (304 == result->httpstatus && ctxt->host && ctxt->host->nodeId) {
+		debug (DEBUG_UPDATE, "Icon '%s' revalidated at '%s'", ctxt->id, ctxt->host->iconUrl);
+		stats.revalidated++;
+		subscription_icon_download_end (ctxt, TRUE);
+		return TRUE;
+	}
 
 	if (!image_extension_match)
 		image_extension_match = g_regex_new ("\\.(ico|png|gif|jpg|svg)$", G_REGEX_CASELESS, 0, NULL);
@@ -185,10 +365,11 @@ subscription_icon_download_next (iconDownloadCtxtPtr ctxt)
 {
 	gchar			*url;
 	UpdateRequest		*request;
+	updateStatePtr		state = NULL;
 
 	if (g_slist_length (ctxt->doneUrls) > ICON_DOWNLOAD_MAX_URLS) {
 		debug (DEBUG_UPDATE, "Stopping icon '%s' discovery after trying %d URLs.", ctxt->id, ICON_DOWNLOAD_MAX_URLS);
-		subscription_icon_download_end (ctxt);
+		subscription_icon_download_end (ctxt, FALSE);
 		return;
 	}
 
@@ -199,17 +380,27 @@ subscription_icon_download_next (iconDownloadCtxtPtr ctxt)
 
 		debug (DEBUG_UPDATE, "Icon '%s' trying URL: '%s'", ctxt->id, url);
 
+		if (ctxt->conditional) {
+			state = update_state_new ();
+			update_state_set_etag (state, ctxt->host->etag);
+			update_state_set_lastmodified (state, ctxt->host->lastModified);
+			ctxt->conditional = FALSE;
+		}
+
 		request = update_request_new (
 			"GET",
 			url,
-			NULL, 	// updateState
+			state,
 			ctxt->options
 		);
+		if (state)
+			update_state_free (state);
 
+		stats.downloads++;
 		update_job_new (node_from_id (ctxt->id), request, subscription_icon_handle_response, ctxt, UPDATE_REQUEST_PRIORITY_HIGH | UPDATE_REQUEST_NO_FEED);
 	} else {
 		debug (DEBUG_UPDATE, "Icon '%s' discovery/download failed!", ctxt->id);
-		subscription_icon_download_end (ctxt);
+		subscription_icon_download_end (ctxt, FALSE);
 	}
 }
 
@@ -217,15 +408,63 @@ void
 subscription_icon_update (subscriptionPtr subscription)
 {
 	iconDownloadCtxtPtr	ctxt;
+	iconHostPtr		host = NULL;
+	g_autofree gchar	*key = NULL;
+	gint64			now = g_get_real_time ();
 
 	debug (DEBUG_UPDATE, "trying to download icon for \"%s\"", node_get_title (subscription->node));
- 	subscription->updateState->lastFaviconPoll = g_get_real_time();
+ 	subscription->updateState->lastFaviconPoll = now;
+	now /= G_USEC_PER_SEC;
+
+	key = subscription_icon_get_key (subscription);
+	if (key) {
+		host = subscription_icon_host_get (key);
+
+		/* Discoveries whose jobs got cancelled never finish, so do
+		   not wait for them forever */
+		if (host->running && now - host->started < ICON_RUNNING_TIMEOUT) {
+			debug (DEBUG_UPDATE, "Icon '%s' waits for running discovery of '%s'", subscription->node->id, key);
+			host->waiting = g_slist_append (host->waiting, g_strdup (subscription->node->id));
+			stats.shared++;
+			return;
+		}
+
+		if (host->failed && now - host->checked < ICON_NEGATIVE_TTL) {
+			debug (DEBUG_UPDATE, "Icon '%s' skipped, no icon found for '%s' recently", subscription->node->id, key);
+			stats.negative++;
+			return;
+		}
+
+		if (!host->failed && host->nodeId && now - host->checked < ICON_SHARE_TTL &&
+		    favicon_copy (host->nodeId, subscription->node->id)) {
+			debug (DEBUG_UPDATE, "Icon '%s' shared from node '%s' (%s)", subscription->node->id, host->nodeId, key);
+			stats.shared++;
+			subscription_icon_downloaded (subscription->node);
+			subscription_icon_apply (subscription->node->id, NULL, host->blogroll);
+			return;
+		}
+
+		host->running = TRUE;
+		host->started = now;
+	}
+
+	stats.discoveries++;
 
 	ctxt = subscription_icon_download_ctxt_new ();
 	ctxt->id = g_strdup (subscription->node->id);
+	ctxt->host = host;
 	ctxt->urls = favicon_get_urls (subscription,
 	                               node_get_base_url (subscription->node));
 
+	/* Try the known icon first, unchanged icons will cost one
+	   conditional request only */
+	if (host && !host->failed && host->iconUrl) {
+		g_autofree gchar *filename = host->nodeId?common_create_cache_filename ("favicons", host->nodeId, "png"):NULL;
+
+		ctxt->urls = g_slist_prepend (ctxt->urls, g_strdup (host->iconUrl));
+		ctxt->conditional = filename && g_file_test (filename, G_FILE_TEST_EXISTS);
+	}
+
 	/* Do not copy update options as it is too dangerous (especially
 	   for online backends as for example TinyTinyRSS where we do not
 	   want to send the TinyTinyRSS credentials to the original website
@@ -0,0 +1,175 @@
+/**
+ * @file json_api_mapper.c  Test cases for the JSON API item mapper
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <glib.h>
+
+#include "debug.h"
+#include "item.h"
+#include "metadata.h"
+#include "xml.h"
+#include "node_sources/json_api_mapper.h"
+
+/* Mapping as used by the Google Reader API sources */
+static jsonApiMapping tc_mapping = {
+	.id		= "id",
+	.title		= "title",
+	.link		= "canonical/href",
+	.description	= "summary/content",
+	.updated	= "updated",
+	.author		= "author",
+	.read		= "read",
+	.flag		= "marked",
+	.negateRead	= TRUE,
+	.xhtml		= FALSE
+};
+
+static const gchar *tc_items =
+	"{\"items\":["
+	"{\"id\":\"i1\",\"title\":\"T1\",\"canonical\":{\"href\":\"https://localhost/1\"},"
+	"\"summary\":{\"content\":\"D1\"},\"updated\":1678397817,\"author\":\"A1\",\"read\":true,\"marked\":false},"
+	"{\"id\":\"i2\",\"title\":\"T2\",\"canonical\":\"not an object\",\"updated\":1678397818,\"marked\":true},"
+	"{\"id\":\"i3\"}"
+	"]}";
+
+static void
+tc_get_items (void)
+{
+	GList	*items, *iter;
+	itemPtr	item;
+
+	items = json_api_get_items (tc_items, "items", &tc_mapping, NULL);
+	g_assert_cmpuint (g_list_length (items), ==, 3);
+
+	/* Items are returned in document order */
+	iter = items;
+	item = (itemPtr)iter->data;
+	g_assert_cmpstr (item->sourceId, ==, "i1");
+	g_assert_cmpstr (item_get_title (item), ==, "T1");
+	g_assert_cmpstr (item_get_source (item), ==, "https://localhost/1");
+	g_assert_cmpstr (item_get_description (item), ==, "D1");
+	g_assert_cmpstr (metadata_list_get (item->metadata, "author"), ==, "A1");
+	g_assert_cmpint (item->time, ==, 1678397817);
+	g_assert_false (item->readStatus);
+	g_assert_false (item->flagStatus);
+
+	/* Paths into missing or non-object members resolve to nothing */
+	iter = g_list_next (iter);
+	item = (itemPtr)iter->data;
+	g_assert_cmpstr (item->sourceId, ==, "i2");
+	g_assert_null (item_get_source (item));
+	g_assert_null (item_get_description (item));
+	g_assert_null (metadata_list_get (item->metadata, "author"));
+	g_assert_true (item->readStatus);
+	g_assert_true (item->flagStatus);
+
+	iter = g_list_next (iter);
+	item = (itemPtr)iter->data;
+	g_assert_cmpstr (item->sourceId, ==, "i3");
+	g_assert_cmpstr (item_get_title (item), ==, "");
+	g_assert_cmpint (item->time, ==, 0);
+
+	g_list_free_full (items, g_object_unref);
+}
+
+static void
+tc_get_items_invalid (void)
+{
+	g_assert_null (json_api_get_items ("{\"items\":[", "items", &tc_mapping, NULL));
+}
+
+/* Builds a Reader API like response with the given number of items */
+static gchar *
+tc_fixture_new (guint count)
+{
+	GString	*json = g_string_new ("{\"items\":[");
+
+	for (guint i = 0; i < count; i++) {
+		if (i)
+			g_string_append_c (json, ',');
+		g_string_append_printf (json,
+			"{\"id\":\"tag:google.com,2005:reader/item/%016x\","
+			"\"title\":\"Item %u\","
+			"\"canonical\":{\"href\":\"https://localhost/items/%u\"},"
+			"\"summary\":{\"content\":\"<p>Description of item %u</p>\"},"
+			"\"updated\":%u,\"author\":\"Author %u\",\"read\":%s,\"marked\":%s}",
+			i, i, i, i, 1678397817 + i, i % 10,
+			(i % 3)?"true":"false", (i % 7)?"false":"true");
+	}
+	g_string_append (json, "]}");
+
+	return g_string_free (json, FALSE);
+}
+
+static void
+tc_benchmark (void)
+{
+	g_autoptr(GTimer)	timer = NULL;
+	g_autofree gchar	*json = NULL;
+	jsonApiMapping		mapping = tc_mapping;
+	const guint		count = 1000;
+	const guint		rounds = 20;
+	gdouble			elapsed;
+
+	if (!g_test_perf ()) {
+		g_test_skip ("benchmark, run with -m perf");
+		return;
+	}
+
+	json = tc_fixture_new (count);
+	timer = g_timer_new ();
+
+	/* Once without and once with XHTML extraction to separate the mapping
+	   cost from the description parsing cost */
+	for (guint pass = 0; pass < 2; pass++) {
+		mapping.xhtml = (pass == 1);
+
+		g_timer_start (timer);
+		for (guint j = 0; j < rounds; j++) {
+			GList *items = json_api_get_items (json, "items", &mapping, NULL);
+			g_assert_cmpuint (g_list_length (items), ==, count);
+			g_list_free_full (items, g_object_unref);
+		}
+		elapsed = g_timer_elapsed (timer, NULL);
+
+		g_test_message ("%u items%s: %.0f items/s", count, mapping.xhtml?" (XHTML)":"", count * rounds / elapsed);
+		g_test_maximized_result (count * rounds / elapsed, "JSON API mapper throughput%s", mapping.xhtml?" (XHTML)":"");
+	}
+}
+
+int
+test_json_api_mapper (int argc, char *argv[])
+{
+	int result;
+
+	g_test_init (&argc, &argv, NULL);
+
+	if (g_strv_contains ((const gchar **)argv, "--debug"))
+		debug_set_flags (DEBUG_PARSING);
+
+	xml_init ();
+
+	g_test_add_func ("/json_api_mapper/get_items",		&tc_get_items);
+	g_test_add_func ("/json_api_mapper/get_items_invalid",	&tc_get_items_invalid);
+	g_test_add_func ("/json_api_mapper/benchmark",		&tc_benchmark);
+
+	result = g_test_run();
+
+	return result;
+}
@@ -1,4 +1,5 @@
 #!/bin/bash
 
+# Usage: ./start.sh [miniflux|webdav]
 
-podman-compose -f miniflux-compose.yaml up
+podman-compose -f ${1:-miniflux}-compose.yaml up
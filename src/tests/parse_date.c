@@ -38,6 +38,8 @@ struct tc tc_rfc822_year2_1	= { "05 Nov 14 18:04:35", 1415210675 };
 struct tc tc_rfc822_year2_2	= { "05 Nov 14 18:04", 1415210640 };
 struct tc tc_rfc822_year2_3	= { "Wed, 05 Nov 14 17:04:35 -0100", 1415210675 };
 struct tc tc_rfc822_wrong	= { "Do, 05 Nov 2014 18:04:58", 1415210698 };
+struct tc tc_rfc822_utc		= { "Wed, 05 Nov 2014 18:04:58 UTC", 1415210698 };
+struct tc tc_rfc822_leap	= { "Thu, 29 Feb 2024 12:00:00 GMT", 1709208000 };
 
 struct tc tc_iso8601_full	= { "2014-11-05T19:00:00+0100", 1415210400 };
 struct tc tc_iso8601_day	= { "2014-11-05", 1415145600 };
@@ -45,6 +47,8 @@ struct tc tc_iso8601_hours	= { "2014-11-05T19+0100", 1415214000 };
 struct tc tc_iso8601_Z		= { "2014-11-04T10:15:16Z", 1415096116 };
 struct tc tc_iso8601_wrong	= { "2014-22-22T31", 0 };
 struct tc tc_iso8601_notz	= { "2022-12-14T22:02:55", 1671055375 };
+struct tc tc_iso8601_fraction	= { "2022-12-14T22:02:55.123+01:00", 1671051775 };
+struct tc tc_iso8601_noleap	= { "2023-02-29", 0 };
 
 static void
 tc_parse_rfc822 (gconstpointer user_data)
@@ -61,6 +65,54 @@ tc_parse_iso8601 (gconstpointer user_data)
 	g_assert_cmpint (date_parse_ISO8601 (tc->date_string), ==, tc->timestamp);
 }
 
+/* Typical feed dates, the last ones of each kind need the fallback parser */
+static const gchar *bench_rfc822[] = {
+	"Wed, 05 Nov 2014 19:24:38 +0100",
+	"Wed, 05 Nov 2014 18:04:58 GMT",
+	"5 Nov 2014 18:04 EST",
+	"Mi, 05 Nov 2014 18:04:58 (CET)",
+	NULL
+};
+
+static const gchar *bench_iso8601[] = {
+	"2014-11-05T19:00:00+01:00",
+	"2014-11-04T10:15:16Z",
+	"2014-11-04T10:15:16.123456Z",
+	" 2014-11-05",
+	NULL
+};
+
+static void
+tc_parse_benchmark (const gchar **dates, gint64 (*parse)(const gchar *), const gchar *name)
+{
+	g_autoptr(GTimer)	timer = g_timer_new ();
+	const guint		rounds = 100000;
+
+	for (guint i = 0; dates[i]; i++) {
+		gdouble elapsed;
+
+		g_timer_start (timer);
+		for (guint j = 0; j < rounds; j++)
+			(void)(*parse) (dates[i]);
+		elapsed = g_timer_elapsed (timer, NULL);
+
+		g_test_message ("%s \"%s\": %.0f dates/s", name, dates[i], rounds / elapsed);
+		g_test_maximized_result (rounds / elapsed, "%s throughput", name);
+	}
+}
+
+static void
+tc_benchmark (void)
+{
+	if (!g_test_perf ()) {
+		g_test_skip ("benchmark, run with -m perf");
+		return;
+	}
+
+	tc_parse_benchmark (bench_rfc822, date_parse_RFC822, "RFC822");
+	tc_parse_benchmark (bench_iso8601, date_parse_ISO8601, "ISO8601");
+}
+
 int
 test_parse_date (int argc, char *argv[])
 {
@@ -79,6 +131,8 @@ test_parse_date (int argc, char *argv[])
 	g_test_add_data_func ("/parse_date/rfc822/year2_2",	&tc_rfc822_year2_2,	&tc_parse_rfc822);
 	g_test_add_data_func ("/parse_date/rfc822/year2_3",	&tc_rfc822_year2_3,	&tc_parse_rfc822);
 	g_test_add_data_func ("/parse_date/rfc822/wrong",	&tc_rfc822_wrong,	&tc_parse_rfc822);
+	g_test_add_data_func ("/parse_date/rfc822/utc",		&tc_rfc822_utc,		&tc_parse_rfc822);
+	g_test_add_data_func ("/parse_date/rfc822/leap",	&tc_rfc822_leap,	&tc_parse_rfc822);
 
 	g_test_add_data_func ("/parse_date/iso8601/empty",	&tc_empty,		&tc_parse_iso8601);
 	g_test_add_data_func ("/parse_date/iso8601/nonsense",	&tc_nonsense,		&tc_parse_iso8601);
@@ -88,6 +142,10 @@ test_parse_date (int argc, char *argv[])
 	g_test_add_data_func ("/parse_date/iso8601/Z",		&tc_iso8601_Z,		&tc_parse_iso8601);
 	g_test_add_data_func ("/parse_date/iso8601/wrong",	&tc_iso8601_wrong,	&tc_parse_iso8601);
 	g_test_add_data_func ("/parse_date/iso8601/notz",	&tc_iso8601_notz,	&tc_parse_iso8601);
+	g_test_add_data_func ("/parse_date/iso8601/fraction",	&tc_iso8601_fraction,	&tc_parse_iso8601);
+	g_test_add_data_func ("/parse_date/iso8601/noleap",	&tc_iso8601_noleap,	&tc_parse_iso8601);
+
+	g_test_add_func ("/parse_date/benchmark", &tc_benchmark);
 
 	result = g_test_run();
 
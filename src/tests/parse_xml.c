@@ -19,6 +19,11 @@
  */
 
 #include <glib.h>
+#include <string.h>
+
+#include <libxml/HTMLparser.h>
+#include <libxml/HTMLtree.h>
+#include <libxml/xpath.h>
 
 #include "xml.h"
 
@@ -95,6 +100,16 @@ struct tcStripper tc_strippers[] = {
 		"<div><script type='text/javascript'>Some script\n</ script><script src='somewhere'/><script>alert('Hallo');</script></div>",
 		"//script"
 	},
+	{
+		"/xhtml_strip/onerror",
+		"<div><img src=x onerror='alert(1)'/><img src='y' OnError=\"alert(2)\"></div>",
+		"//img/@onerror"
+	},
+	{
+		"/xhtml_strip/onclick",
+		"<p><a href='#' onclick='alert(1)' data-on='keep'>link</a></p>",
+		"//a/@onclick"
+	},
 	{
 		"/xhtml_strip/iframe",
 		"<div><iframe>Some iframe\n</iframe><iframe/><iframe>another iframe</iframe></div>",
@@ -144,6 +159,236 @@ tc_strip (gconstpointer user_data)
 	xmlFreeDoc (doc);
 }
 
+/* An unterminated tag must not survive stripping, as the markup of the
+   rendering template appended afterwards would terminate it */
+static void
+tc_strip_unterminated (void)
+{
+	xmlDocPtr	doc;
+	xmlNodePtr	root;
+	gchar		*stripped, *rendered;
+
+	stripped = xhtml_strip_dhtml ("<div><p>text</p><img src=x onerror=alert(1) ");
+	g_assert_true (stripped != NULL);
+	g_assert_null (strstr (stripped, "onerror"));
+
+	rendered = g_strdup_printf ("%s<p class='template'>footer</p></div>", stripped);
+	doc = xhtml_parse (rendered, (size_t)strlen (rendered));
+	g_free (rendered);
+	g_free (stripped);
+
+	g_assert_false (!doc);
+	root = xmlDocGetRootElement (doc);
+	g_assert_false (!root);
+
+	g_assert_true (xpath_find (root, "//img/@onerror") == NULL);
+
+	xmlFreeDoc (doc);
+}
+
+/* The regex based stripper replaced by the single pass xhtml_strip_dhtml(),
+   kept as a reference for the benchmark */
+static GSList *regex_strippers = NULL;
+
+static void
+regex_stripper_add (const gchar *pattern)
+{
+	regex_strippers = g_slist_append (regex_strippers, g_regex_new (pattern, G_REGEX_CASELESS | G_REGEX_UNGREEDY | G_REGEX_DOTALL, 0, NULL));
+}
+
+static gchar *
+regex_strip_dhtml (const gchar *html)
+{
+	gchar *result = g_strdup (html);
+
+	if (!regex_strippers) {
+		regex_stripper_add ("\\s+onload='[^']+'");
+		regex_stripper_add ("\\s+onload=\"[^\"]+\"");
+		regex_stripper_add ("<\\s*meta[^>]*>.*</\\s*meta\\s*>");
+		regex_stripper_add ("<\\s*script[^>]*>.*</\\s*script\\s*>");
+		regex_stripper_add ("<\\s*iframe[^>]*>.*</\\s*iframe\\s*>");
+		regex_stripper_add ("<\\s*(meta|script|iframe)[^>]*/>");
+		regex_stripper_add ("<\\s*/?wbr[^>]*/?\\s*>");
+		regex_stripper_add ("<\\s*/?body[^>]*/?\\s*>");
+	}
+
+	for (GSList *iter = regex_strippers; iter; iter = g_slist_next (iter)) {
+		gchar *tmp = result;
+		result = g_regex_replace_literal ((GRegex *)iter->data, tmp, -1, 0, "", 0, NULL);
+		g_free (tmp);
+	}
+
+	return result;
+}
+
+static void
+tc_strip_benchmark (void)
+{
+	g_autoptr(GString)	article = g_string_new ("<div>");
+	g_autoptr(GTimer)	timer = g_timer_new ();
+	gdouble			regexTime, singlePassTime;
+	const guint		items = 500;
+
+	if (!g_test_perf ()) {
+		g_test_skip ("benchmark, run with -m perf");
+		return;
+	}
+
+	/* a long article with some DHTML sprinkled in */
+	for (guint i = 0; i < 50; i++) {
+		g_string_append_printf (article, "<p class=\"para\" id=\"p%u\">Lorem ipsum dolor sit amet, <a href=\"https://example.com/%u\" onclick=\"track(%u)\">consectetur</a> adipiscing elit, sed do eiusmod tempor incididunt ut labore et dolore magna aliqua.</p>", i, i, i);
+		if (i % 10 == 0)
+			g_string_append (article, "<script type=\"text/javascript\">var x = 1;</script><img src=\"a.png\" onload=\"resize(this)\"/><wbr/>");
+	}
+	g_string_append (article, "<iframe src=\"https://example.com/embed\"></iframe></div>");
+
+	g_timer_start (timer);
+	for (guint i = 0; i < items; i++)
+		g_free (regex_strip_dhtml (article->str));
+	regexTime = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+	for (guint i = 0; i < items; i++)
+		g_free (xhtml_strip_dhtml (article->str));
+	singlePassTime = g_timer_elapsed (timer, NULL);
+
+	g_test_message ("%u items of %zu bytes: regex chain %.1fms, single pass %.1fms (%.1fx)",
+	                items, article->len, regexTime * 1000, singlePassTime * 1000,
+	                singlePassTime > 0?regexTime / singlePassTime:0.0);
+	g_test_minimized_result (singlePassTime, "single pass stripping of %u items: %.3fs", items, singlePassTime);
+}
+
+/* Escaped HTML content extraction as done before parser context reuse,
+   kept as a reference for output comparison and the benchmark */
+static gchar *
+reference_extract (xmlNodePtr xml, const gchar *defaultBase)
+{
+	xmlDocPtr	newDoc = xmlNewDoc (BAD_CAST "1.0");
+	xmlNodePtr	divNode = xmlNewNode (NULL, BAD_CAST "div");
+	xmlBufferPtr	buf;
+	xmlChar		*xml_base;
+	gchar		*escapedhtml, *result = NULL;
+
+	xmlDocSetRootElement (newDoc, divNode);
+	xmlNewNs (divNode, BAD_CAST "http://www.w3.org/1999/xhtml", NULL);
+
+	xml_base = xmlNodeGetBase (xml->doc, xml);
+	if (xml_base) {
+		xmlNodeSetBase (divNode, xml_base);
+		xmlFree (xml_base);
+	} else if (defaultBase) {
+		xmlNodeSetBase (divNode, BAD_CAST defaultBase);
+	}
+
+	escapedhtml = (gchar *)xmlNodeListGetString (xml->doc, xml->xmlChildrenNode, 1);
+	if (escapedhtml) {
+		escapedhtml = g_strstrip (escapedhtml);
+		if (*escapedhtml) {
+			xmlDocPtr		oldDoc = htmlReadMemory (escapedhtml, strlen (escapedhtml), NULL, "utf-8", HTML_PARSE_RECOVER | HTML_PARSE_NONET | HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
+			xmlXPathContextPtr	xpathCtxt = xmlXPathNewContext (oldDoc);
+			xmlXPathObjectPtr	xpathObj = xmlXPathEvalExpression (BAD_CAST "/html/body", xpathCtxt);
+
+			for (xmlNs *ns = (xmlDocGetRootElement (xml->doc))->nsDef; ns; ns = ns->next)
+				xmlNewNs (divNode, ns->href, ns->prefix);
+
+			if (xpathObj && xpathObj->nodesetval && xpathObj->nodesetval->nodeNr)
+				xmlAddChildList (divNode, xmlDocCopyNodeList (newDoc, xpathObj->nodesetval->nodeTab[0]->xmlChildrenNode));
+
+			xmlXPathFreeObject (xpathObj);
+			xmlXPathFreeContext (xpathCtxt);
+			xmlFreeDoc (oldDoc);
+		}
+		g_free (escapedhtml);
+	}
+
+	buf = xmlBufferCreate ();
+	htmlNodeDump (buf, newDoc, divNode);
+	if (xmlBufferLength (buf) > 0)
+		result = g_strdup ((gchar *)xmlBufferContent (buf));
+	xmlBufferFree (buf);
+	xmlFreeDoc (newDoc);
+
+	return result;
+}
+
+static const gchar *tc_extract_items[] = {
+	"&lt;p&gt;Simple &lt;b&gt;paragraph&lt;/b&gt;&lt;/p&gt;",
+	"Plain text with &amp;amp; entity and non-ASCII: äöü €",
+	"&lt;div&gt;&lt;img src=\"a.png\"&gt;&lt;br&gt;unclosed &lt;i&gt;tags&lt;/div&gt;",
+	"&lt;span class='ljuser' lj:user='someone'&gt;&lt;a href='http://example.com/a b'&gt;someone&lt;/a&gt;&lt;/span&gt;",
+	"&lt;html&gt;&lt;head&gt;&lt;title&gt;t&lt;/title&gt;&lt;/head&gt;&lt;body&gt;&lt;p&gt;full document&lt;/p&gt;&lt;/body&gt;&lt;/html&gt;",
+	"   ",
+	"&lt;table&gt;&lt;tr&gt;&lt;td&gt;cell&lt;/td&gt;&lt;/tr&gt;&lt;/table&gt;&lt;pre&gt;  keep\n  spaces&lt;/pre&gt;",
+	NULL
+};
+
+static xmlDocPtr
+tc_extract_doc (guint copies)
+{
+	g_autoptr(GString) feed = g_string_new ("<rss version='2.0' xmlns:lj='http://www.livejournal.org/rss/lj/1.0/'><channel xml:base='http://example.com/'>");
+
+	for (guint i = 0; i < copies; i++) {
+		for (guint j = 0; tc_extract_items[j]; j++)
+			g_string_append_printf (feed, "<item><description>%s</description></item>", tc_extract_items[j]);
+	}
+	g_string_append (feed, "</channel></rss>");
+
+	return xmlReadMemory (feed->str, feed->len, NULL, NULL, 0);
+}
+
+static void
+tc_extract_identical (void)
+{
+	xmlDocPtr	doc = tc_extract_doc (1);
+	xmlNodePtr	channel;
+
+	g_assert_nonnull (doc);
+	channel = xmlDocGetRootElement (doc)->children;
+
+	for (xmlNodePtr item = channel->children; item; item = item->next) {
+		g_autofree gchar *expected = reference_extract (item->children, NULL);
+		g_autofree gchar *result = xhtml_extract (item->children, 0, NULL);
+
+		g_assert_cmpstr (result, ==, expected);
+	}
+
+	xmlFreeDoc (doc);
+}
+
+static void
+tc_extract_benchmark (void)
+{
+	g_autoptr(GTimer)	timer = g_timer_new ();
+	xmlDocPtr		doc;
+	xmlNodePtr		channel;
+	guint			items = 0;
+	gdouble			referenceTime, extractTime;
+
+	if (!g_test_perf ()) {
+		g_test_skip ("benchmark, run with -m perf");
+		return;
+	}
+
+	doc = tc_extract_doc (100);
+	channel = xmlDocGetRootElement (doc)->children;
+
+	g_timer_start (timer);
+	for (xmlNodePtr item = channel->children; item; item = item->next)
+		g_free (reference_extract (item->children, NULL));
+	referenceTime = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+	for (xmlNodePtr item = channel->children; item; item = item->next, items++)
+		g_free (xhtml_extract (item->children, 0, NULL));
+	extractTime = g_timer_elapsed (timer, NULL);
+
+	g_test_message ("%u items: previous extraction %.1fus/item, current %.1fus/item",
+	                items, referenceTime * 1000000 / items, extractTime * 1000000 / items);
+	g_test_minimized_result (extractTime / items, "extraction cost per item: %.1fus", extractTime * 1000000 / items);
+
+	xmlFreeDoc (doc);
+}
+
 int
 test_parse_xml (int argc, char *argv[])
 {
@@ -160,6 +405,11 @@ test_parse_xml (int argc, char *argv[])
 		g_test_add_data_func (tc_strippers[i].name, &tc_strippers[i], &tc_strip);
 	}
 
+	g_test_add_func ("/xhtml_strip/unterminated", &tc_strip_unterminated);
+	g_test_add_func ("/xhtml_strip/benchmark", &tc_strip_benchmark);
+	g_test_add_func ("/xhtml_extract/identical", &tc_extract_identical);
+	g_test_add_func ("/xhtml_extract/benchmark", &tc_extract_benchmark);
+
 	result = g_test_run();
 
 	return result;
@@ -0,0 +1,116 @@
+/**
+ * @file retention.c  Test cases for item retention
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <glib.h>
+
+#include "db.h"
+#include "debug.h"
+#include "item.h"
+#include "itemset.h"
+#include "node.h"
+#include "node_source.h"
+#include "retention.h"
+
+#define ONE_DAY	(24 * 60 * 60)
+
+/* A plain feed without any node source capabilities */
+static struct nodeSourceType	tc_source_type;
+static struct nodeSource	tc_source = { .type = &tc_source_type };
+
+static itemPtr
+tc_item_new (gint64 time)
+{
+	itemPtr item = item_new ();
+
+	item_set_title (item, "old item");
+	item_set_id (item, "urn:test:retention:1");
+	item->validGuid = TRUE;
+	item->time = time;
+	item->validTime = TRUE;
+
+	return item;
+}
+
+static guint
+tc_merge (Node *node, itemPtr item)
+{
+	itemSetPtr	itemSet = db_itemset_load (node->id);
+	guint		newCount;
+
+	newCount = itemset_merge_items (itemSet, g_list_append (NULL, item), TRUE, FALSE);
+	itemset_free (itemSet);
+
+	return newCount;
+}
+
+/* An item expired by date must not come back on the next update */
+static void
+tc_expire_remerge (void)
+{
+	Node	*node = node_new ("feed");
+	gint64	time = g_get_real_time () / G_USEC_PER_SEC - 60 * ONE_DAY;
+	gint64	unreadBefore, readBefore;
+	GArray	*expired;
+
+	db_init ();
+
+	node->source = &tc_source;
+
+	/* Without limit the item is merged as new */
+	node->retainUnread = node->retainRead = -1;
+	g_assert_cmpuint (tc_merge (node, tc_item_new (time)), ==, 1);
+	g_assert_cmpuint (db_itemset_get_item_count (node->id), ==, 1);
+
+	/* A 30 days retention expires it... */
+	node->retainUnread = node->retainRead = 30;
+	retention_get_expiry (node, &unreadBefore, &readBefore);
+	g_assert_cmpint (unreadBefore, >, time);
+	g_assert_cmpint (readBefore, >, time);
+
+	expired = db_itemset_expire (node->id, unreadBefore, readBefore, 100, 0, NULL);
+	g_assert_cmpuint (expired->len, ==, 1);
+	g_array_free (expired, TRUE);
+	g_assert_cmpuint (db_itemset_get_item_count (node->id), ==, 0);
+
+	/* ...and the next update with the same item does not re-add it */
+	g_assert_cmpuint (tc_merge (node, tc_item_new (time)), ==, 0);
+	g_assert_cmpuint (db_itemset_get_item_count (node->id), ==, 0);
+
+	/* Items within the retention age are still merged */
+	g_assert_cmpuint (tc_merge (node, tc_item_new (time + 45 * ONE_DAY)), ==, 1);
+	g_assert_cmpuint (db_itemset_get_item_count (node->id), ==, 1);
+
+	db_deinit ();
+}
+
+int
+test_retention (int argc, char *argv[])
+{
+	gint result;
+
+	/* Keeps the DB in a temporary data dir */
+	g_test_init (&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func ("/retention/expire_remerge", &tc_expire_remerge);
+
+	result = g_test_run ();
+
+	return result;
+}
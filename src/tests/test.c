@@ -7,8 +7,10 @@ extern int test_parse_html (int argc, char *argv[]);
 extern int test_parse_uri (int argc, char *argv[]);
 extern int test_parse_xml (int argc, char *argv[]);
 extern int test_parse_rss (int argc, char *argv[]);
+extern int test_retention (int argc, char *argv[]);
 extern int test_social (int argc, char *argv[]);
 extern int test_favicon (int argc, char *argv[]);
+extern int test_json_api_mapper (int argc, char *argv[]);
 extern int test_update (int argc, char *argv[]);
 
 int run_test (int argc, char *argv[]) {
@@ -30,6 +32,10 @@ int run_test (int argc, char *argv[]) {
                         return test_parse_xml (argc, argv);
                 if (g_str_equal (argv[2], "favicon"))
                         return test_favicon (argc, argv);
+                if (g_str_equal (argv[2], "json_api_mapper"))
+                        return test_json_api_mapper (argc, argv);
+                if (g_str_equal (argv[2], "retention"))
+                        return test_retention (argc, argv);
                 if (g_str_equal (argv[2], "social"))
                         return test_social (argc, argv);
                 if (g_str_equal (argv[2], "update"))
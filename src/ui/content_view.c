@@ -22,6 +22,7 @@
 
 #include "comments.h"
 #include "common.h"
+#include "item_extract.h"
 #include "node_source.h"
 #include "ui/liferea_browser.h"
 
@@ -81,7 +82,7 @@ content_view_item_selected (GObject *obj, gint itemId, gpointer user_data)
         node = node_from_id (item->nodeId);
 
         direction = item_get_text_direction (item);
-        json = item_to_json (item);
+        json = item_extract_to_json (item);
 
         if (node_get_base_url (node))
                 baseURL = g_markup_escape_text ((gchar *)node_get_base_url (node), -1);
@@ -105,7 +106,7 @@ content_view_item_updated (GObject *obj, gint itemId, gpointer user_data)
         if (cv->mode != 2 || item->id != cv->currentItemId)
                 return;
 
-        json = item_to_json (item);
+        json = item_extract_to_json (item);
         liferea_browser_update_view (LIFEREA_BROWSER (cv), json);
 }
 
@@ -401,6 +401,15 @@ feed_list_view_refresh_node (Node *node)
 	}
 }
 
+void
+feed_list_view_update_node_icon (Node *node)
+{
+	if (!node || !flv || !flv->listview)
+		return;
+
+	feed_list_view_refresh_bound_row_widget (GTK_WIDGET (flv->listview), node);
+}
+
 static gboolean
 feed_list_view_remove_node_item (const gchar *nodeId)
 {
@@ -101,4 +101,12 @@ void feed_list_view_add_duplicate_url_subscription (subscriptionPtr tempSubscrip
  */
 void feed_list_view_reparent (Node *node);
 
+/**
+ * feed_list_view_update_node_icon:
+ * @node: the node whose icon was loaded
+ *
+ * Updates the icon of a visible feed list row without a full node update.
+ */
+void feed_list_view_update_node_icon (Node *node);
+
 #endif
@@ -633,6 +633,50 @@ item_list_view_item_removed (GObject *obj, gulong id, gpointer user_data)
 	}
 }
 
+static gboolean
+item_list_view_entry_is_stale (ItemListView *ilv, guint position)
+{
+	ItemListEntry	*entry = g_list_model_get_item (G_LIST_MODEL (ilv->base_model), position);
+	gboolean	stale = (entry != item_list_view_id_to_entry (ilv, entry->id));
+
+	g_object_unref (entry);
+
+	return stale;
+}
+
+static void
+item_list_view_items_removed (GObject *obj, gpointer ids, gpointer user_data)
+{
+	ItemListView	*ilv = ITEM_LIST_VIEW (user_data);
+	GArray		*removed = (GArray *)ids;
+	guint		i, found = 0;
+
+	/* The selected item is never part of a batch, so there is no
+	   selection to move and the removal is done without looking
+	   up every entry in the store. */
+	for (i = 0; i < removed->len; i++)
+		if (g_hash_table_remove (ilv->entries_by_id, GUINT_TO_POINTER (g_array_index (removed, gulong, i))))
+			found++;
+
+	debug (DEBUG_GUI, "removing %u of %u items from the item list", found, removed->len);
+	if (!found)
+		return;
+
+	/* Splice out runs of removed entries from the end */
+	i = g_list_model_get_n_items (G_LIST_MODEL (ilv->base_model));
+	while (i > 0) {
+		guint end = i;
+
+		while (i > 0 && item_list_view_entry_is_stale (ilv, i - 1))
+			i--;
+
+		if (i < end)
+			g_list_store_splice (ilv->base_model, i, end - i, NULL, 0);
+		else
+			i--;
+	}
+}
+
 static void
 item_list_view_item_batch_started (GObject *obj, gpointer user_data)
 {
@@ -1226,6 +1270,7 @@ item_list_view_create (FeedList *feedlist, ItemList *itemlist)
 	g_signal_connect (itemlist, "item-added", G_CALLBACK (item_list_view_item_added), ilv);
 	g_signal_connect (itemlist, "all-items-removed", G_CALLBACK (item_list_view_all_items_removed), ilv);
 	g_signal_connect (itemlist, "item-removed", G_CALLBACK (item_list_view_item_removed), ilv);
+	g_signal_connect (itemlist, "items-removed", G_CALLBACK (item_list_view_items_removed), ilv);
 	g_signal_connect (itemlist, "item-updated", G_CALLBACK (item_list_view_item_updated), ilv);
 	g_signal_connect (itemlist, "item-selected", G_CALLBACK (item_list_view_select), ilv);
 
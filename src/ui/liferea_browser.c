@@ -42,6 +42,8 @@
 #include "common.h"
 #include "conf.h"
 #include "debug.h"
+#include "item_extract.h"
+#include "itemlist.h"
 #include "net_monitor.h"
 #include "ui/browser_tabs.h"
 #include "ui/item_list_view.h"
@@ -143,6 +145,7 @@ liferea_browser_finalize (GObject *object)
 	browser_history_free (browser->history);
 	g_clear_object (&browser->container);
 	g_free (browser->content);
+	g_free (browser->view);
 
 	g_signal_handlers_disconnect_by_data (network_monitor_get (), object);
 }
@@ -325,6 +328,116 @@ liferea_browser_new (gboolean forceInternalBrowsing)
 	return browser;
 }
 
+/* The view pages (item, node, ...) stay loaded after the first
+   rendering and further content of the same type is pushed into
+   them. Any other load replaces the page and resets this state. */
+static void
+liferea_browser_view_reset (LifereaBrowser *browser)
+{
+	g_clear_pointer (&browser->view, g_free);
+	browser->viewReady = FALSE;
+	browser->viewRequested = 0;
+}
+
+static gchar *
+liferea_browser_message_get_string (JSCValue *value, const gchar *name)
+{
+	g_autoptr(JSCValue) property = jsc_value_object_get_property (value, name);
+
+	if (!jsc_value_is_string (property))
+		return NULL;
+
+	return jsc_value_to_string (property);
+}
+
+static gdouble
+liferea_browser_message_get_number (JSCValue *value, const gchar *name)
+{
+	g_autoptr(JSCValue) property = jsc_value_object_get_property (value, name);
+
+	if (!jsc_value_is_number (property))
+		return 0.0;
+
+	return jsc_value_to_double (property);
+}
+
+static void
+liferea_browser_view_rendered (LifereaBrowser *browser, JSCValue *value)
+{
+	g_autofree gchar	*extract = liferea_browser_message_get_string (value, "extract");
+	gdouble			ms = liferea_browser_message_get_number (value, "ms");
+
+	if (extract)
+		item_extract_rendered (extract, ms);
+
+	if (!browser->view)
+		return;
+
+	browser->viewReady = TRUE;
+
+	if (browser->viewRequested) {
+		debug (DEBUG_HTML, "%s view rendered after %.1fms (%s, %.1fms rendering)",
+		       browser->view,
+		       (g_get_monotonic_time () - browser->viewRequested) / 1000.0,
+		       browser->viewInjected?"injected":"page load",
+		       ms);
+		browser->viewRequested = 0;
+	}
+}
+
+static void
+liferea_browser_view_extracted (LifereaBrowser *browser, JSCValue *value)
+{
+	g_autofree gchar	*hash = liferea_browser_message_get_string (value, "hash");
+	g_autofree gchar	*title = liferea_browser_message_get_string (value, "title");
+	g_autofree gchar	*content = liferea_browser_message_get_string (value, "content");
+	gdouble			id = liferea_browser_message_get_number (value, "id");
+
+	/* Only accept results for the item currently shown by the item view */
+	if (g_strcmp0 (browser->view, "item") || id <= 0 || (gulong)id != itemlist_get_selected_id ()) {
+		debug (DEBUG_HTML, "ignoring extraction result for item #%lu not shown", (gulong)id);
+		return;
+	}
+
+	if (hash)
+		item_extract_save ((gulong)id, hash, title, content);
+}
+
+/* Returns TRUE if the page loaded is one of our view templates. Remote
+   pages loaded in the same web view can post messages too. */
+static gboolean
+liferea_browser_message_from_view (LifereaBrowser *browser)
+{
+	const gchar *uri = webkit_web_view_get_uri (WEBKIT_WEB_VIEW (browser->renderWidget));
+
+	return browser->view && !browser->url && uri && g_str_has_prefix (uri, "liferea:");
+}
+
+/* Messages posted by the view scripts via window.webkit.messageHandlers.liferea */
+static void
+liferea_browser_script_message_cb (WebKitUserContentManager *manager, JSCValue *value, gpointer user_data)
+{
+	LifereaBrowser		*browser = LIFEREA_BROWSER (user_data);
+	g_autofree gchar	*type = NULL;
+
+	if (!jsc_value_is_object (value))
+		return;
+
+	if (!liferea_browser_message_from_view (browser)) {
+		debug (DEBUG_HTML, "ignoring script message from non-view page");
+		return;
+	}
+
+	type = liferea_browser_message_get_string (value, "type");
+	if (!type)
+		return;
+
+	if (g_str_equal (type, "rendered"))
+		liferea_browser_view_rendered (browser, value);
+	else if (g_str_equal (type, "extract"))
+		liferea_browser_view_extracted (browser, value);
+}
+
 /* Needed when adding widget to a parent and querying GTK theme */
 GtkWidget *
 liferea_browser_get_widget (LifereaBrowser *browser)
@@ -344,6 +457,8 @@ liferea_browser_write (LifereaBrowser *browser, const gchar *string, const gchar
 	if (baseURL == NULL)
 		baseURL = "file:///";
 
+	liferea_browser_view_reset (browser);
+
 	if (!g_utf8_validate (string, -1, NULL)) {
 		/* It is really a bug if we get invalid encoded UTF-8 here!!! */
 		liferea_webkit_write_html (browser->renderWidget, errMsg, strlen (errMsg), baseURL, "text/plain");
@@ -392,6 +507,11 @@ liferea_browser_location_changed (LifereaBrowser *browser, const gchar *location
 
 	g_object_get (G_OBJECT (browser), "hidden-urlbar", &hiddenUrlbar, NULL);
 
+	/* Content injection does not commit a load, so a ready view
+	   page has just been replaced by something else */
+	if (browser->viewReady)
+		liferea_browser_view_reset (browser);
+
 	if (browser->url && !g_str_has_prefix (browser->url, "liferea://") && !hiddenUrlbar) {
 		GtkEntryBuffer *buffer = gtk_entry_buffer_new (browser->url, -1);
 		gtk_entry_set_buffer (GTK_ENTRY (browser->urlentry), buffer);
@@ -454,6 +574,7 @@ liferea_browser_launch_URL_internal (LifereaBrowser *browser, const gchar *url)
 	GtkEntryBuffer *buffer = gtk_entry_buffer_new (url, -1);
 	gtk_entry_set_buffer (GTK_ENTRY (browser->urlentry), buffer);
 
+	liferea_browser_view_reset (browser);
 	liferea_webkit_launch_url (browser->renderWidget, url);
 }
 
@@ -615,7 +736,7 @@ liferea_browser_set_view (LifereaBrowser *browser, const gchar *name, const gcha
 {
 	g_autofree gchar	*script = NULL;
 	g_autofree gchar 	*encoded_json = NULL;
-	g_autoptr(GString)	tmp;
+	g_autoptr(GString)	tmp = NULL;
 	
 	g_free (browser->url);
 	browser->url = NULL;
@@ -624,6 +745,20 @@ liferea_browser_set_view (LifereaBrowser *browser, const gchar *name, const gcha
 	encoded_json = g_uri_escape_string (json, NULL, TRUE);
 	script = g_strdup_printf ("window.debugflags=%ld; load_%s('%s', '%s', '%s');\n", debug_get_flags(), name, encoded_json, baseURL, direction);
 
+	browser->viewRequested = g_get_monotonic_time ();
+
+	/* Push the content into the already loaded page if possible */
+	if (browser->viewReady && g_str_equal (browser->view, name)) {
+		browser->viewInjected = TRUE;
+		liferea_webkit_run_javascript (browser->renderWidget, script);
+		return;
+	}
+
+	g_free (browser->view);
+	browser->view = g_strdup (name);
+	browser->viewReady = FALSE;
+	browser->viewInjected = FALSE;
+
 	/* Each template has a script insertion marker which we need to replace */
 	tmp = g_string_new (liferea_browser_get_template (browser, name));
 	g_string_replace (tmp, "REPLACE_MARKER", script, 1);
@@ -638,6 +773,7 @@ liferea_browser_init (LifereaBrowser *browser)
 {
 	browser->content = NULL;
 	browser->url = NULL;
+	browser->view = NULL;
 	browser->renderWidget = liferea_webkit_new (browser);
 	browser->history = browser_history_new ();
 	browser->urlHoverTimeout = 0;
@@ -760,6 +896,11 @@ liferea_browser_init (LifereaBrowser *browser)
 
 	g_object_unref (builder);
 
+	WebKitUserContentManager *manager = webkit_web_view_get_user_content_manager (WEBKIT_WEB_VIEW (browser->renderWidget));
+	g_signal_connect (manager, "script-message-received::liferea",
+	                  G_CALLBACK (liferea_browser_script_message_cb), browser);
+	webkit_user_content_manager_register_script_message_handler (manager, "liferea", NULL);
+
 	liferea_browser_clear (browser);
 
 	g_signal_connect (network_monitor_get (), "proxy-changed",
@@ -52,6 +52,11 @@ struct _LifereaBrowser {
 	gchar		*name;			/*<< optional widget name (should be unique) */
 	gchar		*url;			/*<< the URL of the content rendered right now */
 	gchar 		*content;		/*<< current HTML content (excluding decorations, content passed to Readability.js) */
+
+	gchar		*view;			/*<< name of the view template page currently loaded (or NULL) */
+	gboolean	viewReady;		/*<< TRUE if the loaded view page accepts new content */
+	gboolean	viewInjected;		/*<< TRUE if the last content was pushed into the loaded page */
+	gint64		viewRequested;		/*<< monotonic time of the last view render request (or 0) */
 };
 
 /**
@@ -215,6 +215,10 @@ on_dialog_response (GtkButton *btn, gpointer user_data)
 	}
 
 	if (node) {
+		/* "Archive" retention is a node setting */
+		node->retainUnread = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (liferea_dialog_lookup (dialog, "retainUnreadSpin")));
+		node->retainRead = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (liferea_dialog_lookup (dialog, "retainReadSpin")));
+
 		/* Update existing subscription */
 		feedlist_node_was_updated (node);
 		db_subscription_update (subscription);
@@ -442,6 +446,15 @@ subscription_prop_dialog_load (GtkWidget *dialog,
 
 	gtk_widget_set_sensitive (liferea_dialog_lookup (dialog, "cacheItemLimit"), subscription->cacheLimit > 0);
 
+	if (subscription->node) {
+		gtk_spin_button_set_value (GTK_SPIN_BUTTON (liferea_dialog_lookup (dialog, "retainUnreadSpin")), subscription->node->retainUnread);
+		gtk_spin_button_set_value (GTK_SPIN_BUTTON (liferea_dialog_lookup (dialog, "retainReadSpin")), subscription->node->retainRead);
+	} else {
+		/* Retention can only be set on existing nodes */
+		gtk_widget_set_sensitive (liferea_dialog_lookup (dialog, "retainUnreadSpin"), FALSE);
+		gtk_widget_set_sensitive (liferea_dialog_lookup (dialog, "retainReadSpin"), FALSE);
+	}
+
 	on_feed_prop_filtercheck (GTK_CHECK_BUTTON (liferea_dialog_lookup (dialog, "filterCheckbox")), dialog);
 
 	/* Download */
@@ -153,6 +153,7 @@ update_request_finalize (GObject *obj)
 	g_free (request->postdata);
 	g_free (request->source);
 	g_free (request->filtercmd);
+	g_free (request->ifMatch);
 
 	G_OBJECT_CLASS (update_request_parent_class)->finalize (obj);
 }
@@ -223,6 +224,13 @@ update_request_set_postdata (UpdateRequest *request, const gchar *postdata, cons
 	g_assert (!g_str_equal (request->method, "GET"));
 }
 
+void
+update_request_set_if_match (UpdateRequest *request, const gchar *etag)
+{
+	g_free (request->ifMatch);
+	request->ifMatch = g_strdup (etag);
+}
+
 void
 update_request_allow_commands (UpdateRequest *request, gboolean allowCommands)
 {
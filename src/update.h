@@ -81,6 +81,7 @@ struct _UpdateRequest {
 	gchar           *postdata;      /*<< HTTP request body data */
 	gchar	        *contentType;   /*<< HTTP request content type (optional) */
 	gchar           *authValue;     /*<< Custom value for Authorization: header */
+	gchar           *ifMatch;       /*<< ETag precondition for uploads (optional) */
 	updateOptionsPtr options;	/*<< Update options for the request */
 	gchar		*filtercmd;	/*<< Command will filter output of URL */
 	updateStatePtr	updateState;	/*<< Update state of the requested object (etags, last modified...) */
@@ -200,6 +201,16 @@ void update_request_set_auth_value (UpdateRequest *request, const gchar* authVal
  */
 void update_request_set_postdata (UpdateRequest *request, const gchar* postdata, const gchar* contentType);
 
+/**
+ * update_request_set_if_match:
+ * @request:        the update request
+ * @etag: (nullable): the ETag the remote document is expected to have
+ *
+ * Makes an upload conditional: the server is to reject it with HTTP 412
+ * when the document was changed by someone else in the meantime.
+ */
+void update_request_set_if_match (UpdateRequest *request, const gchar* etag);
+
 /**
  * update_request_allow_commands:
  * @request:            the update request
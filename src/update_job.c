@@ -573,12 +573,20 @@ update_job_get_state (UpdateJob *job)
 	return job->state;
 }
 
-static gboolean
-update_job_process_result_idle_cb (gpointer user_data)
+/* Results arriving in bursts (e.g. on startup) are processed with a time
+   budget per main loop iteration so that redraws and input are not held
+   back until all of them are merged. */
+#define UPDATE_JOB_RESULT_BUDGET	8000	/* µs per main loop iteration, half a frame at 60Hz */
+
+static GMutex	resultLock;
+static GQueue	resultQueue = G_QUEUE_INIT;	/* finished jobs waiting for processing */
+static gboolean	resultIdle = FALSE;		/* TRUE if the idle callback is scheduled */
+
+static void
+update_job_process_result_now (UpdateJob *job)
 {
-	UpdateJob *job = (UpdateJob *)user_data;
 	gboolean done = TRUE;
-	  
+
 	if (job->callback)
 		done = (job->callback) (job);
 
@@ -587,15 +595,47 @@ update_job_process_result_idle_cb (gpointer user_data)
 		update_job_continue_flow (job);
 	else
 		g_object_unref (job);
+}
+
+static gboolean
+update_job_process_result_idle_cb (gpointer user_data)
+{
+	gint64	start = g_get_monotonic_time ();
+	guint	processed = 0;
+
+	do {
+		UpdateJob *job;
+
+		g_mutex_lock (&resultLock);
+		job = g_queue_pop_head (&resultQueue);
+		if (!job)
+			resultIdle = FALSE;
+		g_mutex_unlock (&resultLock);
 
-	return FALSE;
+		if (!job)
+			return G_SOURCE_REMOVE;
+
+		update_job_process_result_now (job);
+		processed++;
+	} while (g_get_monotonic_time () - start < UPDATE_JOB_RESULT_BUDGET);
+
+	debug (DEBUG_UPDATE, "processed %u update results in %" G_GINT64_FORMAT "µs, continuing next iteration",
+	       processed, g_get_monotonic_time () - start);
+
+	return G_SOURCE_CONTINUE;
 }
 
 void
 update_job_process_result (gpointer user_data)
 {
 	// the job->callback has to be run in the main loop as it does DB transaction locking
-	g_idle_add (update_job_process_result_idle_cb, user_data);
+	g_mutex_lock (&resultLock);
+	g_queue_push_tail (&resultQueue, user_data);
+	if (!resultIdle) {
+		resultIdle = TRUE;
+		g_idle_add (update_job_process_result_idle_cb, NULL);
+	}
+	g_mutex_unlock (&resultLock);
 }
 
 void
@@ -0,0 +1,393 @@
+/**
+ * @file update_ramp.c  paced update of many subscriptions
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "update_ramp.h"
+
+#include <json-glib/json-glib.h>
+
+#include "conf.h"
+#include "debug.h"
+#include "feedlist.h"
+#include "subscription.h"
+#include "update_job_queue.h"
+
+/* Subscribing many feeds at once (e.g. by importing a large OPML file)
+   or updating all feeds on startup used to queue all fetches immediately,
+   flooding the network and afterwards the main loop with results. The
+   ramp instead tops up the update job queue each tick to twice the
+   configured number of update threads, so it never holds much more work
+   than the threads can do. Ticks are jittered to not hit servers in
+   lock step.
+
+   On startup the last selected node and the nodes visible in the
+   feed list (all parent folders expanded) are updated first. Selecting
+   a node moves its pending updates to the head of the ramp.
+
+   The dispatch time of each node is kept for the update monitor. */
+
+#define UPDATE_RAMP_INTERVAL	500	/* ms between ticks */
+#define UPDATE_RAMP_JITTER	40	/* max. tick interval variation [%] */
+
+typedef struct rampEntry {
+	gchar	*nodeId;
+	guint	flags;
+	gint64	queued;		/* real time the update was queued */
+	GList	*link;		/* link of the entry in ramp.pending */
+} rampEntry;
+
+typedef struct rampLogEntry {
+	gint64	queued;		/* real time the update was queued */
+	gint64	dispatched;	/* real time the update was started */
+} rampLogEntry;
+
+static struct {
+	GQueue		*pending;	/* rampEntry of the updates not yet started */
+	GHashTable	*pendingIds;	/* node id -> rampEntry for lookups */
+	GHashTable	*log;		/* node id -> rampLogEntry of the last dispatch */
+	guint		total;		/* updates queued since the ramp was idle */
+	guint		timer;
+	struct {
+		guint	queued;		/* subscriptions added to the ramp */
+		guint	dispatched;	/* subscription updates started */
+		guint	skipped;	/* subscriptions removed before their turn */
+		guint	deferred;	/* ticks without dispatch due to a full job queue */
+	} stats;
+} ramp;
+
+static void
+update_ramp_entry_free (gpointer data)
+{
+	rampEntry *entry = (rampEntry *)data;
+
+	g_free (entry->nodeId);
+	g_free (entry);
+}
+
+/* Returns FALSE if the update was skipped */
+static gboolean
+update_ramp_dispatch (rampEntry *entry)
+{
+	Node		*node = node_from_id (entry->nodeId);
+	rampLogEntry	*logEntry;
+
+	if (!node || !(node->subscription || node->source->root == node)) {
+		ramp.stats.skipped++;
+		return FALSE;
+	}
+
+	/* Skip nodes the user updated meanwhile */
+	if (node->subscription &&
+	    (node->subscription->updateJob || node->subscription->updateState->lastPoll > entry->queued)) {
+		ramp.stats.skipped++;
+		return FALSE;
+	}
+
+	logEntry = g_new0 (rampLogEntry, 1);
+	logEntry->queued = entry->queued;
+	logEntry->dispatched = g_get_real_time ();
+	g_hash_table_insert (ramp.log, g_strdup (entry->nodeId), logEntry);
+
+	debug (DEBUG_UPDATE, "update ramp: starting update of %s |%s| after %.1fs",
+	       node->id, node_get_title (node), (logEntry->dispatched - logEntry->queued) / (gdouble)G_USEC_PER_SEC);
+
+	/* Node sources handle login state and update their children themselves */
+	if (node->source->root == node)
+		node_update_subscription (node, GUINT_TO_POINTER (entry->flags));
+	else
+		subscription_update (node->subscription, entry->flags);
+
+	ramp.stats.dispatched++;
+	return TRUE;
+}
+
+static gboolean update_ramp_tick (gpointer user_data);
+
+static void
+update_ramp_schedule (void)
+{
+	gint jitter = UPDATE_RAMP_INTERVAL * UPDATE_RAMP_JITTER / 100;
+
+	ramp.timer = g_timeout_add (UPDATE_RAMP_INTERVAL + g_random_int_range (-jitter, jitter + 1), update_ramp_tick, NULL);
+}
+
+static gboolean
+update_ramp_tick (gpointer user_data)
+{
+	guint	count, max, limit;
+	gint	threads = 0;
+
+	ramp.timer = 0;
+
+	conf_get_int_value (MAX_UPDATE_THREADS, &threads);
+	limit = 2 * (guint)MAX (threads, 1);
+	update_job_queue_get_count (&count, &max);
+	if (count >= limit) {
+		ramp.stats.deferred++;
+		update_ramp_schedule ();
+		return G_SOURCE_REMOVE;
+	}
+
+	/* Skipped updates do not count against the limit */
+	while (count < limit && !g_queue_is_empty (ramp.pending)) {
+		GList		*link = g_queue_pop_head_link (ramp.pending);
+		rampEntry	*entry = (rampEntry *)link->data;
+
+		g_list_free_1 (link);
+		g_hash_table_remove (ramp.pendingIds, entry->nodeId);
+		if (update_ramp_dispatch (entry))
+			count++;
+		update_ramp_entry_free (entry);
+	}
+
+	if (!g_queue_is_empty (ramp.pending)) {
+		update_ramp_schedule ();
+		return G_SOURCE_REMOVE;
+	}
+
+	debug (DEBUG_UPDATE, "update ramp: all %u queued updates started", ramp.total);
+	ramp.total = 0;
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+update_ramp_queue (Node *node, guint flags)
+{
+	rampEntry *entry;
+
+	if (!ramp.pending) {
+		ramp.pending = g_queue_new ();
+		ramp.pendingIds = g_hash_table_new (g_str_hash, g_str_equal);
+		ramp.log = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	}
+
+	if (g_hash_table_contains (ramp.pendingIds, node->id))
+		return;
+
+	entry = g_new0 (rampEntry, 1);
+	entry->nodeId = g_strdup (node->id);
+	entry->flags = flags;
+	entry->queued = g_get_real_time ();
+	entry->link = g_list_alloc ();
+	entry->link->data = entry;
+	g_queue_push_tail_link (ramp.pending, entry->link);
+	g_hash_table_insert (ramp.pendingIds, entry->nodeId, entry);
+
+	ramp.total++;
+	ramp.stats.queued++;
+
+	if (!ramp.timer)
+		update_ramp_schedule ();
+}
+
+void
+update_ramp_add (Node *node, guint flags)
+{
+	if (!node->subscription)
+		return;
+
+	update_ramp_queue (node, flags);
+}
+
+typedef struct rampCollect {
+	Node	*selected;
+	GSList	*first;		/* nodes in the selected subtree */
+	GSList	*visible;	/* nodes whose parent folders are all expanded */
+	GSList	*rest;
+} rampCollect;
+
+static gboolean
+update_ramp_node_is_visible (Node *node)
+{
+	Node *parent;
+
+	for (parent = node->parent; parent && parent->parent; parent = parent->parent) {
+		if (!parent->expanded)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+update_ramp_node_is_below (Node *node, Node *ancestor)
+{
+	for (; node; node = node->parent) {
+		if (node == ancestor)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+update_ramp_collect (Node *node, gpointer user_data)
+{
+	rampCollect	*c = (rampCollect *)user_data;
+	gboolean	isSource = (node->source->root == node);
+
+	if (node->subscription || isSource) {
+		if (c->selected && update_ramp_node_is_below (node, c->selected))
+			c->first = g_slist_prepend (c->first, node);
+		else if (update_ramp_node_is_visible (node))
+			c->visible = g_slist_prepend (c->visible, node);
+		else
+			c->rest = g_slist_prepend (c->rest, node);
+	}
+
+	/* Node sources update their children themselves */
+	if (!isSource)
+		node_foreach_child_data (node, update_ramp_collect, c);
+}
+
+static void
+update_ramp_queue_list (GSList *list, guint flags)
+{
+	GSList *iter;
+
+	list = g_slist_reverse (list);
+	for (iter = list; iter; iter = g_slist_next (iter))
+		update_ramp_queue ((Node *)iter->data, flags);
+	g_slist_free (list);
+}
+
+void
+update_ramp_add_tree (Node *root, guint flags)
+{
+	rampCollect		c = { 0 };
+	g_autofree gchar	*selectedId = NULL;
+
+	/* The selection is restored after the feed list is loaded */
+	c.selected = feedlist_get_selected ();
+	if (!c.selected && conf_get_str_value (LAST_NODE_SELECTED, &selectedId))
+		c.selected = node_from_id (selectedId);
+
+	node_foreach_child_data (root, update_ramp_collect, &c);
+
+	debug (DEBUG_UPDATE, "update ramp: queueing %u selected, %u visible and %u other nodes",
+	       g_slist_length (c.first), g_slist_length (c.visible), g_slist_length (c.rest));
+
+	update_ramp_queue_list (c.first, flags);
+	update_ramp_queue_list (c.visible, flags);
+	update_ramp_queue_list (c.rest, flags);
+}
+
+static void
+update_ramp_promote_collect (Node *node, gpointer user_data)
+{
+	GSList		**entries = (GSList **)user_data;
+	rampEntry	*entry = g_hash_table_lookup (ramp.pendingIds, node->id);
+
+	if (entry)
+		*entries = g_slist_prepend (*entries, entry);
+
+	if (node->source->root != node)
+		node_foreach_child_data (node, update_ramp_promote_collect, entries);
+}
+
+void
+update_ramp_promote (Node *node)
+{
+	GSList	*entries = NULL, *iter;
+
+	if (!node || !ramp.pending || g_queue_is_empty (ramp.pending))
+		return;
+
+	/* Collected in reverse feed list order, so pushing each entry
+	   to the head keeps the subtree in feed list order */
+	update_ramp_promote_collect (node, &entries);
+	for (iter = entries; iter; iter = g_slist_next (iter)) {
+		rampEntry *entry = (rampEntry *)iter->data;
+
+		g_queue_unlink (ramp.pending, entry->link);
+		g_queue_push_head_link (ramp.pending, entry->link);
+	}
+	g_slist_free (entries);
+}
+
+gboolean
+update_ramp_is_pending (Node *node)
+{
+	return ramp.pendingIds && g_hash_table_contains (ramp.pendingIds, node->id);
+}
+
+void
+update_ramp_deinit (void)
+{
+	if (ramp.timer) {
+		g_source_remove (ramp.timer);
+		ramp.timer = 0;
+	}
+
+	if (ramp.pending) {
+		g_hash_table_destroy (ramp.pendingIds);
+		g_queue_free_full (ramp.pending, update_ramp_entry_free);
+		g_hash_table_destroy (ramp.log);
+		ramp.pendingIds = NULL;
+		ramp.pending = NULL;
+		ramp.log = NULL;
+	}
+}
+
+void
+update_ramp_to_json (gpointer builder)
+{
+	JsonBuilder	*b = JSON_BUILDER (builder);
+	guint		pending = ramp.pending?g_queue_get_length (ramp.pending):0;
+
+	json_builder_set_member_name (b, "ramp");
+	json_builder_begin_object (b);
+	json_builder_set_member_name (b, "pending");
+	json_builder_add_int_value (b, pending);
+	json_builder_set_member_name (b, "progress");
+	json_builder_add_int_value (b, (pending && ramp.total)?(100 * (ramp.total - pending) / ramp.total):100);
+	json_builder_set_member_name (b, "queued");
+	json_builder_add_int_value (b, ramp.stats.queued);
+	json_builder_set_member_name (b, "dispatched");
+	json_builder_add_int_value (b, ramp.stats.dispatched);
+	json_builder_set_member_name (b, "skipped");
+	json_builder_add_int_value (b, ramp.stats.skipped);
+	json_builder_set_member_name (b, "deferred");
+	json_builder_add_int_value (b, ramp.stats.deferred);
+
+	/* Dispatch log: start time [ms since epoch] and waiting time [ms] per node */
+	json_builder_set_member_name (b, "log");
+	json_builder_begin_array (b);
+	if (ramp.log) {
+		GHashTableIter	iter;
+		gpointer	key, value;
+
+		g_hash_table_iter_init (&iter, ramp.log);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			rampLogEntry *logEntry = (rampLogEntry *)value;
+
+			json_builder_begin_object (b);
+			json_builder_set_member_name (b, "id");
+			json_builder_add_string_value (b, (const gchar *)key);
+			json_builder_set_member_name (b, "dispatched");
+			json_builder_add_int_value (b, logEntry->dispatched / 1000);
+			json_builder_set_member_name (b, "wait");
+			json_builder_add_int_value (b, (logEntry->dispatched - logEntry->queued) / 1000);
+			json_builder_end_object (b);
+		}
+	}
+	json_builder_end_array (b);
+	json_builder_end_object (b);
+}
@@ -0,0 +1,81 @@
+/**
+ * @file update_ramp.h  paced update of many subscriptions
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _UPDATE_RAMP_H
+#define _UPDATE_RAMP_H
+
+#include <glib.h>
+
+#include "node.h"
+
+/**
+ * update_ramp_add: (skip)
+ * @node:	the node whose subscription is to be updated
+ * @flags:	update flags passed to subscription_update()
+ *
+ * Queues a subscription update to be started by the ramp
+ * instead of all at once.
+ */
+void update_ramp_add (Node *node, guint flags);
+
+/**
+ * update_ramp_add_tree: (skip)
+ * @root:	the node whose descendants are to be updated
+ * @flags:	update flags passed to subscription_update()
+ *
+ * Queues updates for all subscriptions and node sources below
+ * @root. The selected (or last selected) node and the nodes visible
+ * in the feed list are queued first.
+ */
+void update_ramp_add_tree (Node *root, guint flags);
+
+/**
+ * update_ramp_promote: (skip)
+ * @node:	a node (or folder) the user is interested in
+ *
+ * Moves pending updates of @node and its descendants to the
+ * head of the ramp.
+ */
+void update_ramp_promote (Node *node);
+
+/**
+ * update_ramp_is_pending: (skip)
+ * @node:	the node to check
+ *
+ * Returns: TRUE if an update of @node waits in the ramp
+ */
+gboolean update_ramp_is_pending (Node *node);
+
+/**
+ * update_ramp_deinit: (skip)
+ *
+ * Drops all subscription updates not yet started.
+ */
+void update_ramp_deinit (void);
+
+/**
+ * update_ramp_to_json: (skip)
+ * @b:		a JsonBuilder to append to
+ *
+ * Adds a "ramp" member with progress and statistics.
+ */
+void update_ramp_to_json (gpointer b);
+
+#endif
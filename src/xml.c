@@ -36,47 +36,48 @@
 #include "common.h"
 #include "debug.h"
 
+/* Item content extraction parses many small HTML snippets per feed
+   update, so parser context and output buffer are kept per thread
+   instead of being set up for each snippet. */
+static GPrivate html_parser_ctxt = G_PRIVATE_INIT ((GDestroyNotify) htmlFreeParserCtxt);
+static GPrivate html_dump_buffer = G_PRIVATE_INIT ((GDestroyNotify) xmlBufferFree);
+
 xmlDocPtr
 xhtml_parse (const gchar *html, gint len)
 {
-	xmlDocPtr	out = NULL;
+	htmlParserCtxtPtr	ctxt = g_private_get (&html_parser_ctxt);
 
 	g_assert (html != NULL);
 	g_assert (len >= 0);
 
+	if (!ctxt) {
+		ctxt = htmlNewParserCtxt ();
+		g_private_set (&html_parser_ctxt, ctxt);
+	}
+
 	/* Note: NONET is not implemented so it will return an error
 	   because it doesn't know how to handle NONET. But, it might
 	   learn in the future. */
-	out = htmlReadMemory (html, len, NULL, "utf-8", HTML_PARSE_RECOVER | HTML_PARSE_NONET |
-	                      ((debug_get_flags () & DEBUG_HTML)?0:(HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING)));
-
-	return out;
+	return htmlCtxtReadMemory (ctxt, html, len, NULL, "utf-8", HTML_PARSE_RECOVER | HTML_PARSE_NONET |
+	                           ((debug_get_flags () & DEBUG_HTML)?0:(HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING)));
 }
 
+/* Equivalent of the XPath expression "/html/body" */
 static xmlNodePtr
 xhtml_find_body (xmlDocPtr doc)
 {
-	xmlXPathContextPtr xpathCtxt = NULL;
-	xmlXPathObjectPtr xpathObj = NULL;
-	xmlNodePtr node = NULL;
-
-	xpathCtxt = xmlXPathNewContext (doc);
-	if (!xpathCtxt)
-		goto error;
-
-	xpathObj = xmlXPathEvalExpression (BAD_CAST "/html/body", xpathCtxt);
-	if (!xpathObj)
-		goto error;
-	if (!xpathObj->nodesetval->nodeMax)
-		goto error;
-
-	node = xpathObj->nodesetval->nodeTab[0];
- error:
-	if (xpathObj)
-		xmlXPathFreeObject (xpathObj);
-	if (xpathCtxt)
-		xmlXPathFreeContext (xpathCtxt);
-	return node;
+	xmlNodePtr	root, node;
+
+	root = xmlDocGetRootElement (doc);
+	if (!root || !xmlStrEqual (root->name, BAD_CAST "html"))
+		return NULL;
+
+	for (node = root->children; node; node = node->next) {
+		if (node->type == XML_ELEMENT_NODE && xmlStrEqual (node->name, BAD_CAST "body"))
+			return node;
+	}
+
+	return NULL;
 }
 
 xmlDocPtr
@@ -168,13 +169,18 @@ xhtml_extract (xmlNodePtr xml, gint xhtmlMode, const gchar *defaultBase)
 	if (!newDoc)
 		return NULL;
 
-	buf = xmlBufferCreate ();
+	buf = g_private_get (&html_dump_buffer);
+	if (!buf) {
+		buf = xmlBufferCreate ();
+		g_private_set (&html_dump_buffer, buf);
+	}
+
+	xmlBufferEmpty (buf);
 	htmlNodeDump (buf, newDoc, xmlDocGetRootElement (newDoc) );
 
 	if (xmlBufferLength(buf) > 0)
-		result = (gchar *)xmlCharStrdup ((gchar *)xmlBufferContent (buf));
+		result = g_strndup ((gchar *)xmlBufferContent (buf), xmlBufferLength (buf));
 
-	xmlBufferFree (buf);
 	xmlFreeDoc (newDoc);
 
 	return result;
@@ -235,73 +241,204 @@ xhtml_is_well_formed (const gchar *data)
 	return result;
 }
 
-typedef struct regex {
-    GRegex *expr;
-    const gchar *replace;
-} *regexPtr;
+/* Tags dropped including their content */
+static const gchar *dhtml_drop_content[] = { "script", "iframe", "meta", NULL };
 
-static GSList *dhtml_strippers = NULL;
+/* Tags dropped while keeping their content */
+static const gchar *dhtml_drop_tag[] = { "wbr", "body", NULL };
 
-static void
-xhtml_regex_add (GSList **regex, const gchar *pattern, const gchar *replace)
+static gboolean
+xhtml_tag_in_list (const gchar *name, gsize len, const gchar **list)
 {
-	GError *err = NULL;
-        regexPtr expr = g_new0 (struct regex, 1);
-
-	// Do not use G_REGEX_OPTIMIZE as valgrind would report errors!
-	expr->expr = g_regex_new (pattern, G_REGEX_CASELESS | G_REGEX_UNGREEDY | G_REGEX_DOTALL, 0, &err);
-        expr->replace = replace;
-	if (err) {
-		g_warning ("xhtml_strip_setup: %s\n", err->message);
-		g_error_free (err);
-		return;
+	for (; *list; list++) {
+		if (strlen (*list) == len && 0 == g_ascii_strncasecmp (name, *list, len))
+			return TRUE;
 	}
-	*regex = g_slist_append (*regex, expr);
+	return FALSE;
 }
 
-static gchar *
-xhtml_regex (const gchar *html, GSList *strippers)
+static gboolean
+xhtml_is_name_char (gchar c)
+{
+	return g_ascii_isalnum (c) || c == '-' || c == ':' || c == '_';
+}
+
+/* Scans the attributes of a tag starting after the tag name up to and
+   including the closing '>'. Event handler attributes (on*) are dropped,
+   everything else is copied to out (if given). Returns the position after
+   the tag or NULL if the tag is not terminated. */
+static const gchar *
+xhtml_strip_attributes (const gchar *p, GString *out, gboolean *selfClosing)
 {
-	gchar *result = g_strdup (html);
-	GSList *iter = strippers;
-
-	while (iter) {
-		GError *err = NULL;
-		regexPtr expr = (regexPtr) iter->data;
-		gchar *tmp = result;
-		result = g_regex_replace_literal (expr->expr, tmp, -1, 0, expr->replace, 0, &err);
-		if (err) {
-			g_warning ("xhtml_strip: %s\n", err->message);
-			g_error_free (err);
-			err = NULL;
+	while (TRUE) {
+		const gchar	*start = p;		/* including leading whitespace */
+		const gchar	*name, *afterName;
+		gboolean	hasValue = FALSE;
+
+		while (g_ascii_isspace (*p))
+			p++;
+
+		if (!*p)
+			return NULL;
+
+		if (*p == '>') {
+			const gchar *q = p - 1;
+			while (g_ascii_isspace (*q))
+				q--;
+			*selfClosing = (*q == '/');
+			if (out)
+				g_string_append_len (out, start, p - start + 1);
+			return p + 1;
 		}
-		g_free (tmp);
-		iter = g_slist_next (iter);
+
+		if (*p == '/') {
+			p++;
+			if (out)
+				g_string_append_len (out, start, p - start);
+			continue;
+		}
+
+		name = p;
+		while (*p && !g_ascii_isspace (*p) && *p != '=' && *p != '>' && *p != '/')
+			p++;
+		afterName = p;
+
+		while (g_ascii_isspace (*p))
+			p++;
+		if (*p == '=') {
+			hasValue = TRUE;
+			p++;
+			while (g_ascii_isspace (*p))
+				p++;
+			if (*p == '"' || *p == '\'') {
+				p = strchr (p + 1, *p);
+				if (!p)
+					return NULL;
+				p++;
+			} else {
+				while (*p && !g_ascii_isspace (*p) && *p != '>')
+					p++;
+			}
+		} else {
+			p = afterName;
+		}
+
+		/* drop event handlers, keeping a separator before a "/>" so
+		   that it doesn't extend an unquoted value before */
+		if (hasValue && afterName - name > 2 && 0 == g_ascii_strncasecmp (name, "on", 2)) {
+			if (out && *p == '/')
+				g_string_append_c (out, ' ');
+			continue;
+		}
+
+		if (out)
+			g_string_append_len (out, start, p - start);
 	}
+}
 
-	return result;
+/* Returns the position after the closing tag of the given name or NULL */
+static const gchar *
+xhtml_find_close_tag (const gchar *p, const gchar *name, gsize len)
+{
+	while ((p = strstr (p, "</"))) {
+		p += 2;
+		while (g_ascii_isspace (*p))
+			p++;
+		if (0 != g_ascii_strncasecmp (p, name, len) || xhtml_is_name_char (p[len]))
+			continue;
+		p += len;
+		while (g_ascii_isspace (*p))
+			p++;
+		if (*p == '>')
+			return p + 1;
+	}
+
+	return NULL;
 }
 
+/* Single pass DHTML stripper: the input is copied while tokenizing tags
+   only, text content is copied in chunks. Unterminated tags are dropped
+   together with the rest of the input. */
 gchar *
 xhtml_strip_dhtml (const gchar *html)
 {
-	if (!dhtml_strippers) {
-		// Drop attribute
-		xhtml_regex_add (&dhtml_strippers, "\\s+onload='[^']+'", "");
-		xhtml_regex_add (&dhtml_strippers, "\\s+onload=\"[^\"]+\"", "");
-
-		// Drop tags including content
-		xhtml_regex_add (&dhtml_strippers, "<\\s*meta[^>]*>.*</\\s*meta\\s*>", "");
-		xhtml_regex_add (&dhtml_strippers, "<\\s*script[^>]*>.*</\\s*script\\s*>", "");
-		xhtml_regex_add (&dhtml_strippers, "<\\s*iframe[^>]*>.*</\\s*iframe\\s*>", "");
-		xhtml_regex_add (&dhtml_strippers, "<\\s*(meta|script|iframe)[^>]*/>", "");
-
-		// Drops tags but not their content
-		xhtml_regex_add (&dhtml_strippers, "<\\s*/?wbr[^>]*/?\\s*>", "");
-		xhtml_regex_add (&dhtml_strippers, "<\\s*/?body[^>]*/?\\s*>", "");
+	GString		*out;
+	const gchar	*p = html;
+
+	if (!html)
+		return NULL;
+
+	out = g_string_sized_new (strlen (html));
+
+	while (*p) {
+		const gchar	*tag, *name, *end;
+		gsize		nameLen;
+		gboolean	closing = FALSE, selfClosing;
+
+		tag = strchr (p, '<');
+		if (!tag) {
+			g_string_append (out, p);
+			break;
+		}
+		g_string_append_len (out, p, tag - p);
+
+		/* "<", optional "/" and the tag name, whitespace allowed in between */
+		p = tag + 1;
+		while (g_ascii_isspace (*p))
+			p++;
+		if (*p == '/') {
+			closing = TRUE;
+			p++;
+			while (g_ascii_isspace (*p))
+				p++;
+		}
+		name = p;
+		while (xhtml_is_name_char (*p))
+			p++;
+		nameLen = p - name;
+
+		/* Not a tag (comment, doctype, "a < b"...) */
+		if (nameLen == 0 || !g_ascii_isalpha (*name)) {
+			g_string_append_c (out, '<');
+			p = tag + 1;
+			continue;
+		}
+
+		if (xhtml_tag_in_list (name, nameLen, dhtml_drop_content)) {
+			end = xhtml_strip_attributes (p, NULL, &selfClosing);
+			if (!end)
+				break;		/* unterminated, drop the rest */
+			p = end;
+			if (!closing && !selfClosing) {
+				end = xhtml_find_close_tag (p, name, nameLen);
+				if (end)
+					p = end;
+			}
+			continue;
+		}
+
+		if (xhtml_tag_in_list (name, nameLen, dhtml_drop_tag)) {
+			end = xhtml_strip_attributes (p, NULL, &selfClosing);
+			if (!end)
+				break;
+			p = end;
+			continue;
+		}
+
+		/* Any other tag: copy with event handlers dropped */
+		gsize rollback = out->len;
+		g_string_append_len (out, tag, p - tag);
+		end = xhtml_strip_attributes (p, out, &selfClosing);
+		if (!end) {
+			/* unterminated, drop the rest as it could still carry
+			   event handlers once followed by other markup */
+			g_string_truncate (out, rollback);
+			break;
+		}
+		p = end;
 	}
 
-	return xhtml_regex (html, dhtml_strippers);
+	return g_string_free (out, FALSE);
 }
 
 typedef struct {
@@ -589,19 +726,6 @@ xml_print_error (void *ctxt, const char *msg, ...)
 	debug (DEBUG_PARSING, "libxml2 parse error: %s", parser_error);
 }
 
-static void
-xml_deinit (void)
-{
-	GSList *iter = dhtml_strippers;
-
-	while (iter) {
-		g_regex_unref ((((regexPtr)iter->data))->expr);
-		iter = g_slist_next (iter);
-	}
-	g_slist_free_full (dhtml_strippers, g_free);
-	dhtml_strippers = NULL;
-}
-
 void
 xml_init (void)
 {
@@ -613,5 +737,4 @@ xml_init (void)
 
 	xmlSetGenericErrorFunc (NULL, (xmlGenericErrorFunc)xml_print_error);
 
-	atexit (xml_deinit);
 }
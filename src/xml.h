@@ -103,7 +103,9 @@ xmlDocPtr xhtml_extract_doc (xmlNodePtr cur, gint xhtmlMode, const gchar *defaul
 gchar * xhtml_extract (xmlNodePtr cur, gint xhtmlMode, const gchar *defaultBase);
 
 /**
- * Strips some DHTML constructs from the given HTML string.
+ * Strips some DHTML constructs from the given HTML string:
+ * script, iframe and meta tags including their content, wbr and
+ * body tags and all on* event handler attributes.
  *
  * @param html	some HTML content
  *